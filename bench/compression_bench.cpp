@@ -0,0 +1,110 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Compression.h"
+
+#include "json.hpp"
+using json = nlohmann::json;
+
+// Throughput against bytes saved for each gzip level on JSON payloads shaped
+// like typical API responses (arrays of flat records).
+static std::string makePayload(size_t records) {
+    json items = json::array();
+    for (size_t i = 0; i < records; i++) {
+        items.push_back({
+            {"id", i},
+            {"name", "user-" + std::to_string(i)},
+            {"email", "user" + std::to_string(i) + "@example.com"},
+            {"active", i % 3 != 0},
+            {"score", (i * 7919) % 1000 / 10.0},
+            {"tags", {"alpha", "beta", i % 2 ? "gamma" : "delta"}}
+        });
+    }
+    return json({{"items", items}, {"count", records}}).dump();
+}
+
+int main() {
+    const std::vector<size_t> sizes = {10, 100, 1000, 10000};
+
+    std::cout << std::left << std::setw(10) << "records"
+              << std::setw(12) << "bytes"
+              << std::setw(8) << "level"
+              << std::setw(12) << "ratio"
+              << std::setw(12) << "saved"
+              << "MB/s" << std::endl;
+
+    for (size_t records : sizes) {
+        std::string payload = makePayload(records);
+        const size_t iterations = std::max<size_t>(5, (64 * 1024 * 1024) / payload.size() / 8);
+
+        for (int level = 1; level <= 9; level++) {
+            size_t compressedSize = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < iterations; i++) {
+                compressedSize = Compression::gzip(payload, level).size();
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+            double mbps = (payload.size() * iterations) / elapsed.count() / (1024.0 * 1024.0);
+            std::cout << std::left << std::setw(10) << records
+                      << std::setw(12) << payload.size()
+                      << std::setw(8) << level
+                      << std::setw(12) << std::fixed << std::setprecision(3)
+                      << static_cast<double>(compressedSize) / payload.size()
+                      << std::setw(12) << (payload.size() - compressedSize)
+                      << std::setprecision(1) << mbps << std::endl;
+        }
+    }
+
+    // Each available coding at the gzip-equivalent levels the policy uses
+    std::cout << "\n" << std::left << std::setw(10) << "coding"
+              << std::setw(8) << "level"
+              << std::setw(12) << "ratio"
+              << "MB/s" << std::endl;
+
+    const Compression::Encoding encodings[] = {
+        Compression::Encoding::Gzip, Compression::Encoding::Brotli, Compression::Encoding::Zstd
+    };
+    std::string sample = makePayload(1000);
+    for (Compression::Encoding encoding : encodings) {
+        if (!Compression::isAvailable(encoding)) continue;
+
+        for (int level : {1, 4, 6, 9}) {
+            const size_t iterations = 200;
+            size_t compressedSize = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < iterations; i++) {
+                compressedSize = Compression::encode(encoding, sample, level).size();
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+            std::cout << std::left << std::setw(10) << Compression::encodingName(encoding)
+                      << std::setw(8) << level
+                      << std::setw(12) << std::fixed << std::setprecision(3)
+                      << static_cast<double>(compressedSize) / sample.size()
+                      << std::setprecision(1)
+                      << (sample.size() * iterations) / elapsed.count() / (1024.0 * 1024.0) << std::endl;
+        }
+    }
+
+    // Repeated identical bodies through the compressed-response cache
+    std::string payload = makePayload(1000);
+    const size_t iterations = 2000;
+    Compression::setCacheCapacity(16 * 1024 * 1024);
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        Compression::gzipCached(payload, Config::COMPRESSION_LEVEL);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    Compression::CacheStats stats = Compression::cacheStats();
+    std::cout << "\ncached level " << Config::COMPRESSION_LEVEL << " on " << payload.size() << " bytes: "
+              << std::setprecision(1) << (payload.size() * iterations) / elapsed.count() / (1024.0 * 1024.0)
+              << " MB/s (" << stats.hits << " hits, " << stats.misses << " misses)" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,144 @@
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "HttpServer.h"
+#include "Middleware.h"
+#include "RouteTable.h"
+
+// Cost of getting from a matched route to the handler's response, for the
+// ways HttpServer has stored handlers. The handler captures some state, as
+// most real ones do, and does almost no work itself.
+struct Handler {
+    std::string greeting;
+    const size_t* counter;
+
+    Response<std::string> operator()(HttpContext&) const {
+        return Ok(greeting.size() > *counter % 64 ? "ok" : "no");
+    }
+};
+
+// Previous layout: the handler in a std::function returning Response<T>,
+// wrapped in a std::function<void(HttpContext&)> copied out of the table
+// on every request
+using Typed = std::function<Response<std::string>(HttpContext&)>;
+using Any = std::function<void(HttpContext&)>;
+
+static Any wrapTwice(Handler handler) {
+    Typed typed = handler;
+    return [typed](HttpContext& ctx) {
+        Response<std::string> response = typed(ctx);
+        ctx.res.setStatus(response.status);
+        ctx.res.setBody(response.data);
+    };
+}
+
+// Current layout: the handler stored once in its own type and called
+// through one virtual call (mirrors HttpServer::HandlerOf)
+struct Stored {
+    virtual ~Stored() = default;
+    virtual void operator()(HttpContext& ctx) const = 0;
+};
+
+struct StoredHandler final : Stored {
+    Handler fn;
+    explicit StoredHandler(Handler fn) : fn(std::move(fn)) {}
+    void operator()(HttpContext& ctx) const override {
+        Response<std::string> response = fn(ctx);
+        ctx.res.setStatus(response.status);
+        ctx.res.setBody(response.data);
+    }
+};
+
+// The same, behind a chain of two middleware composed at registration
+// (mirrors HttpServer::ChainedHandler)
+template <typename Chain>
+struct ChainedHandler final : Stored {
+    Chain chain;
+    Handler fn;
+    ChainedHandler(Chain chain, Handler fn) : chain(std::move(chain)), fn(std::move(fn)) {}
+    void operator()(HttpContext& ctx) const override {
+        chain.run(ctx, [this](HttpContext& c) {
+            Response<std::string> response = fn(c);
+            c.res.setStatus(response.status);
+            c.res.setBody(response.data);
+        });
+    }
+};
+
+static size_t calls = 0;
+
+constexpr RouteTable fixedRoutes{
+    StaticRoute(HttpMethod::GET, "/bench", [](HttpContext&) { return Ok(calls % 64 < 40 ? "ok" : "no"); }),
+};
+
+template <typename F>
+static double nanosPerCall(size_t iterations, F&& call) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        call();
+        calls++;
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / iterations;
+}
+
+int main() {
+    const size_t iterations = 5000000;
+    const size_t routes = 64;
+    Handler handler{"hello, this greeting is longer than SSO", &calls};
+
+    std::vector<Any> wrapped;
+    std::vector<std::unique_ptr<Stored>> stored;
+    std::vector<std::unique_ptr<Stored>> chained;
+    auto check = [](HttpContext& ctx, auto&& next) {
+        if (ctx.req.path.empty()) return;
+        next();
+    };
+    auto tag = [](HttpContext& ctx, auto&& next) {
+        next();
+        if (ctx.res.getStatus() != HttpStatus::OK) calls++;
+    };
+    for (size_t i = 0; i < routes; i++) {
+        wrapped.push_back(wrapTwice(handler));
+        stored.push_back(std::make_unique<StoredHandler>(handler));
+        auto middleware = Middleware::chain(check, tag);
+        chained.push_back(std::make_unique<ChainedHandler<decltype(middleware)>>(middleware, handler));
+    }
+
+    HttpContext ctx(INVALID_SOCK);
+    ctx.req.method = "GET";
+    ctx.req.methodType = HttpMethod::GET;
+    ctx.req.path = "/bench";
+
+    double copied = nanosPerCall(iterations, [&] {
+        Any local = wrapped[calls % routes];
+        local(ctx);
+    });
+    double twice = nanosPerCall(iterations, [&] {
+        wrapped[calls % routes](ctx);
+    });
+    double once = nanosPerCall(iterations, [&] {
+        (*stored[calls % routes])(ctx);
+    });
+    double withMiddleware = nanosPerCall(iterations, [&] {
+        (*chained[calls % routes])(ctx);
+    });
+    double table = nanosPerCall(iterations, [&] {
+        uint32_t allowed = 0;
+        decltype(fixedRoutes)::dispatch(&fixedRoutes, ctx, allowed);
+    });
+
+    std::cout << std::left << std::fixed << std::setprecision(1)
+              << std::setw(44) << "std::function x2, copied per request" << copied << " ns" << std::endl
+              << std::setw(44) << "std::function x2, called in place" << twice << " ns" << std::endl
+              << std::setw(44) << "stored once, one virtual call" << once << " ns" << std::endl
+              << std::setw(44) << "stored once, two middleware composed" << withMiddleware << " ns" << std::endl
+              << std::setw(44) << "RouteTable lookup and direct call" << table << " ns" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,59 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "HttpServer.h"
+#include "Middleware.h"
+#include "ResponseCache.h"
+
+// Time to produce the bytes of a JSON response from its handler, against
+// serving the same response from a ResponseCache
+template <typename F>
+static double nanosPerRequest(size_t iterations, F&& request) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        request();
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / iterations;
+}
+
+int main() {
+    const size_t iterations = 20000;
+
+    json rows = json::array();
+    for (int i = 0; i < 200; i++) {
+        rows.push_back({{"id", i}, {"name", "user-" + std::to_string(i)}, {"active", i % 3 != 0}});
+    }
+    auto handler = [&rows](HttpContext& ctx) {
+        ctx.res.setJson(rows);
+    };
+
+    auto cached = Middleware::chain(Middleware::ResponseCache(std::chrono::seconds(60)));
+    size_t bytes = 0;
+
+    auto request = [&](bool cache) {
+        HttpContext ctx(INVALID_SOCK);
+        ctx.req.method = "GET";
+        ctx.req.methodType = HttpMethod::GET;
+        ctx.req.path = "/rows";
+        ctx.req.headers["Accept-Encoding"] = "gzip";
+        if (cache) {
+            cached.run(ctx, handler);
+        } else {
+            handler(ctx);
+        }
+        bytes += ctx.res.toString().size();
+    };
+
+    double direct = nanosPerRequest(iterations, [&] { request(false); });
+    double hit = nanosPerRequest(iterations, [&] { request(true); });
+
+    std::cout << std::left << std::fixed << std::setprecision(1)
+              << std::setw(40) << "handler, JSON dump and gzip" << direct / 1000 << " us" << std::endl
+              << std::setw(40) << "ResponseCache hit" << hit / 1000 << " us" << std::endl
+              << "(" << bytes / (2 * iterations) << " bytes per response)" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,169 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "Router.h"
+#include "RouteTable.h"
+
+// Lookup cost against route table size for the radix router, next to the
+// previous approach of one std::regex per pattern tried in turn.
+static std::vector<std::string> makePatterns(size_t resources) {
+    std::vector<std::string> patterns;
+    for (size_t i = 0; i < resources; i++) {
+        std::string base = "/api/v1/resource" + std::to_string(i);
+        patterns.push_back(base);
+        patterns.push_back(base + "/{id:int}");
+        patterns.push_back(base + "/{id:int}/items/{name}");
+        patterns.push_back("/files" + std::to_string(i) + "/{path*}");
+    }
+    return patterns;
+}
+
+// One std::regex per pattern, the way routes were matched before
+class RegexRoutes {
+public:
+    explicit RegexRoutes(const std::vector<std::string>& patterns) {
+        for (const std::string& pattern : patterns) {
+            std::string expr;
+            for (size_t pos = 0; pos < pattern.size(); pos++) {
+                if (pattern[pos] == '{') {
+                    size_t end = pattern.find('}', pos);
+                    std::string param = pattern.substr(pos + 1, end - pos - 1);
+                    if (param.find(":int") != std::string::npos) {
+                        expr += "([0-9]+)";
+                    } else if (param.back() == '*') {
+                        expr += "(.*)";
+                    } else {
+                        expr += "([^/]+)";
+                    }
+                    pos = end;
+                } else {
+                    expr += pattern[pos];
+                }
+            }
+            regexes.emplace_back("^" + expr + "$");
+        }
+    }
+
+    bool match(const std::string& path) const {
+        std::smatch matches;
+        for (const std::regex& regex : regexes) {
+            if (std::regex_match(path, matches, regex)) return true;
+        }
+        return false;
+    }
+
+private:
+    std::vector<std::regex> regexes;
+};
+
+static Response<std::string> ok(HttpContext&) { return Ok("OK"); }
+
+// A fixed API resolved by the compile-time table and by the radix tree
+constexpr RouteTable fixedRoutes{
+    StaticRoute(HttpMethod::GET, "/health", &ok),
+    StaticRoute(HttpMethod::GET, "/api/v1/users", &ok),
+    StaticRoute(HttpMethod::POST, "/api/v1/users", &ok),
+    StaticRoute(HttpMethod::GET, "/api/v1/orders", &ok),
+    StaticRoute(HttpMethod::POST, "/api/v1/orders", &ok),
+    StaticRoute(HttpMethod::GET, "/api/v1/products", &ok),
+    StaticRoute(HttpMethod::GET, "/api/v1/products/featured", &ok),
+    StaticRoute(HttpMethod::GET, "/api/v1/session", &ok),
+};
+
+// Keeps the lookups from being optimized away
+static volatile size_t sink;
+
+template <typename F>
+static double nanosPerCall(size_t iterations, F&& call) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        call();
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / iterations;
+}
+
+int main() {
+    const std::vector<size_t> sizes = {10, 75, 250, 2500};
+
+    std::cout << std::left << std::setw(10) << "routes"
+              << std::setw(10) << "lookup"
+              << std::setw(14) << "radix ns"
+              << "regex ns" << std::endl;
+
+    for (size_t resources : sizes) {
+        std::vector<std::string> patterns = makePatterns(resources);
+        Router router;
+        for (size_t i = 0; i < patterns.size(); i++) {
+            router.add(patterns[i], i);
+        }
+
+        // The regex scan is too slow to build and run for the largest table
+        std::unique_ptr<RegexRoutes> regexRoutes;
+        if (patterns.size() <= 1000) {
+            regexRoutes = std::make_unique<RegexRoutes>(patterns);
+        }
+
+        const std::string last = std::to_string(resources - 1);
+        const std::pair<const char*, std::string> lookups[] = {
+            {"static", "/api/v1/resource" + last},
+            {"params", "/api/v1/resource" + last + "/42/items/widget"},
+            {"wildcard", "/files" + last + "/css/site/main.css"},
+            {"miss", "/api/v2/unknown/42"},
+        };
+
+        for (const auto& [label, path] : lookups) {
+            size_t matched = 0;
+            double radix = nanosPerCall(1000000, [&] {
+                Router::Params params;
+                matched += router.match(path, params) != nullptr;
+            });
+
+            std::cout << std::left << std::setw(10) << patterns.size()
+                      << std::setw(10) << label
+                      << std::setw(14) << std::fixed << std::setprecision(1) << radix;
+            if (regexRoutes) {
+                size_t iterations = std::max<size_t>(10, 200000 / patterns.size());
+                double regex = nanosPerCall(iterations, [&] { matched += regexRoutes->match(path); });
+                std::cout << regex;
+            } else {
+                std::cout << "-";
+            }
+            std::cout << std::endl;
+            sink = matched;
+        }
+    }
+
+    std::cout << "\n" << std::left << std::setw(30) << "fixed route"
+              << std::setw(14) << "table ns"
+              << "radix ns" << std::endl;
+
+    Router router;
+    const char* fixedPaths[] = {"/health", "/api/v1/users", "/api/v1/orders", "/api/v1/products",
+                                "/api/v1/products/featured", "/api/v1/session"};
+    for (size_t i = 0; i < std::size(fixedPaths); i++) {
+        router.add(fixedPaths[i], i);
+    }
+
+    for (std::string_view path : {"/health", "/api/v1/products/featured", "/api/v1/missing"}) {
+        size_t matched = 0;
+        double table = nanosPerCall(10000000, [&] {
+            matched += fixedRoutes.find(path, HttpMethod::GET) != fixedRoutes.NONE;
+        });
+        double radix = nanosPerCall(10000000, [&] {
+            Router::Params params;
+            matched += router.match(path, params) != nullptr;
+        });
+        std::cout << std::left << std::setw(30) << path
+                  << std::setw(14) << std::fixed << std::setprecision(1) << table
+                  << radix << std::endl;
+        sink = matched;
+    }
+
+    return 0;
+}
@@ -1,17 +1,56 @@
+#include <atomic>
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <string>
+#include <vector>
+#include <thread>
 
 #include "HttpStatus.h"
 #include "HttpRequest.h"
 #include "HttpResponse.h"
 #include "HttpServer.h"
+#include "Middleware.h"
+#include "RateLimiter.h"
+#include "ResponseCache.h"
+#include "SingleFlight.h"
+#include "RouteTable.h"
 
 #include "json.hpp"
 using json = nlohmann::json;
 
+// Fixed routes, dispatched without a lookup in the runtime router
+constexpr RouteTable staticRoutes{
+    StaticRoute(HttpMethod::GET, "/get-contact", [](HttpContext&) -> Response<json> {
+        return { json({{"name", "John Doe"}, {"email", "john.doe@mail.com"}}) };
+    }),
+};
+
 int main() {
     try {
         HttpServer server("0.0.0.0", 8000);
+        server.mount(staticRoutes);
+
+        // Bodies compressed once are reused while they stay in this 1 MB
+        server.setCompressionCache(1024 * 1024);
+
+        // Runs around every request; headers added after next() apply to
+        // any response not already streamed
+        server.use([](HttpContext& ctx, auto&& next) {
+            next();
+            if (!ctx.res.isStreamed()) {
+                ctx.res.setHeader("X-Content-Type-Options", "nosniff");
+            }
+        });
+
+        auto requireToken = [](HttpContext& ctx, auto&& next) {
+            if (ctx.req.headers.get("Authorization") != "Bearer secret") {
+                ctx.res.setStatus(HttpStatus::UNAUTHORIZED);
+                ctx.res.setBody("Unauthorized\n");
+                return;
+            }
+            next();
+        };
 
         server.get("/", [](HttpContext& ctx) -> Response<std::string> {
             if (ctx.req.params.has("name")) {
@@ -28,9 +67,116 @@ int main() {
             return { HttpStatus::OK, "Hello, world!" };
         });
 
-        server.get("/get-contact", [](HttpContext& ctx) -> Response<json> {
-            return { json({{"name", "John Doe"}, {"email", "john.doe@mail.com"}}) };
-        });        
+        server.get("/contacts", [](HttpContext& ctx) -> Response<HttpResponse> {
+            json contacts = json::array({
+                {{"name", "John Doe"}, {"email", "john.doe@mail.com"}, {"admin", true}},
+                {{"name", "Jane <Smith>"}, {"email", "jane@mail.com"}, {"admin", false}}
+            });
+            return ctx.res.renderTemplate("contacts.html", {{"title", "Contacts"}, {"contacts", contacts}});
+        });
+
+        server.get("/contacts/{id:int}", [](HttpContext& ctx) -> Response<json> {
+            int id = ctx.path_vars.getInt("id");
+            if (id != 1) {
+                return { HttpStatus::NOT_FOUND, json({{"error", "Contact not found"}}) };
+            }
+            return { json({{"id", id}, {"name", "John Doe"}, {"email", "john.doe@mail.com"}}) };
+        });
+
+        // Served from memory for a second, then stale for up to ten more
+        // while one request refreshes it; ?v=... selects separate entries
+        Middleware::ResponseCache::Options statsCache;
+        statsCache.ttl = std::chrono::seconds(1);
+        statsCache.staleWhileRevalidate = std::chrono::seconds(10);
+        statsCache.queryParams = {"v"};
+        std::atomic<int> generation{0};
+
+        // delay (at most 2 s) stands in for an expensive handler; it is not
+        // part of the key
+        auto stats = [&generation](HttpContext& ctx) -> Response<json> {
+            std::this_thread::sleep_for(std::chrono::milliseconds(std::min(std::stoi(ctx.req.params.get("delay", "0")), 2000)));
+            json body = {{"generation", ++generation}};
+            if (ctx.path_vars.has("name")) {
+                body["name"] = ctx.path_vars.getString("name");
+            }
+            return { body };
+        };
+        Middleware::ResponseCache statsResponses(statsCache);
+        server.get("/stats", Middleware::chain(statsResponses), stats);
+        server.get("/stats/{name}", Middleware::chain(statsResponses), stats);
+
+        // Identical requests arriving while one is running share its response
+        std::atomic<int> reports{0};
+
+        server.get("/report", Middleware::chain(Middleware::SingleFlight()),
+                   [&reports](HttpContext&) -> Response<json> {
+            std::this_thread::sleep_for(std::chrono::milliseconds(300));
+            return { json({{"report", ++reports}}) };
+        });
+
+        // Static files read once for everyone asking at the same time; the
+        // sleep stands in for slow storage
+        server.get("/shared/{path*}", Middleware::chain(Middleware::SingleFlight()), [](HttpContext& ctx) {
+            std::string path = ctx.path_vars.getString("path");
+            if (path.find("..") != std::string::npos) {
+                ctx.res.setStatus(HttpStatus::NOT_FOUND).setBody("Not Found\n");
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(300));
+            ctx.res.sendFile(Config::STATIC_DIR + "/" + path);
+        });
+
+        // Answers with the pattern that matched and its variables
+        auto matched = [](std::string pattern, std::vector<std::string> vars) {
+            return [pattern, vars](HttpContext& ctx) -> Response<json> {
+                json body = {{"pattern", pattern}};
+                for (const auto& name : vars) {
+                    body[name] = ctx.path_vars.getString(name);
+                }
+                return { body };
+            };
+        };
+
+        // Registered from the least specific on; matching does not depend
+        // on the order
+        server.get("/pick/{rest*}", matched("/pick/{rest*}", {"rest"}));
+        server.get("/pick/{name}", matched("/pick/{name}", {"name"}));
+        server.get("/pick/{id:int}", matched("/pick/{id:int}", {"id"}));
+        server.get("/pick/latest", matched("/pick/latest", {}));
+
+        // /edit/latest/edit leaves the static branch for {name}
+        server.get("/edit/latest/feed", matched("/edit/latest/feed", {}));
+        server.get("/edit/{name}/edit", matched("/edit/{name}/edit", {"name"}));
+
+        server.get("/raw/*", matched("/raw/*", {"*"}));
+        server.get("/export/{name}.json", matched("/export/{name}.json", {"name"}));
+
+        // Typed variables; a value out of range for its type does not match
+        Router::defineType("hex", [](std::string_view value) {
+            return !value.empty() && value.find_first_not_of("0123456789abcdefABCDEF") == std::string_view::npos;
+        });
+        server.get("/typed/int/{v:int}", [](HttpContext& ctx) -> Response<json> {
+            return { json({{"value", ctx.path_vars.getInt("v")}}) };
+        });
+        server.get("/typed/int64/{v:int64}", [](HttpContext& ctx) -> Response<json> {
+            return { json({{"value", ctx.path_vars.getInt64("v")}}) };
+        });
+        server.get("/typed/uint/{v:uint}", [](HttpContext& ctx) -> Response<json> {
+            return { json({{"value", ctx.path_vars.getUint("v")}}) };
+        });
+        server.get("/typed/uuid/{v:uuid}", matched("/typed/uuid/{v:uuid}", {"v"}));
+        server.get("/typed/hex/{v:hex}", matched("/typed/hex/{v:hex}", {"v"}));
+
+        server.get("/compression-stats", [](HttpContext&) -> Response<json> {
+            Compression::CacheStats stats = Compression::cacheStats();
+            return { json({{"hits", stats.hits}, {"misses", stats.misses}, {"evictions", stats.evictions},
+                           {"entries", stats.entries}, {"bytes", stats.bytes}}) };
+        });
+
+        // Handlers may also write ctx.res directly
+        server.get("/whoami", [](HttpContext& ctx) {
+            ctx.res.setJson({{"ip", ctx.peer.ip}, {"port", ctx.peer.port}});
+        });
 
         server.get("/set-cookie", [](HttpContext& ctx) -> Response<HttpResponse> {
             ctx.res.setCookie("name", "value");
@@ -78,7 +224,10 @@ int main() {
                 .setBody("Bad Request");
         });
 
-        server.post("/upload-file", [](HttpContext& ctx) -> Response<std::string> {
+        // At most 5 uploads at once and 1 per second after that, per client
+        Middleware::RateLimiter uploadLimit(1, 5);
+
+        server.post("/upload-file", Middleware::chain(uploadLimit), [](HttpContext& ctx) -> Response<std::string> {
             if (ctx.req.files.empty()) {
                 return { HttpStatus::BAD_REQUEST, "No files uploaded" };
             }
@@ -95,6 +244,41 @@ int main() {
             return Ok("Successfully received chunked data");
         });        
 
+        server.get("/export", [](HttpContext& ctx, ResponseWriter& out) {
+            int rows = std::stoi(ctx.req.params.get("rows", "1000"));
+            ctx.res.setHeader("Content-Type", "text/csv");
+            out << "id,name\n";
+            for (int i = 1; i <= rows && out.good(); i++) {
+                out << std::to_string(i) + ",user-" + std::to_string(i) + "\n";
+            }
+        });
+
+        auto& events = server.sse("/events");
+
+        server.post("/publish", Middleware::chain(requireToken), [&events](HttpContext& ctx) -> Response<std::string> {
+            size_t delivered = events.publish(ctx.req.getBody(), "message");
+            return Ok("Delivered to " + std::to_string(delivered) + " subscriber(s)");
+        });
+
+        WebSocketHandlers chat;
+        WebSocketChannel* room = nullptr;
+        chat.onMessage = [&room](WebSocket& ws, const std::string& message, bool binary) {
+            if (binary) {
+                ws.sendBinary(message);
+            } else {
+                room->broadcast(message);
+            }
+        };
+        room = &server.websocket("/ws", chat);
+
+        WebSocketHandlers echo;
+        echo.onMessage = [](WebSocket& ws, const std::string& message, bool binary) {
+            binary ? ws.sendBinary(message) : ws.sendText(message);
+        };
+        WebSocketCompression keepContext;
+        keepContext.serverContextTakeover = true;
+        server.websocket("/ws/echo", echo, keepContext);
+
         server.run();     
     } catch (const HttpServer::ServerException& e) {
         std::cerr << "Server error: " << e.what() << std::endl;
@@ -0,0 +1,49 @@
+#ifndef BACKGROUND_TASKS_H
+#define BACKGROUND_TASKS_H
+
+#include <mutex>
+#include <deque>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <functional>
+#include <condition_variable>
+
+#include "Config.h"
+
+// A few worker threads for short jobs no client waits for, such as
+// ResponseCache refreshes. Workers start with the first job. At most
+// maxQueued jobs wait; post() refuses more, so a burst of them cannot
+// start a thread each. HttpServer owns one and stops it on shutdown,
+// before its routes go away.
+class BackgroundTasks {
+public:
+    explicit BackgroundTasks(size_t threads = Config::BACKGROUND_THREADS,
+                             size_t maxQueued = Config::BACKGROUND_QUEUE);
+    ~BackgroundTasks();
+
+    BackgroundTasks(const BackgroundTasks&) = delete;
+    BackgroundTasks& operator=(const BackgroundTasks&) = delete;
+
+    // False, and job is not run, when the queue is full or stopped
+    bool post(std::function<void()> job);
+
+    // Accepts jobs again after stop()
+    void start();
+    // Refuses new jobs, runs those already queued and joins the workers
+    void stop();
+
+private:
+    size_t threads_;
+    size_t maxQueued_;
+
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    std::deque<std::function<void()>> jobs_;
+    std::vector<std::thread> workers_;
+    bool stopped_ = false;
+
+    void work();
+};
+
+#endif // BACKGROUND_TASKS_H
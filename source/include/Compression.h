@@ -0,0 +1,132 @@
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+#include "Config.h"
+
+struct z_stream_s;
+
+namespace Compression {
+    // Content codings. Brotli and Zstd are only available when the server
+    // was built against those libraries (CPPSERVER_HAVE_BROTLI/_ZSTD).
+    enum class Encoding { Identity, Gzip, Brotli, Zstd };
+
+    const char* encodingName(Encoding encoding);
+    bool isAvailable(Encoding encoding);
+
+    struct Policy {
+        // Bodies smaller than this are sent uncompressed
+        size_t minSize = Config::COMPRESSION_MIN_SIZE;
+        int defaultLevel = Config::COMPRESSION_LEVEL;
+
+        // Content-Type prefix -> level, first match wins. Levels use zlib's
+        // 1-9 scale; brotli and zstd map them to a comparable setting.
+        std::vector<std::pair<std::string, int>> levelsByType;
+
+        // Codings in order of preference, used to break ties between codings
+        // the client rates equally. Unavailable codings are skipped.
+        std::vector<Encoding> encodings = {Encoding::Zstd, Encoding::Brotli, Encoding::Gzip};
+
+        // Content-Type prefix -> preference list, first match wins
+        std::vector<std::pair<std::string, std::vector<Encoding>>> encodingsByType;
+
+        // Bodies at least this large use largeBodyLevel (0 disables)
+        size_t largeBodySize = 1024 * 1024;
+        int largeBodyLevel = 4;
+
+        // Drop to highLoadLevel while the share of busy workers is above
+        // highLoadThreshold
+        bool adaptToLoad = false;
+        double highLoadThreshold = 0.75;
+        int highLoadLevel = 1;
+    };
+
+    void setPolicy(const Policy& policy);
+    const Policy& policy();
+    int chooseLevel(const std::string& contentType, size_t size);
+
+    // Worker load tracking used by Policy::adaptToLoad
+    class BusyScope {
+    public:
+        BusyScope();
+        ~BusyScope();
+        BusyScope(const BusyScope&) = delete;
+        BusyScope& operator=(const BusyScope&) = delete;
+    };
+    double utilization();
+
+    // Content negotiation
+    bool isCompressible(const std::string& contentType);
+    bool isCompressibleExtension(const std::string& path);
+
+    // Candidates the client accepts, ordered by Accept-Encoding q-value with
+    // ties kept in candidate order. Codings rated below an explicitly listed
+    // identity are dropped.
+    std::vector<Encoding> rankEncodings(const std::string& acceptEncoding, const std::vector<Encoding>& candidates);
+
+    // Best available coding for a response of contentType under the current
+    // policy; Identity when the client accepts none of them
+    Encoding negotiate(const std::string& acceptEncoding, const std::string& contentType);
+
+    // Encoders
+    std::string gzip(const std::string& content, int level = Config::COMPRESSION_LEVEL);
+    std::string encode(Encoding encoding, const std::string& content, int level = Config::COMPRESSION_LEVEL);
+
+    // Incremental encoder for streamed bodies. Each call appends whatever
+    // output the encoder produced; Sync makes everything written so far
+    // decodable by the client, Finish ends the stream.
+    class EncoderStream {
+    public:
+        enum class Flush { None, Sync, Finish };
+
+        virtual ~EncoderStream() = default;
+        virtual void write(const char* data, size_t length, std::string& out, Flush flush) = 0;
+    };
+
+    std::unique_ptr<EncoderStream> makeStream(Encoding encoding, int level);
+
+    class GzipStream : public EncoderStream {
+    public:
+        explicit GzipStream(int level);
+        ~GzipStream() override;
+
+        GzipStream(const GzipStream&) = delete;
+        GzipStream& operator=(const GzipStream&) = delete;
+
+        void write(const char* data, size_t length, std::string& out, Flush flush) override;
+
+    private:
+        std::unique_ptr<z_stream_s> zs;
+    };
+
+    // Bounded LRU of compressed bodies keyed by a hash of (body, encoding,
+    // level), in lock-striped lists sharing maxBytes evenly; a hit is
+    // checked against the stored body, which counts towards maxBytes.
+    // Disabled while maxBytes is 0.
+    struct CacheStats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        size_t entries = 0;
+        size_t bytes = 0;
+    };
+
+    void setCacheCapacity(size_t maxBytes);
+    CacheStats cacheStats();
+    std::string gzipCached(const std::string& content, int level);
+    std::string encodeCached(Encoding encoding, const std::string& content, int level);
+
+    // Generates missing or stale .gz siblings (and .br when brotli is
+    // available) for every compressible file under dir using the given
+    // number of worker threads (0 = hardware concurrency). Returns the number
+    // of variants written.
+    size_t precompressDirectory(const std::string& dir, unsigned int threads = 0);
+}
+
+#endif // COMPRESSION_H
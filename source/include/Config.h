@@ -2,6 +2,7 @@
 #define CONFIG_H
 
 #include <cstddef>
+#include <cstdint>
 #include <string>
 
 namespace Config {
@@ -14,10 +15,60 @@ namespace Config {
     const size_t MAX_REQUEST_SIZE = 1024 * 1024 * 10; // 10MB
     const int SOCKET_TIMEOUT = 30; // 30 seconds
     const int BUFFER_SIZE = 8192; // 8KB buffer
+    const size_t MAX_RANGES = 16; // Range headers with more parts are served in full
+    const size_t MAX_PATH_VARS = 16; // per route pattern
+    const size_t STREAM_FLUSH_SIZE = 16384; // ResponseWriter sends a chunk once this much is buffered
     
     // File paths
     const std::string STATIC_DIR = "static";
     const std::string TEMPLATE_DIR = "templates";
+    const bool TEMPLATE_DEV_MODE = false; // always load from TEMPLATE_DIR, ignoring templates compiled into the binary
+
+    // Compression settings (defaults for Compression::Policy)
+    const size_t COMPRESSION_MIN_SIZE = 1024;
+    const int COMPRESSION_LEVEL = 6;
+    const size_t COMPRESSION_CACHE_SIZE = 0; // bytes of compressed bodies to keep, 0 = disabled
+    const size_t COMPRESSION_CACHE_STRIPES = 16; // LRU lists, each with its own lock
+
+    // Static compression settings
+    const bool PRECOMPRESS_STATIC_ON_STARTUP = false; // generate missing .gz siblings in run()
+    const unsigned int PRECOMPRESS_THREADS = 0;       // 0 = hardware concurrency
+
+    // Rate limiting (defaults for Middleware::RateLimiter::Options)
+    const int RATE_LIMIT_TTL = 60;       // seconds a full bucket is kept before it is dropped
+    const size_t RATE_LIMIT_SHARDS = 64; // hash table shards, each with its own lock
+    const size_t RATE_LIMIT_SWEEP_BATCH = 64; // hash buckets a request sweeps at most
+
+    // Response caching (defaults for Middleware::ResponseCache::Options)
+    const size_t RESPONSE_CACHE_SIZE = 64 * 1024 * 1024; // bytes of serialized responses per cache
+    const size_t RESPONSE_CACHE_STRIPES = 16;            // LRU lists, each with its own lock
+
+    // Background jobs (stale-while-revalidate refreshes)
+    const size_t BACKGROUND_THREADS = 2; // workers per server
+    const size_t BACKGROUND_QUEUE = 64;  // jobs waiting at most; more are refused
+
+    // Request coalescing (defaults for Middleware::SingleFlight::Options)
+    const int SINGLE_FLIGHT_MAX_WAIT = 5000; // milliseconds to wait for an identical request before running alone
+    const size_t SINGLE_FLIGHT_SHARDS = 16;  // in-flight tables, each with its own lock
+
+    // Event loop settings (event streams, WebSockets)
+    const size_t EVENT_LOOP_MAX_QUEUE = 1024 * 1024; // per connection; droppable messages beyond this are discarded
+    const int EVENT_LOOP_LINGER = 2; // seconds a closed connection waits for the peer to close its side
+    const int SSE_HEARTBEAT_INTERVAL = 15; // seconds of silence before a comment line is sent
+    const size_t WEBSOCKET_MAX_MESSAGE_SIZE = 16 * 1024 * 1024; // reassembled message limit, closes with 1009 beyond it
+    const bool WEBSOCKET_DEFLATE = true;                 // negotiate permessage-deflate when the client offers it
+    const size_t WEBSOCKET_DEFLATE_MIN_SIZE = 128;       // smaller messages are sent uncompressed
+    const int WEBSOCKET_DEFLATE_MEM_LEVEL = 8;           // zlib memLevel for connections keeping their context
+    const size_t WEBSOCKET_DEFLATE_MEMORY_LIMIT = 64 * 1024 * 1024; // total zlib state for context takeover
+
+    // HTTP/2 settings (cleartext h2c, via prior knowledge or Upgrade)
+    constexpr bool HTTP2_ENABLED = true;
+    const uint32_t HTTP2_MAX_CONCURRENT_STREAMS = 100;
+    const uint32_t HTTP2_INITIAL_WINDOW_SIZE = 1024 * 1024;         // per-stream receive window
+    const uint32_t HTTP2_CONNECTION_WINDOW_SIZE = 16 * 1024 * 1024; // receive window shared by all streams
+    const size_t HTTP2_HEADER_TABLE_SIZE = 4096;                    // HPACK dynamic table, both directions
+    const size_t HTTP2_MAX_HEADER_LIST_SIZE = 64 * 1024;
+    const int HTTP2_IDLE_TIMEOUT = 60; // seconds without open streams before the connection is closed
 
     // Keep-alive settings
     constexpr bool KEEP_ALIVE_ENABLED = true;
@@ -0,0 +1,114 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "Defs.h"
+#include "Config.h"
+
+// Single-threaded poll() loop for long-lived connections (event streams,
+// WebSockets) so they do not each pin a worker thread. Connections are
+// handed over after the HTTP exchange that opened them; any thread may
+// queue data on them, the loop thread does all socket I/O.
+class EventLoop {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Buffer = std::shared_ptr<const std::string>;
+
+    class Connection : public std::enable_shared_from_this<Connection> {
+    public:
+        explicit Connection(socket_t fd, size_t maxQueuedBytes = Config::EVENT_LOOP_MAX_QUEUE);
+        virtual ~Connection();
+
+        Connection(const Connection&) = delete;
+        Connection& operator=(const Connection&) = delete;
+
+        // Queues a shared buffer. A droppable buffer is discarded (and false
+        // returned) when it would push the queue past its limit, so one slow
+        // client cannot hold unbounded memory.
+        bool send(Buffer data, bool droppable = true);
+
+        // Closes once everything queued so far has been written; the socket
+        // is shut down for writing first and kept open until the peer closes
+        // its side (or Config::EVENT_LOOP_LINGER passes), so unread input
+        // does not turn the close into a reset that loses what was queued
+        void close();
+
+        bool isClosed() const { return closed.load(std::memory_order_acquire); }
+        size_t getQueuedBytes() const;
+        size_t getMaxQueuedBytes() const { return maxQueuedBytes; }
+        uint64_t getDroppedCount() const { return dropped.load(std::memory_order_relaxed); }
+        socket_t getFd() const { return fd; }
+
+    protected:
+        // Loop thread only
+        virtual void onData(const char* data, size_t length) { (void)data; (void)length; }
+        virtual void onTick(Clock::time_point now) { (void)now; }
+        virtual void onClosed() {}
+
+        Clock::time_point getLastSend() const;
+        EventLoop* loop = nullptr;
+
+    private:
+        friend class EventLoop;
+
+        bool hasPending() const;
+        bool flushPending();
+
+        socket_t fd;
+        size_t maxQueuedBytes;
+        Clock::time_point lastSend;
+        mutable std::mutex mutex;
+        std::deque<Buffer> queue;
+        size_t frontOffset = 0;
+        size_t queuedBytes = 0;
+        bool closeRequested = false;
+        bool lingering = false; // loop thread only
+        Clock::time_point lingerUntil;
+        std::atomic<bool> closed{false};
+        std::atomic<uint64_t> dropped{0};
+    };
+
+    EventLoop();
+    ~EventLoop();
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    void start();
+    void stop();
+    bool isRunning() const { return running; }
+
+    // Takes over the socket: switches it to non-blocking mode and polls it
+    // until either side closes
+    void add(std::shared_ptr<Connection> connection);
+    void wake();
+    size_t size() const { return count.load(std::memory_order_relaxed); }
+
+private:
+    void run();
+    void closeConnection(const std::shared_ptr<Connection>& connection);
+
+    std::thread thread;
+    std::atomic<bool> running{false};
+    std::atomic<size_t> count{0};
+
+    std::mutex pendingMutex;
+    std::vector<std::shared_ptr<Connection>> pending;
+    std::vector<std::shared_ptr<Connection>> connections;
+
+#ifndef _WIN32
+    int wakeFds[2] = {-1, -1};
+#endif
+};
+
+#endif // EVENT_LOOP_H
@@ -0,0 +1,45 @@
+#ifndef EVENT_STREAM_H
+#define EVENT_STREAM_H
+
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+
+#include "EventLoop.h"
+
+class HttpContext;
+
+// A text/event-stream channel. Subscribers are parked on the server's event
+// loop; publish() serializes an event once and queues the same buffer on
+// every subscriber. Subscribers that fall too far behind drop events
+// instead of buffering them.
+class EventChannel {
+public:
+    explicit EventChannel(EventLoop& loop);
+
+    EventChannel(const EventChannel&) = delete;
+    EventChannel& operator=(const EventChannel&) = delete;
+
+    // Returns the number of subscribers the event was queued on
+    size_t publish(const std::string& data, const std::string& event = "", const std::string& id = "");
+    void closeAll();
+
+    size_t subscriberCount() const;
+    uint64_t droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+
+    // Sends the stream headers and hands the connection to the event loop
+    bool subscribe(HttpContext& ctx);
+
+    static std::string serialize(const std::string& data, const std::string& event, const std::string& id);
+
+private:
+    EventLoop& loop;
+    mutable std::mutex mutex;
+    std::vector<std::weak_ptr<EventLoop::Connection>> subscribers;
+    std::atomic<uint64_t> dropped{0};
+};
+
+#endif // EVENT_STREAM_H
@@ -0,0 +1,91 @@
+#ifndef HPACK_H
+#define HPACK_H
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+#include "Config.h"
+
+// HPACK header compression for HTTP/2 (RFC 7541)
+namespace Hpack {
+    using Header = std::pair<std::string, std::string>;
+    using HeaderList = std::vector<Header>;
+
+    // Malformed header block; the HTTP/2 connection must be torn down with
+    // COMPRESSION_ERROR since the decoder state is no longer shared
+    class Error : public std::runtime_error {
+    public:
+        explicit Error(const std::string& msg) : std::runtime_error(msg) {}
+    };
+
+    class DynamicTable {
+    public:
+        explicit DynamicTable(size_t maxSize) : maxSize(maxSize) {}
+
+        void add(const std::string& name, const std::string& value);
+        void setMaxSize(size_t size);
+
+        // Index 0 is the most recently added entry
+        const Header* get(size_t index) const;
+        size_t count() const { return entries.size(); }
+        size_t getMaxSize() const { return maxSize; }
+
+    private:
+        void evict();
+
+        std::deque<Header> entries;
+        size_t size = 0;
+        size_t maxSize;
+    };
+
+    class Decoder {
+    public:
+        explicit Decoder(size_t maxTableSize = Config::HTTP2_HEADER_TABLE_SIZE);
+
+        // Decodes one complete header block into headers. Once the list
+        // outgrows maxListSize (name + value + 32 per field, as in
+        // SETTINGS_MAX_HEADER_LIST_SIZE) the rest of the block is only
+        // decoded as far as the dynamic table needs, and false is returned
+        // with headers empty. Throws Hpack::Error.
+        bool decode(const uint8_t* data, size_t length, HeaderList& headers,
+                    size_t maxListSize = SIZE_MAX);
+
+    private:
+        const Header& lookup(uint64_t index) const;
+
+        DynamicTable table;
+        size_t settingsMaxSize;
+    };
+
+    class Encoder {
+    public:
+        explicit Encoder(size_t maxTableSize = Config::HTTP2_HEADER_TABLE_SIZE);
+
+        void encode(const HeaderList& headers, std::string& out);
+
+        // Applies the peer's SETTINGS_HEADER_TABLE_SIZE; the change is
+        // signalled at the start of the next block
+        void setMaxTableSize(size_t size);
+
+    private:
+        void encodeHeader(const std::string& name, const std::string& value, std::string& out);
+
+        DynamicTable table;
+        size_t preferredSize;
+        bool sizeUpdatePending = false;
+    };
+
+    void encodeInteger(uint64_t value, int prefixBits, uint8_t flags, std::string& out);
+    void encodeString(const std::string& value, std::string& out);
+
+    std::string huffmanEncode(const std::string& data);
+    std::string huffmanDecode(const uint8_t* data, size_t length);
+    size_t huffmanEncodedLength(const std::string& data);
+}
+
+#endif // HPACK_H
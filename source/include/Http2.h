@@ -0,0 +1,173 @@
+#ifndef HTTP2_H
+#define HTTP2_H
+
+#include <map>
+#include <ctime>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <cstdint>
+#include <stdexcept>
+#include <functional>
+#include <condition_variable>
+
+#include "Defs.h"
+#include "Config.h"
+#include "Hpack.h"
+#include "HttpRequest.h"
+#include "HttpResponse.h"
+
+class HttpContext;
+
+// HTTP/2 over cleartext TCP (h2c, RFC 9113), entered either with prior
+// knowledge (the client opens with the connection preface) or through an
+// HTTP/1.1 "Upgrade: h2c" request. The connection thread reads frames;
+// every request stream runs its handler on a thread of its own and the
+// frames of all streams are serialized onto the socket under flow control.
+class Http2Connection {
+public:
+    using Dispatcher = std::function<void(HttpContext&)>;
+
+    // RFC 9113 section 7 (NO_ERROR and friends clash with Windows macros)
+    enum class ErrorCode : uint32_t {
+        NONE = 0x0,
+        PROTOCOL = 0x1,
+        INTERNAL = 0x2,
+        FLOW_CONTROL = 0x3,
+        SETTINGS_TIMEOUT = 0x4,
+        STREAM_CLOSED = 0x5,
+        FRAME_SIZE = 0x6,
+        REFUSED_STREAM = 0x7,
+        CANCEL = 0x8,
+        COMPRESSION = 0x9,
+        CONNECT = 0xa,
+        ENHANCE_YOUR_CALM = 0xb,
+        INADEQUATE_SECURITY = 0xc,
+        HTTP_1_1_REQUIRED = 0xd
+    };
+
+    Http2Connection(socket_t fd, Dispatcher dispatcher, const std::atomic<bool>& running);
+    ~Http2Connection();
+
+    Http2Connection(const Http2Connection&) = delete;
+    Http2Connection& operator=(const Http2Connection&) = delete;
+
+    // "PRI * HTTP/2.0", the request line of the prior-knowledge preface
+    static bool isPreface(const HttpRequest& req);
+    // An HTTP/1.1 request carrying Upgrade: h2c and HTTP2-Settings
+    static bool isUpgradeRequest(const HttpRequest& req);
+
+    // Both return once the connection is finished; the caller closes the
+    // socket. serveUpgrade answers req itself as stream 1.
+    void serve(const HttpRequest& preface);
+    void serveUpgrade(const HttpRequest& req);
+
+private:
+    enum FrameType : uint8_t {
+        DATA = 0x0,
+        HEADERS = 0x1,
+        PRIORITY = 0x2,
+        RST_STREAM = 0x3,
+        SETTINGS = 0x4,
+        PUSH_PROMISE = 0x5,
+        PING = 0x6,
+        GOAWAY = 0x7,
+        WINDOW_UPDATE = 0x8,
+        CONTINUATION = 0x9
+    };
+
+    struct Frame {
+        uint8_t type = 0;
+        uint8_t flags = 0;
+        uint32_t streamId = 0;
+        std::string payload;
+    };
+
+    struct Stream {
+        explicit Stream(uint32_t id, int64_t sendWindow, int64_t recvWindow)
+            : id(id), sendWindow(sendWindow), recvWindow(recvWindow) {}
+
+        uint32_t id;
+        Hpack::HeaderList headers;
+        std::string body;
+        int64_t sendWindow;   // guarded by mutex
+        int64_t recvWindow;   // connection thread only
+        bool endStreamReceived = false;
+        bool reset = false;   // guarded by mutex
+        int rejectStatus = 0; // answered with this status instead of dispatching
+    };
+
+    class StreamSink;
+
+    class ConnectionError : public std::runtime_error {
+    public:
+        ConnectionError(ErrorCode code, const std::string& msg) : std::runtime_error(msg), code(code) {}
+        ErrorCode code;
+    };
+
+    // Connection thread
+    void run();
+    bool readMore();
+    bool ensureInput(size_t bytes);
+    bool readFrame(Frame& frame);
+    void handleFrame(Frame& frame);
+    void handleHeaders(Frame& frame);
+    void handleData(Frame& frame);
+    void handleSettings(const Frame& frame);
+    void handleWindowUpdate(const Frame& frame);
+    void handleRstStream(const Frame& frame);
+    void applySettings(const std::string& payload);
+    void processHeaderBlock(uint32_t streamId, const std::string& block, bool endStream);
+    void startStream(const std::shared_ptr<Stream>& stream, std::unique_ptr<HttpContext> ctx);
+    std::unique_ptr<HttpContext> buildContext(Stream& stream);
+    void sendSettings();
+
+    // Stream threads
+    void runStream(const std::shared_ptr<Stream>& stream, HttpContext& ctx);
+    bool sendHeaders(Stream& stream, const HttpResponse& res, bool streamed, bool endStream);
+    bool sendData(Stream& stream, const char* data, size_t length, bool endStream);
+    bool sendResponse(Stream& stream, HttpResponse& res);
+    void finishStream(Stream& stream);
+
+    // Any thread
+    bool writeFrame(uint8_t type, uint8_t flags, uint32_t streamId, const char* data, size_t length);
+    bool writeFrameLocked(uint8_t type, uint8_t flags, uint32_t streamId, const char* data, size_t length);
+    void resetStream(uint32_t streamId, ErrorCode code);
+    void sendGoaway(ErrorCode code);
+
+    socket_t fd;
+    Dispatcher dispatcher;
+    const std::atomic<bool>& running;
+
+    // Connection thread state
+    std::string input;
+    size_t inputOffset = 0;
+    Hpack::Decoder decoder;
+    uint32_t lastStreamId = 0;
+    uint32_t continuationStream = 0;
+    std::string headerBlock;
+    bool headerEndStream = false;
+    int64_t recvWindow;
+    bool goawayReceived = false;
+    time_t lastActivity;
+
+    // Shared between the connection thread and stream threads
+    std::mutex mutex;
+    std::condition_variable windowChanged;
+    std::condition_variable streamsFinished;
+    std::map<uint32_t, std::shared_ptr<Stream>> streams;
+    int64_t sendWindow = 65535;
+    int64_t peerInitialWindow = 65535;
+    size_t runningStreams = 0;
+    bool closing = false;
+    std::atomic<uint32_t> peerMaxFrameSize{16384};
+
+    // Frame writes, including the HPACK encoder whose state must follow
+    // the order header blocks go out in
+    std::mutex writeMutex;
+    Hpack::Encoder encoder;
+    bool writeFailed = false;
+};
+
+#endif // HTTP2_H
@@ -0,0 +1,71 @@
+#ifndef HTTP_CONTEXT_H
+#define HTTP_CONTEXT_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <string_view>
+
+#include "Defs.h"
+#include "HttpRequest.h"
+#include "HttpResponse.h"
+#include "Router.h"
+
+// Variables captured by the matched route. Values are views into the
+// request path; typed ones ({id:int}, {n:uint}, ...) were converted while
+// matching, so the getters below only parse variables declared as strings.
+class PathVars {
+public:
+    bool has(std::string_view name) const {
+        return find(name) != nullptr;
+    }
+
+    std::string_view get(std::string_view name) const {
+        return at(name).value;
+    }
+
+    std::string getString(std::string_view name) const {
+        return std::string(get(name));
+    }
+
+    // Throw std::invalid_argument if the value is not a number and
+    // std::out_of_range if it does not fit the requested type
+    int getInt(std::string_view name) const;
+    int64_t getInt64(std::string_view name) const;
+    uint64_t getUint(std::string_view name) const;
+
+    // Points the values at copy, a copy of the path they were matched in,
+    // for a context outliving the original request
+    void rebase(const std::string& matched, const std::string& copy);
+
+private:
+    friend class HttpServer;
+
+    const Router::Param* find(std::string_view name) const;
+    const Router::Param& at(std::string_view name) const;
+
+    const std::vector<std::string>* names_ = nullptr;
+    Router::Params params_;
+};
+
+// The client end of the connection, as accepted; no forwarding headers
+// are consulted
+struct PeerAddress {
+    std::string ip; // "203.0.113.7", "2001:db8::1"; empty if unknown
+    uint16_t port = 0;
+};
+
+class BackgroundTasks;
+
+class HttpContext {
+public:
+    HttpContext(socket_t connfd) : req(connfd), res(connfd, req) {}
+
+    HttpRequest req;
+    HttpResponse res;
+    PathVars path_vars;
+    PeerAddress peer;
+    BackgroundTasks* background = nullptr; // the server's, set when dispatched
+};
+
+#endif // HTTP_CONTEXT_H
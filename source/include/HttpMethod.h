@@ -0,0 +1,51 @@
+#ifndef HTTP_METHOD_H
+#define HTTP_METHOD_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// DELETE_ because <windows.h> defines DELETE
+enum class HttpMethod : uint8_t {
+    GET,
+    HEAD,
+    POST,
+    PUT,
+    PATCH,
+    DELETE_,
+    OPTIONS,
+    UNKNOWN
+};
+
+constexpr size_t HTTP_METHOD_COUNT = static_cast<size_t>(HttpMethod::UNKNOWN);
+
+// For sets of methods, as in the Allow header
+constexpr uint32_t httpMethodBit(HttpMethod method) {
+    return method == HttpMethod::UNKNOWN ? 0 : 1u << static_cast<unsigned>(method);
+}
+
+constexpr HttpMethod parseHttpMethod(std::string_view method) {
+    if (method == "GET") return HttpMethod::GET;
+    if (method == "HEAD") return HttpMethod::HEAD;
+    if (method == "POST") return HttpMethod::POST;
+    if (method == "PUT") return HttpMethod::PUT;
+    if (method == "PATCH") return HttpMethod::PATCH;
+    if (method == "DELETE") return HttpMethod::DELETE_;
+    if (method == "OPTIONS") return HttpMethod::OPTIONS;
+    return HttpMethod::UNKNOWN;
+}
+
+constexpr std::string_view httpMethodName(HttpMethod method) {
+    switch (method) {
+        case HttpMethod::GET: return "GET";
+        case HttpMethod::HEAD: return "HEAD";
+        case HttpMethod::POST: return "POST";
+        case HttpMethod::PUT: return "PUT";
+        case HttpMethod::PATCH: return "PATCH";
+        case HttpMethod::DELETE_: return "DELETE";
+        case HttpMethod::OPTIONS: return "OPTIONS";
+        default: return "";
+    }
+}
+
+#endif // HTTP_METHOD_H
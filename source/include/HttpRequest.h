@@ -4,6 +4,7 @@
 #include <string>
 
 #include "Defs.h"
+#include "HttpMethod.h"
 #include "SafeMap.h"
 #include "Config.h"
 #include "UploadedFile.h"
@@ -18,10 +19,11 @@ public:
     bool readRequest();
 
     std::string method;
+    HttpMethod methodType = HttpMethod::UNKNOWN; // parsed once from method
     std::string path;
     std::string version;
 
-    SafeMap<std::string> headers;
+    SafeMap<std::string, CaseInsensitiveLess> headers;
     SafeMap<std::string> params;
     SafeMap<std::string> forms;
     SafeMap<UploadedFile> files;
@@ -30,6 +32,8 @@ public:
 
     std::string getBody() const { return body; }
 private:
+    friend class Http2Connection;
+
     std::string body;
     
     int connfd;
@@ -41,7 +45,7 @@ private:
     void parseMultipartData();
 
     struct MultipartPart {
-        SafeMap<std::string> headers;
+        SafeMap<std::string, CaseInsensitiveLess> headers;
         std::vector<char> data;
     };
 
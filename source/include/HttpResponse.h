@@ -3,6 +3,8 @@
 
 #include <string>
 #include <map>
+#include <ctime>
+#include <memory>
 #include <utility>
 
 #include "Defs.h"
@@ -10,10 +12,33 @@
 #include "Config.h"
 #include "HttpStatus.h"
 #include "HttpRequest.h"
+#include "Compression.h"
+#include "Utils.h"
 
 #include "json.hpp"
 using json = nlohmann::json;
 
+class HttpResponse;
+
+// A response serialized once and sent any number of times (see
+// Middleware::ResponseCache): the HTTP/1.1 status line and headers, less
+// the per-connection Connection fields, and the body as it goes on the wire
+struct PreparedResponse {
+    HttpStatus status;
+    std::map<std::string, std::string> headers;
+    std::string head;
+    std::string body;
+};
+
+// Transport for responses that do not go out as HTTP/1.1 on the socket
+// (HTTP/2 streams); ResponseWriter sends through it when one is set
+class ResponseSink {
+public:
+    virtual ~ResponseSink() = default;
+    virtual bool sendHeaders(HttpResponse& res, bool endStream) = 0;
+    virtual bool sendData(const char* data, size_t length, bool endStream) = 0;
+};
+
 class HttpResponse {
 public:
     explicit HttpResponse(socket_t fd, HttpRequest& req);
@@ -24,30 +49,101 @@ public:
     HttpResponse& setHeader(const std::string& key, const std::string& value);
     HttpResponse& setBody(const std::string& content);
     HttpResponse& setJson(const json& data);
+
+    HttpResponse& setETag(const std::string& tag, bool weak = false);
+    HttpResponse& setBodyETag(bool weak = false);
+    HttpResponse& setLastModified(time_t time);
+    bool isNotModified() const;
     
     HttpResponse& setCookie(const std::string& key, const std::string& value, const std::string& path = "/", int maxAge = 0, bool secure = false, bool httpOnly = false);
     HttpResponse& redirect(const std::string& location, HttpStatus status = HttpStatus::FOUND);
     HttpResponse& renderTemplate(const std::string& templateName);
+    HttpResponse& renderTemplate(const std::string& templateName, const json& data);
+    // Any type with a to_json overload can be the template context
+    template<typename T>
+    HttpResponse& renderTemplate(const std::string& templateName, const T& data) {
+        return renderTemplate(templateName, json(data));
+    }
 
     HttpResponse& sendFile(const std::string& fullPath);
 
     std::string toString();
 
+    // Finishes the validators and compresses the body for the request's
+    // Accept-Encoding, once. The built-in Middleware::Compress calls it
+    // after the route; serializing or sending does if nothing did.
+    HttpResponse& compress();
+
+    // Finishes the response for this request (compression, validators) and
+    // returns it serialized
+    std::shared_ptr<const PreparedResponse> serialize();
+    // Answers with a serialized response. Headers set afterwards are still
+    // sent; the body is final. Conditional requests get 304 as usual.
+    HttpResponse& setPrepared(std::shared_ptr<const PreparedResponse> response);
+
+    // Sends the response now rather than when the handler returns, for a
+    // handler with more work to do that the client need not wait for
+    bool send();
+
     socket_t getConnfd() const { return connfd; }
+    HttpStatus getStatus() const { return statusCode; }
+    std::string getHeader(const std::string& key) const {
+        auto it = headers.find(key);
+        return it != headers.end() ? it->second : "";
+    }
+
+    // True once a ResponseWriter took over the connection; the server then
+    // must not send this response again
+    bool isStreamed() const { return streamState != StreamState::None; }
+    bool isStreamComplete() const { return streamState == StreamState::Finished; }
+
+    // Hands the socket to someone else (e.g. the event loop); the server
+    // neither sends this response nor closes the connection
+    HttpResponse& detach() { streamState = StreamState::Detached; return *this; }
+    bool isDetached() const { return streamState == StreamState::Detached; }
+
+    HttpResponse& setSink(ResponseSink* target) { sink = target; return *this; }
+    // True when the response travels as one stream of a multiplexed
+    // connection, which cannot be detached
+    bool isMultiplexed() const { return sink != nullptr; }
 
 private:
+    friend class ResponseWriter;
+    friend class Http2Connection;
+    friend class HttpServer;
+
+    // Started: a ResponseWriter exists but has not sent the head yet
+    enum class StreamState { None, Started, Streaming, Finished, Detached };
+
     socket_t connfd;
-    HttpRequest req;
+    HttpRequest* req;
 
     HttpStatus statusCode;
     std::map<std::string, std::string> headers;
     std::string body;
 
+    time_t lastModified;
+    bool bodyETag;
+    bool bodyETagWeak;
+    StreamState streamState;
+    ResponseSink* sink;
+    bool encoded; // compress() has run on the current body
+    bool prepared; // prepareResponse() has run
+    std::shared_ptr<const PreparedResponse> preparedResponse; // sent as is over HTTP/1.1
+
     std::string getStatusText() const;
+    std::string detectMimeType(const std::string& path) const;
+    std::string selectPrecompressed(const std::string& fullPath, std::string& encoding) const;
 
     bool shouldCompress(const std::string& contentTypes) const;
-    std::string compressGzip(const std::string& content) const;
+    std::string compressBody(Compression::Encoding encoding, const std::string& content, int level) const;
+    bool setFileValidators(const Utils::FileInfo& info, const std::string& encoding);
+    bool rangeValidatorMatches() const;
+    bool sendFileRanges(const std::string& path, uint64_t size, const std::string& contentType);
     void prepareResponse();
+    void dropPrepared();
+    std::string headerBlock(bool chunked) const;
+    std::string connectionFields() const;
 };
 
 #endif // HTTP_RESPONSE_H
\ No newline at end of file
@@ -3,18 +3,32 @@
 
 #include <string>
 #include <map>
+#include <array>
+#include <memory>
 #include <functional>
 #include <atomic>
 #include <stdexcept>
 #include <type_traits>
-#include <regex>
+#include <vector>
+#include <cstdint>
+#include <string_view>
 
 #include "Defs.h"
 #include "Config.h"
 
 #include "HttpStatus.h"
+#include "HttpMethod.h"
 #include "HttpRequest.h"
 #include "HttpResponse.h"
+#include "ResponseWriter.h"
+#include "Compression.h"
+#include "EventLoop.h"
+#include "BackgroundTasks.h"
+#include "EventStream.h"
+#include "WebSocket.h"
+#include "Router.h"
+#include "HttpContext.h"
+#include "Middleware.h"
 
 #include "json.hpp"
 using json = nlohmann::json;
@@ -62,37 +76,8 @@ CreateResponseHelper(MethodNotAllowed, HttpStatus::METHOD_NOT_ALLOWED)
 CreateResponseHelper(InternalServerError, HttpStatus::INTERNAL_SERVER_ERROR)
 CreateResponseHelper(NotImplemented, HttpStatus::NOT_IMPLEMENTED)
 
-class PathVars {
-public:
-    const std::string& get(const std::string& name) const {
-        auto it = vars_.find(name);
-        if (it == vars_.end()) {
-            throw std::out_of_range("Path variable not found: " + name);
-        }
-        return it->second;
-    }
-    
-    int getInt(const std::string& name) const {
-        return std::stoi(get(name));
-    }
-    
-    std::string getString(const std::string& name) const {
-        return get(name);
-    }
-    
-private:
-    friend class HttpServer;
-    std::map<std::string, std::string> vars_;
-};
-
-class HttpContext {
-public:
-    HttpContext(socket_t connfd) : req(connfd), res(connfd, req) {}
-
-    HttpRequest req;
-    HttpResponse res;
-    PathVars path_vars;
-};
+template <typename... Fs>
+class RouteTable;
 
 class HttpServer {
 public:
@@ -107,38 +92,69 @@ public:
     explicit HttpServer(const std::string& host = "0.0.0.0", int port = 8000);
     ~HttpServer();
 
-    template<typename F>
-    void route(const std::string& path, F&& handler) {
-        addRouteFromHandler("GET", path, std::forward<F>(handler));
-        addRouteFromHandler("POST", path, std::forward<F>(handler));
-        addRouteFromHandler("PUT", path, std::forward<F>(handler));
-        addRouteFromHandler("PATCH", path, std::forward<F>(handler));
-        addRouteFromHandler("DELETE", path, std::forward<F>(handler));
+    // Routes must be registered before run(), which freezes the table so
+    // that connection threads read it without locking. route() covers GET,
+    // POST, PUT, PATCH and DELETE with one handler. Each takes a handler, or
+    // a Middleware::Chain run in front of it followed by the handler.
+    template<typename... Args>
+    void route(const std::string& path, Args&&... args) {
+        addRouteFromHandler(httpMethodBit(HttpMethod::GET) | httpMethodBit(HttpMethod::POST) |
+                            httpMethodBit(HttpMethod::PUT) | httpMethodBit(HttpMethod::PATCH) |
+                            httpMethodBit(HttpMethod::DELETE_),
+                            path, std::forward<Args>(args)...);
     }
 
-    template<typename F>
-    void get(const std::string& path, F&& handler) {
-        addRouteFromHandler("GET", path, std::forward<F>(handler));
+    template<typename... Args>
+    void get(const std::string& path, Args&&... args) {
+        addRouteFromHandler(httpMethodBit(HttpMethod::GET), path, std::forward<Args>(args)...);
     }
 
-    template<typename F>
-    void post(const std::string& path, F&& handler) {
-        addRouteFromHandler("POST", path, std::forward<F>(handler));
+    template<typename... Args>
+    void post(const std::string& path, Args&&... args) {
+        addRouteFromHandler(httpMethodBit(HttpMethod::POST), path, std::forward<Args>(args)...);
     }
 
-    template<typename F>
-    void put(const std::string& path, F&& handler) {
-        addRouteFromHandler("PUT", path, std::forward<F>(handler));
+    template<typename... Args>
+    void put(const std::string& path, Args&&... args) {
+        addRouteFromHandler(httpMethodBit(HttpMethod::PUT), path, std::forward<Args>(args)...);
     }
 
-    template<typename F>
-    void patch(const std::string& path, F&& handler) {
-        addRouteFromHandler("PATCH", path, std::forward<F>(handler));
+    template<typename... Args>
+    void patch(const std::string& path, Args&&... args) {
+        addRouteFromHandler(httpMethodBit(HttpMethod::PATCH), path, std::forward<Args>(args)...);
     }
 
-    template<typename F>
-    void delete_(const std::string& path, F&& handler) {
-        addRouteFromHandler("DELETE", path, std::forward<F>(handler));
+    template<typename... Args>
+    void delete_(const std::string& path, Args&&... args) {
+        addRouteFromHandler(httpMethodBit(HttpMethod::DELETE_), path, std::forward<Args>(args)...);
+    }
+
+    // Registers a GET route serving text/event-stream. onConnect may reject
+    // a subscriber by returning false after setting an error response.
+    EventChannel& sse(const std::string& path, std::function<bool(HttpContext&)> onConnect = nullptr);
+
+    // Registers a GET route that upgrades to a WebSocket served by the
+    // event loop
+    WebSocketChannel& websocket(const std::string& path, WebSocketHandlers handlers,
+                                WebSocketCompression compression = WebSocketCompression());
+
+    // Runs middleware (Middleware.h) in front of every request, static
+    // files and routes alike, in the order given. The middleware passed to
+    // one call is composed with the built-ins into a single object, so a
+    // request costs one indirect call; each further call adds one.
+    template<typename... Ms>
+    void use(Ms&&... middleware) {
+        static_assert(sizeof...(Ms) > 0, "use() needs at least one middleware");
+        using Composed = decltype(Middleware::chain(std::forward<Ms>(middleware)...));
+        addMiddleware(std::make_unique<LayerOf<Composed>>(Middleware::chain(std::forward<Ms>(middleware)...)));
+    }
+
+    // Serves a RouteTable built at compile time (RouteTable.h) ahead of the
+    // routes registered at runtime. The table must outlive the server.
+    template<typename Table>
+    void mount(const Table& table) {
+        static_table_ = &table;
+        static_dispatch_ = &Table::dispatch;
     }
 
     void setHost(const std::string& host);
@@ -146,24 +162,15 @@ public:
     void run();
     void stop();
 
+    void setCompressionPolicy(const Compression::Policy& policy);
+    void setCompressionCache(size_t maxBytes);
+    size_t precompressStatic(unsigned int threads = 0);
+
     bool isRunning() const;
     std::string getHost() const;
     int getPort() const;
 
 private:
-    struct RoutePattern {
-        std::string pattern;
-        std::vector<std::pair<std::string, std::string>> vars;
-        std::regex regex;
-        
-        RoutePattern(const std::string& pattern);
-        bool match(const std::string& path, std::map<std::string, std::string>& vars) const;
-        
-        bool operator<(const RoutePattern& other) const {
-            return pattern < other.pattern;
-        }
-    };
-
     std::string host_;
     int port_;
     socket_t sockfd_;
@@ -173,40 +180,130 @@ private:
     WSADATA wsaData;
 #endif
 
-    using AnyRouteHandler = std::function<void(HttpContext&)>;
-    std::map<std::string, std::map<std::string, AnyRouteHandler>> routes_;
-    std::map<std::string, std::map<RoutePattern, AnyRouteHandler>> pattern_routes_;
+    // Declared before loop_ so the loop is torn down first
+    std::map<std::string, std::unique_ptr<EventChannel>> channels_;
+    std::map<std::string, std::unique_ptr<WebSocketChannel>> websockets_;
+    EventLoop loop_;
+
+    // A route handler stored once, in its own type, and invoked through a
+    // single virtual call
+    struct StoredHandler {
+        virtual ~StoredHandler() = default;
+        virtual void operator()(HttpContext& ctx) const = 0;
+    };
 
     template<typename F>
-    void addRouteFromHandler(const std::string& method, const std::string& path, F&& handler) {
-        if (path.find('{') != std::string::npos) {
-            RoutePattern pattern(path);
-            using ResponseType = std::invoke_result_t<F, HttpContext&>;
-            using DataType = typename ResponseType::DataType;
-            
-            pattern_routes_[method][pattern] = [this, handler](HttpContext& ctx) {
-                Response<DataType> response = handler(ctx);
-                handleResponse(ctx, response);
-            };
-        } else {
-            using ResponseType = std::invoke_result_t<F, HttpContext&>;
-            using DataType = typename ResponseType::DataType;
-            addRoute<DataType>(method, path, std::forward<F>(handler));
+    struct HandlerOf final : StoredHandler {
+        F fn;
+        explicit HandlerOf(F fn) : fn(std::move(fn)) {}
+        void operator()(HttpContext& ctx) const override { callHandler(fn, ctx); }
+    };
+
+    // A handler behind its own middleware chain, still a single virtual
+    // call from the router
+    template<typename Chain, typename F>
+    struct ChainedHandler final : StoredHandler {
+        Chain chain;
+        F fn;
+        ChainedHandler(Chain chain, F fn) : chain(std::move(chain)), fn(std::move(fn)) {}
+        void operator()(HttpContext& ctx) const override {
+            chain.run(ctx, [this](HttpContext& c) { callHandler(fn, c); });
+        }
+    };
+
+    // Middleware added by one use() call, linked to the layer of the next
+    // call when there is one. The last layer runs the built-ins and the
+    // routes directly.
+    struct MiddlewareLayer {
+        virtual ~MiddlewareLayer() = default;
+        virtual void run(HttpContext& ctx) const = 0;
+        const HttpServer* server = nullptr;
+        std::unique_ptr<MiddlewareLayer> next;
+    };
+
+    // The rest of the pipeline after a layer
+    struct AfterLayer {
+        const MiddlewareLayer* layer;
+        void operator()(HttpContext& ctx) const {
+            if (layer->next) {
+                layer->next->run(ctx);
+            } else {
+                layer->server->runBuiltins(ctx);
+            }
         }
+    };
+
+    template<typename Chain>
+    struct LayerOf final : MiddlewareLayer {
+        Chain chain;
+        explicit LayerOf(Chain chain) : chain(std::move(chain)) {}
+        void run(HttpContext& ctx) const override { chain.run(ctx, AfterLayer{this}); }
+    };
+
+    std::unique_ptr<MiddlewareLayer> pipeline_;
+    MiddlewareLayer* lastLayer_ = nullptr;
+
+    // Built in, run after the use() middleware and ahead of the routes
+    Middleware::Chain<Middleware::Compress, Middleware::StaticFiles, Middleware::HealthCheck> builtins_;
+
+    // Indexed by HttpMethod; values index handlers_
+    std::array<Router, HTTP_METHOD_COUNT> routes_;
+    std::vector<std::unique_ptr<StoredHandler>> handlers_;
+
+    // Jobs running the routes' middleware; declared after the routes so
+    // that it is stopped before they are destroyed
+    BackgroundTasks background_;
+
+    // Methods registered per pattern, keyed by the pattern without variable
+    // names. freezeRoutes() turns it into allowed_, whose values are the
+    // httpMethodBit flags for the 405 Allow header.
+    std::map<std::string, std::pair<std::string, uint32_t>> pattern_methods_;
+    Router allowed_;
+    bool frozen_ = false;
+
+    // Mounted RouteTable, type-erased to its dispatch function
+    const void* static_table_ = nullptr;
+    bool (*static_dispatch_)(const void* table, HttpContext& ctx, uint32_t& allowed) = nullptr;
+
+    // methods is a set of httpMethodBit flags
+    template<typename F>
+    void addRouteFromHandler(uint32_t methods, const std::string& path, F&& handler) {
+        addHandler(methods, path, std::make_unique<HandlerOf<std::decay_t<F>>>(std::forward<F>(handler)));
     }
 
-    template<typename T>
-    void addRoute(const std::string& method, const std::string& path, RouteHandler<T> handler) {
-        routes_[method][path] = [this, handler](HttpContext& ctx) {
-            Response<T> response = handler(ctx);
-            handleResponse(ctx, response);
-        };
+    template<typename... Ms, typename F>
+    void addRouteFromHandler(uint32_t methods, const std::string& path, Middleware::Chain<Ms...> middleware, F&& handler) {
+        addHandler(methods, path, std::make_unique<ChainedHandler<Middleware::Chain<Ms...>, std::decay_t<F>>>(
+                                      std::move(middleware), std::forward<F>(handler)));
     }
 
-    bool matchRoute(const std::string& method, const std::string& path, HttpContext& ctx, AnyRouteHandler& matched_handler);
+    void addHandler(uint32_t methods, const std::string& path, std::unique_ptr<StoredHandler> handler);
+    void freezeRoutes();
+
+    // Handler for the route matching ctx.req, owned by handlers_
+    const StoredHandler* matchRoute(HttpContext& ctx) const;
+    uint32_t allowedMethods(const std::string& path) const;
+
+    template <typename... Fs>
+    friend class RouteTable;
+
+    // Runs a route handler of any form: returning a Response, streaming
+    // through a ResponseWriter, or writing ctx.res itself
+    template<typename F>
+    static void callHandler(const F& handler, HttpContext& ctx) {
+        if constexpr (std::is_invocable_v<const F&, HttpContext&, ResponseWriter&>) {
+            ResponseWriter writer(ctx.res);
+            handler(ctx, writer);
+            writer.end();
+        } else if constexpr (std::is_void_v<std::invoke_result_t<const F&, HttpContext&>>) {
+            handler(ctx);
+        } else {
+            handleResponse(ctx, handler(ctx));
+        }
+    }
 
     template<typename T>
-    void handleResponse(HttpContext& ctx, const Response<T>& response) {
+    static void handleResponse(HttpContext& ctx, const Response<T>& response) {
         ctx.res.setStatus(response.status);
 
         if constexpr (std::is_same_v<T, json>) {
@@ -228,8 +325,17 @@ private:
     static void closeSocket(socket_t sock);
     static std::string getLastError();
     
-    void handleConnection(socket_t connfd);
-    void handleKeepAliveConnection(socket_t connfd);
+    void addMiddleware(std::unique_ptr<MiddlewareLayer> layer);
+
+    void dispatchRequest(HttpContext& ctx);
+    void runBuiltins(HttpContext& ctx) const {
+        builtins_.run(ctx, [this](HttpContext& c) { routeRequest(c); });
+    }
+    void routeRequest(HttpContext& ctx) const;
+    // Takes over the connection when ctx.req starts HTTP/2; true if it did
+    bool serveHttp2(HttpContext& ctx);
+    void handleConnection(socket_t connfd, const PeerAddress& peer);
+    void handleKeepAliveConnection(socket_t connfd, const PeerAddress& peer);
     void sendResponse(HttpResponse& response);
     void setupServer();
     void cleanup();
@@ -2,6 +2,9 @@
 #define HTTP_STATUS_H
 
 enum class HttpStatus {
+    // 1xx Informational
+    SWITCHING_PROTOCOLS = 101,
+
     // 2xx Success
     OK = 200,
     CREATED = 201,
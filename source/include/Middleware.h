@@ -0,0 +1,171 @@
+#ifndef MIDDLEWARE_H
+#define MIDDLEWARE_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <type_traits>
+
+#include "HttpContext.h"
+
+// A middleware is any callable m(HttpContext& ctx, Next next). It runs the
+// rest of the chain by calling next(); returning without calling it ends
+// the request with whatever it put in ctx.res, and code after next() sees
+// the response the route produced before it is sent (unless the handler
+// streamed it, see HttpResponse::isStreamed).
+//
+//   auto requireToken = [](HttpContext& ctx, auto&& next) {
+//       if (!ctx.req.headers.has("Authorization")) {
+//           ctx.res.setStatus(HttpStatus::UNAUTHORIZED);
+//           return;
+//       }
+//       next();
+//   };
+//   server.use(requireToken, addServerHeader);              // every request
+//   server.get("/admin", Middleware::chain(requireToken), handler);
+//
+// Middleware is composed when it is registered: a chain is one object whose
+// type lists its middleware, and next is a Continuation calling the
+// following one, so the compiler can inline the whole chain into the route.
+// Taking next as auto&& keeps that; a Middleware::Next parameter also
+// works, at the cost of an indirect call. next(other) runs the rest of the
+// chain on another context instead, before the middleware returns;
+// next.detach() returns it as an object that may be called later, on any
+// thread, for as long as the server's routes exist (HttpServer stops its
+// BackgroundTasks before they go).
+namespace Middleware {
+    template <typename Rest>
+    class Continuation {
+    public:
+        Continuation(const Rest& rest, HttpContext& ctx) : rest_(rest), ctx_(ctx) {}
+
+        void operator()() const { rest_(ctx_); }
+        void operator()(HttpContext& other) const { rest_(other); }
+        Rest detach() const { return rest_; }
+
+    private:
+        const Rest& rest_;
+        HttpContext& ctx_;
+    };
+
+    // Type-erased Continuation, valid for the call it was passed to
+    class Next {
+    public:
+        template <typename Rest>
+        Next(const Continuation<Rest>& next)
+            : next_(&next), call_([](const void* next, HttpContext* other) {
+                  const auto& continuation = *static_cast<const Continuation<Rest>*>(next);
+                  if (other) {
+                      continuation(*other);
+                  } else {
+                      continuation();
+                  }
+              }) {}
+
+        void operator()() const { call_(next_, nullptr); }
+        void operator()(HttpContext& other) const { call_(next_, &other); }
+
+    private:
+        const void* next_;
+        void (*call_)(const void*, HttpContext*);
+    };
+
+    template <typename... Ms>
+    class Chain;
+
+    template <>
+    class Chain<> {
+    public:
+        // Calls last(ctx) once every middleware has called next
+        template <typename Last>
+        void run(HttpContext& ctx, const Last& last) const {
+            last(ctx);
+        }
+    };
+
+    template <typename M, typename... Rest>
+    class Chain<M, Rest...> {
+    public:
+        explicit Chain(M first, Rest... rest) : first_(std::move(first)), rest_(std::move(rest)...) {}
+
+        template <typename Last>
+        void run(HttpContext& ctx, const Last& last) const {
+            // last is copied so that the continuation can be detached
+            auto rest = [this, last](HttpContext& c) { rest_.run(c, last); };
+            first_(ctx, Continuation<decltype(rest)>(rest, ctx));
+        }
+
+    private:
+        M first_;
+        Chain<Rest...> rest_;
+    };
+
+    // True for a next that can be detached (Continuation, not Next)
+    template <typename F, typename = void>
+    struct IsDetachable : std::false_type {};
+
+    template <typename F>
+    struct IsDetachable<F, std::void_t<decltype(std::declval<const F&>().detach())>> : std::true_type {};
+
+    template <typename... Ms>
+    Chain<std::decay_t<Ms>...> chain(Ms&&... middleware) {
+        return Chain<std::decay_t<Ms>...>(std::forward<Ms>(middleware)...);
+    }
+
+    // Method and path plus the named query parameters and headers, for
+    // middleware keeping per-request state (ResponseCache, SingleFlight).
+    // Parts are NUL-separated; an absent parameter differs from an empty one.
+    std::string requestKey(const HttpContext& ctx, const std::vector<std::string>& queryParams,
+                           const std::vector<std::string>& headers);
+
+    // GET requests under prefix are answered with the file of the same
+    // name in directory
+    class StaticFiles {
+    public:
+        StaticFiles(std::string prefix, std::string directory)
+            : prefix_(std::move(prefix)), directory_(std::move(directory)) {}
+
+        template <typename F>
+        void operator()(HttpContext& ctx, F&& next) const {
+            if (!serve(ctx)) next();
+        }
+
+        // False if the request is not for a static file
+        bool serve(HttpContext& ctx) const;
+
+    private:
+        std::string prefix_;
+        std::string directory_;
+    };
+
+    // Compresses the response for the client's Accept-Encoding once the
+    // rest of the chain has produced it (HttpResponse::compress). The
+    // server runs it after the use() middleware, which therefore sees
+    // responses as they are sent.
+    class Compress {
+    public:
+        template <typename F>
+        void operator()(HttpContext& ctx, F&& next) const {
+            next();
+            ctx.res.compress();
+        }
+    };
+
+    // Answers GET path with 200 OK; an empty path disables it
+    class HealthCheck {
+    public:
+        explicit HealthCheck(std::string path) : path_(std::move(path)) {}
+
+        template <typename F>
+        void operator()(HttpContext& ctx, F&& next) const {
+            if (!serve(ctx)) next();
+        }
+
+        bool serve(HttpContext& ctx) const;
+
+    private:
+        std::string path_;
+    };
+}
+
+#endif // MIDDLEWARE_H
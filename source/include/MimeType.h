@@ -2,16 +2,19 @@
 #define MIME_TYPES_H
 
 #include <string>
+#include <string_view>
 #include <array>
+#include <cstdint>
+#include <cstddef>
 
 struct MimeType {
-    std::string mimeType;
-    std::string extension;
+    const char* mimeType;
+    const char* extension;
     std::array<unsigned char, 8> magic;
     size_t magicSize;
 };
 
-const MimeType MIME_TYPES[] = {
+inline constexpr MimeType MIME_TYPES[] = {
     // Images
     {
         "image/png",
@@ -25,6 +28,12 @@ const MimeType MIME_TYPES[] = {
         {0xFF, 0xD8, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00},
         3
     },
+    {
+        "image/jpeg",
+        ".jpeg",
+        {0xFF, 0xD8, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00},
+        3
+    },
     {
         "image/gif",
         ".gif",
@@ -55,6 +64,12 @@ const MimeType MIME_TYPES[] = {
         {0x49, 0x49, 0x2A, 0x00, 0x00, 0x00, 0x00, 0x00},
         4
     },
+    {
+        "image/svg+xml",
+        ".svg",
+        {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+        0
+    },
     {
         "image/x-icon",
         ".ico",
@@ -147,6 +162,12 @@ const MimeType MIME_TYPES[] = {
         {0x3C, 0x21, 0x44, 0x4F, 0x43, 0x54, 0x59, 0x50},
         8
     },
+    {
+        "text/html",
+        ".htm",
+        {0x3C, 0x21, 0x44, 0x4F, 0x43, 0x54, 0x59, 0x50},
+        8
+    },
     {
         "text/css",
         ".css",
@@ -159,6 +180,12 @@ const MimeType MIME_TYPES[] = {
         {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
         0
     },
+    {
+        "application/javascript",
+        ".mjs",
+        {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+        0
+    },
     {
         "application/json",
         ".json",
@@ -189,6 +216,12 @@ const MimeType MIME_TYPES[] = {
         {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
         0
     },
+    {
+        "text/plain",
+        ".txt",
+        {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+        0
+    },
 
     // Fonts
     {
@@ -217,6 +250,78 @@ const MimeType MIME_TYPES[] = {
     }
 };
 
+// Perfect hash from extension to MIME_TYPES index, built at compile time.
+// The first entry wins when an extension is listed more than once.
+namespace MimeTable {
+    constexpr size_t TYPE_COUNT = sizeof(MIME_TYPES) / sizeof(MIME_TYPES[0]);
+    constexpr size_t SLOT_COUNT = 128;
+    constexpr uint8_t EMPTY_SLOT = 0xFF;
+    constexpr uint32_t NO_SEED = 0xFFFFFFFF;
+
+    static_assert(TYPE_COUNT < EMPTY_SLOT, "MIME_TYPES does not fit in the slot index type");
+
+    constexpr uint32_t hash(std::string_view key, uint32_t seed) {
+        uint32_t h = 2166136261u ^ seed;
+        for (char c : key) {
+            h ^= static_cast<unsigned char>(c);
+            h *= 16777619u;
+        }
+        h ^= h >> 15;
+        return h;
+    }
+
+    struct Table {
+        uint32_t seed;
+        std::array<uint8_t, SLOT_COUNT> slots;
+    };
+
+    constexpr bool firstWithExtension(size_t index) {
+        for (size_t i = 0; i < index; i++) {
+            if (std::string_view(MIME_TYPES[i].extension) == MIME_TYPES[index].extension) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    constexpr Table build() {
+        for (uint32_t seed = 0; seed < 4096; seed++) {
+            Table table{seed, {}};
+            for (auto& slot : table.slots) slot = EMPTY_SLOT;
+
+            bool collision = false;
+            for (size_t i = 0; i < TYPE_COUNT && !collision; i++) {
+                if (!firstWithExtension(i)) continue;
+
+                size_t slot = hash(MIME_TYPES[i].extension, seed) % SLOT_COUNT;
+                if (table.slots[slot] != EMPTY_SLOT) {
+                    collision = true;
+                } else {
+                    table.slots[slot] = static_cast<uint8_t>(i);
+                }
+            }
+
+            if (!collision) return table;
+        }
+        return Table{NO_SEED, {}};
+    }
+
+    inline constexpr Table TABLE = build();
+    static_assert(TABLE.seed != NO_SEED, "No perfect hash seed found for MIME_TYPES extensions");
+}
+
+// Returns nullptr for unknown extensions. ext includes the leading dot and
+// must already be lower case.
+constexpr const char* mimeTypeForExtension(std::string_view ext) {
+    uint8_t index = MimeTable::TABLE.slots[MimeTable::hash(ext, MimeTable::TABLE.seed) % MimeTable::SLOT_COUNT];
+    if (index == MimeTable::EMPTY_SLOT || ext != MIME_TYPES[index].extension) {
+        return nullptr;
+    }
+    return MIME_TYPES[index].mimeType;
+}
+
+const char* mimeTypeForPath(const std::string& path);
+const char* sniffMimeType(const unsigned char* data, size_t length);
 bool checkMimeType(const unsigned char* data, size_t length, const MimeType& signature);
 
 #endif // MIME_TYPES_H
\ No newline at end of file
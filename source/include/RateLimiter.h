@@ -0,0 +1,62 @@
+#ifndef RATE_LIMITER_H
+#define RATE_LIMITER_H
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <cstddef>
+
+#include "Config.h"
+#include "HttpContext.h"
+
+namespace Middleware {
+    // Token bucket per client IP (HttpContext::peer): a client may send
+    // burst requests at once and rate per second after that; beyond it the
+    // request gets 429 Too Many Requests with Retry-After. Copies share
+    // their buckets, so one limiter can guard the whole server or a route:
+    //
+    //   server.use(Middleware::RateLimiter(50, 100));
+    //   server.post("/search", Middleware::chain(Middleware::RateLimiter(1, 5)), search);
+    //
+    // A bucket is a single atomic timestamp, the moment it is full again
+    // (GCRA), so refilling is lazy and taking a token is one compare-and-
+    // swap. Buckets live in a hash table split into shards; a known client
+    // only takes its shard's lock shared. A shard used more than ttl after
+    // its last sweep drops the buckets that have been full for ttl, a few
+    // hash buckets per request until the pass is done.
+    class RateLimiter {
+    public:
+        struct Options {
+            double rate = 0;  // tokens per second
+            double burst = 0; // bucket size
+            std::chrono::seconds ttl{Config::RATE_LIMIT_TTL};
+            size_t shards = Config::RATE_LIMIT_SHARDS; // rounded up to a power of two
+        };
+
+        // Throws std::invalid_argument unless rate > 0 and burst >= 1
+        RateLimiter(double rate, double burst);
+        explicit RateLimiter(const Options& options);
+
+        template <typename F>
+        void operator()(HttpContext& ctx, F&& next) const {
+            if (admit(ctx)) next();
+        }
+
+        // Takes a token for ctx's client, or sets the 429 response and
+        // returns false
+        bool admit(HttpContext& ctx) const;
+
+        // Takes a token for key and returns zero, or returns how long until
+        // one is available
+        std::chrono::nanoseconds acquire(const std::string& key) const;
+
+        // Buckets currently tracked
+        size_t size() const;
+
+    private:
+        struct State;
+        std::shared_ptr<State> state_;
+    };
+}
+
+#endif // RATE_LIMITER_H
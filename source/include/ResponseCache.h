@@ -0,0 +1,143 @@
+#ifndef RESPONSE_CACHE_H
+#define RESPONSE_CACHE_H
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <iostream>
+#include <type_traits>
+
+#include "Config.h"
+#include "HttpContext.h"
+#include "BackgroundTasks.h"
+
+namespace Middleware {
+    // Keeps the responses of GET requests, serialized and compressed as
+    // sent, and answers repeats without running the rest of the chain:
+    //
+    //   Middleware::ResponseCache::Options reports;
+    //   reports.ttl = std::chrono::seconds(5);
+    //   reports.staleWhileRevalidate = std::chrono::seconds(30);
+    //   reports.queryParams = {"from", "to"};
+    //   server.get("/report", Middleware::chain(requireToken, Middleware::ResponseCache(reports)), report);
+    //
+    // The key is the method, the path and the listed query parameters and
+    // request headers; anything else in the request does not tell entries
+    // apart. Each entry holds a variant per negotiated content coding.
+    // Only 200 responses without Set-Cookie or Cache-Control no-store or
+    // private are kept.
+    //
+    // For staleWhileRevalidate after ttl an entry is still served, and the
+    // first request to find it stale refreshes it: it is answered from the
+    // cache at once, and the rest of the chain runs on a copy of it on the
+    // server's BackgroundTasks while requests, this connection's included,
+    // keep getting the stale response. Behind a Middleware::Next, which
+    // cannot be detached, the copy runs on the connection after the answer.
+    //
+    // Entries live in lock-striped LRU lists, maxBytes shared evenly among
+    // the stripes. Copies of a ResponseCache share their entries.
+    class ResponseCache {
+    public:
+        struct Options {
+            std::chrono::milliseconds ttl{1000};
+            std::chrono::milliseconds staleWhileRevalidate{0};
+            std::vector<std::string> queryParams;
+            std::vector<std::string> headers;
+            size_t maxBytes = Config::RESPONSE_CACHE_SIZE;
+            size_t stripes = Config::RESPONSE_CACHE_STRIPES;
+        };
+
+        explicit ResponseCache(std::chrono::milliseconds ttl,
+                               std::chrono::milliseconds staleWhileRevalidate = std::chrono::milliseconds(0));
+        explicit ResponseCache(const Options& options);
+
+        template <typename F>
+        void operator()(HttpContext& ctx, F&& next) const {
+            std::string key;
+            switch (lookup(ctx, key)) {
+                case Result::Hit:
+                    return;
+                case Result::Refresh:
+                    if (!ctx.res.send()) {
+                        endRefresh(key);
+                        return;
+                    }
+                    if constexpr (IsDetachable<std::decay_t<F>>::value) {
+                        if (ctx.background) {
+                            refreshLater(*ctx.background, ctx, key, next.detach());
+                            return;
+                        }
+                    }
+                    {
+                        HttpContext copy(INVALID_SOCK);
+                        copyRequest(ctx, copy);
+                        runAndStore(copy, key, next, true);
+                    }
+                    return;
+                case Result::Miss:
+                    runAndStore(ctx, key, next, false);
+                    return;
+                case Result::Bypass:
+                    next();
+                    return;
+            }
+        }
+
+        // Entries and bytes held, across all stripes
+        size_t size() const;
+        size_t bytes() const;
+
+    private:
+        enum class Result { Hit, Refresh, Miss, Bypass };
+
+        struct State;
+        std::shared_ptr<State> state_;
+
+        // Answers ctx from the cache on Hit and Refresh; key is set unless
+        // the result is Bypass
+        Result lookup(HttpContext& ctx, std::string& key) const;
+        // Keeps ctx's response, if it may be kept, under key
+        void store(HttpContext& ctx, const std::string& key, bool refresh) const;
+        void endRefresh(const std::string& key) const;
+
+        static void copyRequest(const HttpContext& from, HttpContext& to) {
+            to.req = from.req;
+            to.peer = from.peer;
+            to.path_vars = from.path_vars;
+            to.path_vars.rebase(from.req.path, to.req.path);
+        }
+
+        // Queues the refresh; when the queue is full the entry stays
+        // stale and a later request tries again
+        template <typename Rest>
+        void refreshLater(BackgroundTasks& background, const HttpContext& ctx, const std::string& key, Rest rest) const {
+            auto copy = std::make_shared<HttpContext>(INVALID_SOCK);
+            copyRequest(ctx, *copy);
+            bool queued = background.post([cache = *this, copy, key, rest = std::move(rest)]() {
+                try {
+                    cache.runAndStore(*copy, key, rest, true);
+                } catch (const std::exception& e) {
+                    std::cerr << "Cache refresh of " << copy->req.path << " failed: " << e.what() << std::endl;
+                }
+            });
+            if (!queued) {
+                endRefresh(key);
+            }
+        }
+
+        template <typename F>
+        void runAndStore(HttpContext& ctx, const std::string& key, F&& next, bool refresh) const {
+            try {
+                next(ctx);
+            } catch (...) {
+                if (refresh) endRefresh(key);
+                throw;
+            }
+            store(ctx, key, refresh);
+        }
+    };
+}
+
+#endif // RESPONSE_CACHE_H
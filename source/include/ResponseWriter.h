@@ -0,0 +1,57 @@
+#ifndef RESPONSE_WRITER_H
+#define RESPONSE_WRITER_H
+
+#include <string>
+#include <memory>
+#include <cstddef>
+
+#include "Config.h"
+#include "Compression.h"
+#include "HttpResponse.h"
+
+// Incremental response body for handlers registered with the
+// (HttpContext&, ResponseWriter&) signature. Status and headers set on the
+// response before the first flush are sent with the first chunk; the body
+// goes out with Transfer-Encoding: chunked (DATA frames on HTTP/2). Sends
+// block while the socket buffer (or HTTP/2 flow-control window) is full, so
+// a slow client slows the handler down instead of growing memory. When the
+// Content-Type is compressible, chunks are compressed on the fly with the
+// negotiated coding (see Compression::negotiate) and a sync flush at every
+// explicit flush().
+class ResponseWriter {
+public:
+    explicit ResponseWriter(HttpResponse& res, size_t flushThreshold = Config::STREAM_FLUSH_SIZE);
+    ~ResponseWriter() = default;
+
+    ResponseWriter(const ResponseWriter&) = delete;
+    ResponseWriter& operator=(const ResponseWriter&) = delete;
+
+    ResponseWriter& write(const char* data, size_t length);
+    ResponseWriter& write(const std::string& data);
+    ResponseWriter& operator<<(const std::string& data) { return write(data); }
+
+    bool flush();
+    bool end();
+
+    // False once the client has gone away; further writes are dropped
+    bool good() const { return !failed; }
+    bool headersSent() const { return headSent; }
+    size_t bytesWritten() const { return written; }
+
+private:
+    HttpResponse& res;
+    std::string buffer;
+    size_t flushThreshold;
+    size_t written;
+    bool headSent;
+    bool ended;
+    bool failed;
+    bool chunked;
+    std::unique_ptr<Compression::EncoderStream> encoder;
+
+    bool sendHead(bool finishing);
+    bool sendRaw(const std::string& data);
+    bool emit(Compression::EncoderStream::Flush flush);
+};
+
+#endif // RESPONSE_WRITER_H
@@ -0,0 +1,167 @@
+#ifndef ROUTE_TABLE_H
+#define ROUTE_TABLE_H
+
+#include <array>
+#include <tuple>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+#include "HttpMethod.h"
+#include "HttpServer.h"
+
+// Routes fixed at compile time, for services that know their whole route
+// set up front:
+//
+//   constexpr RouteTable api{
+//       StaticRoute(HttpMethod::GET, "/health", [](HttpContext&) { return Ok("OK"); }),
+//       StaticRoute(HttpMethod::POST, "/items", &createItem),
+//   };
+//   server.mount(api);
+//
+// Handlers take the same forms as HttpServer::get and friends but must be
+// function pointers or captureless lambdas. The constructor builds a
+// perfect hash of the paths during compilation (a duplicate route or a
+// path with {variables} fails to compile), and dispatch is a hash, one
+// string compare, a lookup by method and a direct call of the handler,
+// without std::function or allocation. Mounted tables are consulted before
+// the routes registered at runtime.
+template <typename F>
+struct StaticRoute {
+    HttpMethod method;
+    std::string_view path;
+    F handler;
+
+    constexpr StaticRoute(HttpMethod method, std::string_view path, F handler)
+        : method(method), path(path), handler(handler) {}
+};
+
+template <typename... Fs>
+class RouteTable {
+public:
+    static constexpr size_t SIZE = sizeof...(Fs);
+    static constexpr size_t NONE = SIZE;
+
+    constexpr RouteTable(StaticRoute<Fs>... routes)
+        : routes_(routes...), paths_{}, byPath_{}, allowed_{}, slots_{}, seed_(0), distinct_(0) {
+        const std::string_view paths[] = {routes.path...};
+        const HttpMethod methods[] = {routes.method...};
+
+        for (auto& methodsOfPath : byPath_) {
+            for (size_t& route : methodsOfPath) route = NONE;
+        }
+
+        for (size_t i = 0; i < SIZE; i++) {
+            if (paths[i].empty() || paths[i][0] != '/' || paths[i].find('{') != std::string_view::npos ||
+                methods[i] == HttpMethod::UNKNOWN) {
+                throw std::logic_error("RouteTable: static paths only");
+            }
+
+            size_t path = 0;
+            while (path < distinct_ && paths_[path] != paths[i]) path++;
+            if (path == distinct_) paths_[distinct_++] = paths[i];
+
+            size_t& route = byPath_[path][static_cast<size_t>(methods[i])];
+            if (route != NONE) {
+                throw std::logic_error("RouteTable: duplicate route");
+            }
+            route = i;
+            allowed_[path] |= httpMethodBit(methods[i]);
+        }
+
+        findSeed();
+    }
+
+    // Index of the route for path and method, or NONE
+    constexpr size_t find(std::string_view path, HttpMethod method) const {
+        size_t index = findPath(path);
+        if (index == NONE || method == HttpMethod::UNKNOWN) {
+            return NONE;
+        }
+        return byPath_[index][static_cast<size_t>(method)];
+    }
+
+    // Methods with a route for path, as httpMethodBit flags
+    constexpr uint32_t allowedMethods(std::string_view path) const {
+        size_t index = findPath(path);
+        return index == NONE ? 0 : allowed_[index];
+    }
+
+    // Runs the matching handler. False when the table has no such route, in
+    // which case the methods it has for the path are added to allowed.
+    static bool dispatch(const void* table, HttpContext& ctx, uint32_t& allowed) {
+        const RouteTable& self = *static_cast<const RouteTable*>(table);
+        size_t path = self.findPath(ctx.req.path);
+        if (path == NONE) {
+            return false;
+        }
+
+        HttpMethod method = ctx.req.methodType;
+        size_t route = method == HttpMethod::UNKNOWN ? NONE : self.byPath_[path][static_cast<size_t>(method)];
+        if (route == NONE) {
+            allowed |= self.allowed_[path];
+            return false;
+        }
+        self.invoke(route, ctx, std::index_sequence_for<Fs...>());
+        return true;
+    }
+
+private:
+    static constexpr size_t nextPowerOfTwo(size_t n) {
+        size_t power = 1;
+        while (power < n) power <<= 1;
+        return power;
+    }
+
+    // Load factor of at most 1/4 keeps the seed search short
+    static constexpr size_t SLOTS = nextPowerOfTwo(SIZE) * 4;
+
+    constexpr size_t findPath(std::string_view path) const {
+        size_t index = slots_[hash(path, seed_) & (SLOTS - 1)];
+        return index != NONE && paths_[index] == path ? index : NONE;
+    }
+
+    static constexpr uint64_t hash(std::string_view text, uint64_t seed) {
+        uint64_t h = 14695981039346656037ull ^ seed;
+        for (char c : text) {
+            h ^= static_cast<unsigned char>(c);
+            h *= 1099511628211ull;
+        }
+        return h ^ (h >> 29);
+    }
+
+    constexpr void findSeed() {
+        for (uint64_t seed = 0; seed < 100000; seed++) {
+            for (size_t& slot : slots_) slot = NONE;
+
+            bool collision = false;
+            for (size_t path = 0; path < distinct_ && !collision; path++) {
+                size_t& slot = slots_[hash(paths_[path], seed) & (SLOTS - 1)];
+                collision = slot != NONE;
+                slot = path;
+            }
+            if (!collision) {
+                seed_ = seed;
+                return;
+            }
+        }
+        throw std::logic_error("RouteTable: no perfect hash found");
+    }
+
+    template <size_t... I>
+    void invoke(size_t route, HttpContext& ctx, std::index_sequence<I...>) const {
+        ((route == I ? (HttpServer::callHandler(std::get<I>(routes_).handler, ctx), true) : false) || ...);
+    }
+
+    std::tuple<StaticRoute<Fs>...> routes_;
+    std::array<std::string_view, SIZE> paths_;                           // distinct paths
+    std::array<std::array<size_t, HTTP_METHOD_COUNT>, SIZE> byPath_;     // route per path and method
+    std::array<uint32_t, SIZE> allowed_;                                 // methods per path
+    std::array<size_t, SLOTS> slots_;                                    // hash slot -> path
+    uint64_t seed_;
+    size_t distinct_;
+};
+
+#endif // ROUTE_TABLE_H
@@ -0,0 +1,86 @@
+#ifndef ROUTER_H
+#define ROUTER_H
+
+#include <array>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <functional>
+#include <string_view>
+
+#include "Config.h"
+
+// Compressed radix tree mapping path patterns to route values.
+//
+//   /users                static text
+//   /users/{name}         one segment (up to the next '/'), non-empty
+//   /users/{id:int}       one segment holding an int; also int64, uint
+//                         (uint64), uuid and types added with defineType
+//   /files/{path*}, /*    the rest of the path, possibly empty ("*" when unnamed)
+//
+// Matching walks the path once without regexes or allocation, and typed
+// variables are validated and converted while matching, so a value out of
+// range for its type simply does not match. When several patterns match,
+// static text wins over typed variables (int, int64, uint, uuid, then
+// custom types by name), typed over {x} and {x} over wildcards, compared
+// left to right, regardless of registration order.
+class Router {
+public:
+    class Error : public std::runtime_error {
+    public:
+        explicit Error(const std::string& msg) : std::runtime_error(msg) {}
+    };
+
+    // In match priority order
+    enum class VarType { Int, Int64, Uint, Uuid, Custom, String, Wildcard };
+
+    // A captured variable; value points into the matched path
+    struct Param {
+        std::string_view value;
+        VarType type = VarType::String;
+        int64_t integer = 0;   // Int, Int64
+        uint64_t uinteger = 0; // Uint
+    };
+
+    struct Params {
+        std::array<Param, Config::MAX_PATH_VARS> values;
+        size_t count = 0;
+    };
+
+    struct Route {
+        std::string pattern;
+        std::vector<std::string> names; // path variables in pattern order
+        size_t value;
+    };
+
+    using Validator = std::function<bool(std::string_view)>;
+
+    // Makes {x:name} available to patterns added afterwards. Not thread-safe;
+    // define types before registering routes.
+    static void defineType(const std::string& name, Validator validate);
+
+    Router();
+    ~Router();
+    Router(Router&&) noexcept;
+    Router& operator=(Router&&) noexcept;
+
+    // Throws Router::Error for malformed patterns; registering a pattern
+    // again replaces its value
+    void add(const std::string& pattern, size_t value);
+
+    // Best route for path, or nullptr; params holds its variables
+    const Route* match(std::string_view path, Params& params) const;
+
+    size_t size() const { return routes.size(); }
+
+private:
+    struct Node;
+
+    std::unique_ptr<Node> root;
+    std::vector<std::unique_ptr<Route>> routes;
+};
+
+#endif // ROUTER_H
@@ -3,8 +3,19 @@
 
 #include <map>
 #include <string>
+#include <cctype>
+#include <algorithm>
+#include <functional>
 
-template<typename T>
+// Orders keys ignoring ASCII case, for HTTP header names
+struct CaseInsensitiveLess {
+    bool operator()(const std::string& a, const std::string& b) const {
+        return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(),
+            [](unsigned char x, unsigned char y) { return std::tolower(x) < std::tolower(y); });
+    }
+};
+
+template<typename T, typename Compare = std::less<std::string>>
 class SafeMap {
 public:
     const T& get(const std::string& key, const T& defaultValue = T()) const {
@@ -42,12 +53,12 @@ public:
     size_t size() const { return data.size(); }
     bool empty() const { return data.empty(); }
 
-    const std::map<std::string, T>& getMap() const {
+    const std::map<std::string, T, Compare>& getMap() const {
         return data;
     }
 
 private:
-    std::map<std::string, T> data;
+    std::map<std::string, T, Compare> data;
 };
 
 #endif // SAFE_MAP_H
\ No newline at end of file
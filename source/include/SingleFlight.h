@@ -0,0 +1,78 @@
+#ifndef SINGLE_FLIGHT_H
+#define SINGLE_FLIGHT_H
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstddef>
+
+#include "Config.h"
+#include "HttpContext.h"
+
+namespace Middleware {
+    // Coalesces identical GET requests: while one runs the rest of the
+    // chain, the others wait for it and are answered with its serialized
+    // response instead of running the handler themselves.
+    //
+    //   server.get("/popular", Middleware::chain(Middleware::SingleFlight()), popular);
+    //
+    // Requests are identical when their method, path, listed query
+    // parameters and headers, and Accept-Encoding match. A waiting request
+    // gives up after maxWait and runs on its own, as it does when the one
+    // it waited for failed, streamed its response, set a cookie or did not
+    // answer 200 OK. Conditional requests join a flight but never start
+    // one; Range requests run alone. Placed after
+    // a ResponseCache, only cache misses are coalesced.
+    class SingleFlight {
+    public:
+        struct Options {
+            std::vector<std::string> queryParams;
+            std::vector<std::string> headers;
+            std::chrono::milliseconds maxWait{Config::SINGLE_FLIGHT_MAX_WAIT};
+            size_t shards = Config::SINGLE_FLIGHT_SHARDS;
+        };
+
+        SingleFlight();
+        explicit SingleFlight(const Options& options);
+
+        template <typename F>
+        void operator()(HttpContext& ctx, F&& next) const {
+            std::shared_ptr<Flight> flight;
+            switch (join(ctx, flight)) {
+                case Role::Leader:
+                    try {
+                        next();
+                    } catch (...) {
+                        land(flight, nullptr);
+                        throw;
+                    }
+                    land(flight, &ctx.res);
+                    return;
+                case Role::Follower:
+                    return;
+                case Role::Alone:
+                    next();
+                    return;
+            }
+        }
+
+        // Requests currently being run for others to share
+        size_t inFlight() const;
+
+    private:
+        enum class Role { Leader, Follower, Alone };
+
+        struct Flight;
+        struct State;
+        std::shared_ptr<State> state_;
+
+        // Leader: ctx runs for everyone, flight is set. Follower: ctx was
+        // answered by another request. Alone: ctx runs for itself.
+        Role join(HttpContext& ctx, std::shared_ptr<Flight>& flight) const;
+        // Hands the leader's response (nullptr if it failed) to the followers
+        void land(const std::shared_ptr<Flight>& flight, HttpResponse* res) const;
+    };
+}
+
+#endif // SINGLE_FLIGHT_H
@@ -0,0 +1,14 @@
+#ifndef SOCKET_H
+#define SOCKET_H
+
+#include <cstddef>
+
+#include "Defs.h"
+
+namespace Socket {
+    // Blocks until all bytes are written; retries on EINTR.
+    bool sendAll(socket_t fd, const char* data, size_t length);
+    bool setSendTimeout(socket_t fd, int seconds);
+}
+
+#endif // SOCKET_H
@@ -0,0 +1,103 @@
+#ifndef TEMPLATE_H
+#define TEMPLATE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <stdexcept>
+#include <string_view>
+#include <initializer_list>
+
+#include "Utils.h"
+
+#include "json.hpp"
+using json = nlohmann::json;
+
+// HTML templates compiled once into a flat list of segments and rendered
+// from a json context.
+//
+//   {{ user.name }}            value, HTML-escaped
+//   {{ html|raw }}             value, unescaped
+//   {% if [not] path %} ... {% else %} ... {% endif %}
+//   {% for item in items %} ... {% endfor %}   loop.index, loop.first, loop.last
+//   {% include "partial.html" %}
+//   {# comment #}
+//
+// Paths are dot-separated object keys or array indices; a missing value
+// renders as nothing and is false in conditions.
+class Template {
+public:
+    class Error : public std::runtime_error {
+    public:
+        explicit Error(const std::string& msg) : std::runtime_error(msg) {}
+    };
+
+    // Throws Template::Error with the line of the offending tag
+    static Template compile(const std::string& source, const std::string& name = "");
+
+    // Compiled template for name under Config::TEMPLATE_DIR. Parsed on first
+    // use and again only when the file's mtime or size changes.
+    static std::shared_ptr<const Template> load(const std::string& name);
+    static void clearCache();
+
+    // Templates compiled into the binary by the build (tools/template_codegen).
+    // They register themselves during static initialization and are used
+    // instead of the files unless Config::TEMPLATE_DEV_MODE is set.
+    using RenderFunction = void (*)(const json& data, std::string& out);
+    struct Precompiled {
+        RenderFunction render;
+        Utils::FileInfo source; // latest mtime and total size of the sources
+    };
+    static void registerPrecompiled(const std::string& name, RenderFunction render, const Utils::FileInfo& source);
+    static const Precompiled* findPrecompiled(const std::string& name);
+
+    void render(const json& data, std::string& out) const;
+    std::string render(const json& data) const;
+
+    const std::string& getName() const { return name; }
+
+    // Latest mtime and total size of the file and everything it includes,
+    // for validators on output that depends on nothing else
+    Utils::FileInfo sourceInfo() const;
+
+private:
+    friend class TemplateCodegen;
+
+    enum class Kind { Text, Escaped, Raw, If, For, Include };
+
+    struct Segment {
+        explicit Segment(Kind kind) : kind(kind) {}
+
+        Kind kind;
+        std::string text;              // literal, loop variable or include name
+        std::vector<std::string> path; // value looked up by Escaped, Raw, If and For
+        bool negate = false;           // {% if not ... %}
+        bool usesLoop = false;         // For: the body reads loop.*
+        size_t elseIndex = 0;          // If: first segment of the else branch
+        size_t end = 0;                // If, For: one past the block
+    };
+
+    struct Scope;
+    class Cache;
+    static Cache& cache();
+
+    std::string name;
+    std::vector<Segment> segments;
+    Utils::FileInfo file; // set when loaded from disk
+
+    Utils::FileInfo sourceInfo(size_t depth) const;
+    void renderRange(size_t begin, size_t end, Scope& scope, std::string& out) const;
+};
+
+// Used by precompiled templates; the runtime renderer shares them so both
+// produce the same output
+namespace TemplateSupport {
+    const json* field(const json& data, std::string_view name);
+    const json* find(const json* value, std::initializer_list<std::string_view> path);
+    void appendEscaped(std::string_view text, std::string& out);
+    void appendValue(const json* value, bool escape, std::string& out);
+    bool isTruthy(const json* value);
+}
+
+#endif // TEMPLATE_H
@@ -3,6 +3,8 @@
 
 #include <string>
 #include <map>
+#include <ctime>
+#include <cstdint>
 
 namespace Utils {
     // String operations
@@ -10,8 +12,30 @@ namespace Utils {
     std::string urlDecode(const std::string& encoded);
     std::map<std::string, std::string> parseUrlEncoded(const std::string& data);
 
+    // Header operations
+    bool hasToken(const std::string& headerValue, const std::string& token); // comma-separated, case-insensitive
+    std::string formatHttpDate(time_t time);
+    time_t parseHttpDate(const std::string& date);
+
+    // Hashing
+    uint64_t hash64(const void* data, size_t length, uint64_t seed = 0);
+    uint64_t hash64(const std::string& data, uint64_t seed = 0);
+    std::string sha1(const std::string& data); // 20 raw bytes
+
+    // Encoding
+    std::string base64Encode(const std::string& data);
+    bool base64Decode(const std::string& data, std::string& decoded); // accepts the URL-safe alphabet too
+
     // File operations
     std::string readFile(const std::string& path);
+    std::string readFileHead(const std::string& path, size_t maxBytes);
+    std::string readFileRange(const std::string& path, uint64_t offset, uint64_t length);
+
+    struct FileInfo {
+        uint64_t size = 0;
+        time_t mtime = 0;
+    };
+    bool statFile(const std::string& path, FileInfo& info);
 }
 
 #endif // UTILS_H
\ No newline at end of file
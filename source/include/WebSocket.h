@@ -0,0 +1,143 @@
+#ifndef WEB_SOCKET_H
+#define WEB_SOCKET_H
+
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+
+#include "Config.h"
+#include "EventLoop.h"
+#include "SafeMap.h"
+
+class HttpContext;
+class WebSocket;
+class WebSocketChannel;
+class PerMessageDeflate;
+
+// Callbacks run on the event loop thread and must not block
+struct WebSocketHandlers {
+    // Runs during the handshake; return false (after setting an error
+    // response) to refuse the upgrade
+    std::function<bool(HttpContext&)> onConnect;
+    std::function<void(WebSocket&)> onOpen;
+    std::function<void(WebSocket&, const std::string& message, bool binary)> onMessage;
+    std::function<void(WebSocket&, uint16_t code, const std::string& reason)> onClose;
+};
+
+// permessage-deflate (RFC 7692) settings for a websocket() route.
+//
+// Without context takeover every message is compressed on its own using
+// per-thread zlib streams, so connections hold no zlib state. With it the
+// window is kept between messages (better ratios on repetitive JSON) at a
+// cost of roughly 2^(windowBits+2) + 2^(memLevel+9) bytes per connection;
+// once Config::WEBSOCKET_DEFLATE_MEMORY_LIMIT is used up, new connections
+// fall back to no context takeover. Such frames cannot be dropped for a
+// slow client like other messages; its connection is closed with 1008.
+struct WebSocketCompression {
+    bool enabled = Config::WEBSOCKET_DEFLATE;
+    bool serverContextTakeover = false;
+    bool clientContextTakeover = false;
+    int serverMaxWindowBits = 15; // 9..15
+    int clientMaxWindowBits = 15; // 8..15, only applies when the client offers it
+    int memLevel = Config::WEBSOCKET_DEFLATE_MEM_LEVEL;
+    int level = Config::COMPRESSION_LEVEL;
+    size_t minSize = Config::WEBSOCKET_DEFLATE_MIN_SIZE;
+};
+
+// RFC 6455 connection parked on the event loop
+class WebSocket : public EventLoop::Connection {
+public:
+    enum Opcode : uint8_t {
+        CONTINUATION = 0x0,
+        TEXT = 0x1,
+        BINARY = 0x2,
+        CLOSE = 0x8,
+        PING = 0x9,
+        PONG = 0xA
+    };
+
+    WebSocket(socket_t fd, std::shared_ptr<const WebSocketHandlers> handlers,
+              WebSocketChannel* channel, const std::string& path,
+              const SafeMap<std::string>& params,
+              std::unique_ptr<PerMessageDeflate> deflate = nullptr);
+    ~WebSocket() override;
+
+    bool sendText(const std::string& message);
+    bool sendBinary(const std::string& message);
+    bool ping(const std::string& payload = "");
+    void close(uint16_t code = 1000, const std::string& reason = "");
+
+    const std::string& getPath() const { return path; }
+    const SafeMap<std::string>& getParams() const { return params; }
+    bool isCompressed() const { return deflate != nullptr; }
+    std::shared_ptr<WebSocket> shared() { return std::static_pointer_cast<WebSocket>(shared_from_this()); }
+
+    // Server-to-client frame (never masked); compressed sets RSV1
+    static std::string encodeFrame(uint8_t opcode, const char* data, size_t length,
+                                   bool fin = true, bool compressed = false);
+    // XORs data in place with the 4-byte masking key, starting at key phase 0
+    static void unmask(char* data, size_t length, const unsigned char key[4]);
+
+protected:
+    void onData(const char* data, size_t length) override;
+    void onClosed() override;
+
+private:
+    friend class WebSocketChannel;
+
+    bool sendMessage(uint8_t opcode, const std::string& message);
+    bool processFrame(bool fin, bool compressed, uint8_t opcode, char* payload, size_t length);
+    void fail(uint16_t code, const std::string& reason);
+    void notifyClose(uint16_t code, const std::string& reason);
+
+    std::shared_ptr<const WebSocketHandlers> handlers;
+    WebSocketChannel* channel;
+    std::string path;
+    SafeMap<std::string> params;
+
+    std::string input;
+    size_t inputOffset = 0;
+    std::unique_ptr<PerMessageDeflate> deflate;
+
+    std::string message;
+    uint8_t messageOpcode = 0;
+    bool messageCompressed = false;
+    std::atomic<bool> closeSent{false}; // close() may be called from any thread
+    bool closeNotified = false;
+};
+
+// All connections accepted on one websocket() route
+class WebSocketChannel {
+public:
+    WebSocketChannel(EventLoop& loop, WebSocketHandlers handlers,
+                     WebSocketCompression compression = WebSocketCompression());
+
+    WebSocketChannel(const WebSocketChannel&) = delete;
+    WebSocketChannel& operator=(const WebSocketChannel&) = delete;
+
+    // Encodes the frame once and queues the same buffer on every connection
+    // (connections with compression context takeover get their own frame).
+    // Returns the number of connections it was queued on.
+    size_t broadcast(const std::string& message, bool binary = false);
+    void closeAll(uint16_t code = 1001, const std::string& reason = "");
+    size_t connectionCount() const;
+
+    // Validates the upgrade request, sends 101 and parks the connection
+    bool accept(HttpContext& ctx);
+
+private:
+    friend class WebSocket;
+    void remove(WebSocket* socket);
+
+    EventLoop& loop;
+    std::shared_ptr<const WebSocketHandlers> handlers;
+    WebSocketCompression compression;
+    mutable std::mutex mutex;
+    std::vector<std::weak_ptr<WebSocket>> connections;
+};
+
+#endif // WEB_SOCKET_H
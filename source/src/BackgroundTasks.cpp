@@ -0,0 +1,65 @@
+#include <iostream>
+#include <exception>
+
+#include "BackgroundTasks.h"
+
+BackgroundTasks::BackgroundTasks(size_t threads, size_t maxQueued)
+    : threads_(threads == 0 ? 1 : threads), maxQueued_(maxQueued) {}
+
+BackgroundTasks::~BackgroundTasks() {
+    stop();
+}
+
+bool BackgroundTasks::post(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopped_ || jobs_.size() >= maxQueued_) {
+            return false;
+        }
+        jobs_.push_back(std::move(job));
+        if (workers_.size() < threads_) {
+            workers_.emplace_back([this]() { work(); });
+        }
+    }
+    ready_.notify_one();
+    return true;
+}
+
+void BackgroundTasks::start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopped_ = false;
+}
+
+void BackgroundTasks::stop() {
+    std::vector<std::thread> workers;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+        workers.swap(workers_);
+    }
+    ready_.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void BackgroundTasks::work() {
+    for (;;) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            ready_.wait(lock, [this]() { return stopped_ || !jobs_.empty(); });
+            if (jobs_.empty()) {
+                return;
+            }
+            job = std::move(jobs_.front());
+            jobs_.pop_front();
+        }
+
+        try {
+            job();
+        } catch (const std::exception& e) {
+            std::cerr << "Background job failed: " << e.what() << std::endl;
+        }
+    }
+}
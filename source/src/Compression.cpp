@@ -0,0 +1,743 @@
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <list>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+#include <cstdlib>
+#include <zlib.h>
+
+#ifdef CPPSERVER_HAVE_BROTLI
+#include <brotli/encode.h>
+#endif
+#ifdef CPPSERVER_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "Utils.h"
+#include "MimeType.h"
+#include "Compression.h"
+
+namespace Compression {
+    static Policy currentPolicy;
+    static std::atomic<int> busyWorkers{0};
+
+    void setPolicy(const Policy& policy) {
+        currentPolicy = policy;
+    }
+
+    const Policy& policy() {
+        return currentPolicy;
+    }
+
+    BusyScope::BusyScope() {
+        busyWorkers.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    BusyScope::~BusyScope() {
+        busyWorkers.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    double utilization() {
+        static const unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+        return static_cast<double>(busyWorkers.load(std::memory_order_relaxed)) / cores;
+    }
+
+    int chooseLevel(const std::string& contentType, size_t size) {
+        const Policy& p = currentPolicy;
+
+        if (p.adaptToLoad && utilization() > p.highLoadThreshold) {
+            return p.highLoadLevel;
+        }
+
+        if (p.largeBodySize > 0 && size >= p.largeBodySize) {
+            return p.largeBodyLevel;
+        }
+
+        for (const auto& [prefix, level] : p.levelsByType) {
+            if (contentType.compare(0, prefix.length(), prefix) == 0) {
+                return level;
+            }
+        }
+
+        return p.defaultLevel;
+    }
+
+    bool isCompressible(const std::string& contentType) {
+        return contentType.find("text/") != std::string::npos ||
+               contentType.find("application/json") != std::string::npos ||
+               contentType.find("application/javascript") != std::string::npos ||
+               contentType.find("application/xml") != std::string::npos ||
+               contentType.find("application/x-www-form-urlencoded") != std::string::npos ||
+               contentType.find("image/svg+xml") != std::string::npos ||
+               contentType.find("application/wasm") != std::string::npos;
+    }
+
+    bool isCompressibleExtension(const std::string& path) {
+        const char* type = mimeTypeForPath(path);
+        return type != nullptr && isCompressible(type);
+    }
+
+    const char* encodingName(Encoding encoding) {
+        switch (encoding) {
+            case Encoding::Gzip: return "gzip";
+            case Encoding::Brotli: return "br";
+            case Encoding::Zstd: return "zstd";
+            case Encoding::Identity: break;
+        }
+        return "identity";
+    }
+
+    bool isAvailable(Encoding encoding) {
+        switch (encoding) {
+            case Encoding::Identity:
+            case Encoding::Gzip:
+                return true;
+            case Encoding::Brotli:
+#ifdef CPPSERVER_HAVE_BROTLI
+                return true;
+#else
+                return false;
+#endif
+            case Encoding::Zstd:
+#ifdef CPPSERVER_HAVE_ZSTD
+                return true;
+#else
+                return false;
+#endif
+        }
+        return false;
+    }
+
+    std::vector<Encoding> rankEncodings(const std::string& acceptEncoding, const std::vector<Encoding>& candidates) {
+        // -1 marks codings the header does not mention
+        std::vector<double> weights(candidates.size(), -1.0);
+        double wildcard = -1.0;
+        double identity = -1.0;
+
+        size_t start = 0;
+        while (start <= acceptEncoding.length()) {
+            size_t end = acceptEncoding.find(',', start);
+            if (end == std::string::npos) end = acceptEncoding.length();
+
+            std::string item = acceptEncoding.substr(start, end - start);
+            std::transform(item.begin(), item.end(), item.begin(), ::tolower);
+            start = end + 1;
+
+            double q = 1.0;
+            size_t semi = item.find(';');
+            if (semi != std::string::npos) {
+                size_t qPos = item.find("q=", semi);
+                if (qPos != std::string::npos) {
+                    q = std::clamp(std::strtod(item.c_str() + qPos + 2, nullptr), 0.0, 1.0);
+                }
+                item.erase(semi);
+            }
+
+            std::string token = Utils::trim(item);
+            if (token == "*") {
+                wildcard = q;
+            } else if (token == "identity") {
+                identity = q;
+            } else {
+                for (size_t i = 0; i < candidates.size(); i++) {
+                    if (token == encodingName(candidates[i]) ||
+                        (token == "x-gzip" && candidates[i] == Encoding::Gzip)) {
+                        weights[i] = q;
+                    }
+                }
+            }
+        }
+
+        std::vector<std::pair<double, Encoding>> accepted;
+        for (size_t i = 0; i < candidates.size(); i++) {
+            double q = weights[i] >= 0 ? weights[i] : wildcard;
+            if (q > 0 && q >= identity) {
+                accepted.emplace_back(q, candidates[i]);
+            }
+        }
+        std::stable_sort(accepted.begin(), accepted.end(),
+                         [](const auto& a, const auto& b) { return a.first > b.first; });
+
+        std::vector<Encoding> ranked;
+        ranked.reserve(accepted.size());
+        for (const auto& entry : accepted) {
+            ranked.push_back(entry.second);
+        }
+        return ranked;
+    }
+
+    Encoding negotiate(const std::string& acceptEncoding, const std::string& contentType) {
+        if (acceptEncoding.empty()) return Encoding::Identity;
+
+        const Policy& p = currentPolicy;
+        const std::vector<Encoding>* preference = &p.encodings;
+        for (const auto& [prefix, encodings] : p.encodingsByType) {
+            if (contentType.compare(0, prefix.length(), prefix) == 0) {
+                preference = &encodings;
+                break;
+            }
+        }
+
+        std::vector<Encoding> candidates;
+        for (Encoding encoding : *preference) {
+            if (encoding != Encoding::Identity && isAvailable(encoding)) {
+                candidates.push_back(encoding);
+            }
+        }
+
+        std::vector<Encoding> ranked = rankEncodings(acceptEncoding, candidates);
+        return ranked.empty() ? Encoding::Identity : ranked.front();
+    }
+
+    // Policy levels are on zlib's 1-9 scale. The gzip default of 6 becomes
+    // brotli quality 5 and zstd level 3, which cost about the same CPU and
+    // compress text better.
+#ifdef CPPSERVER_HAVE_BROTLI
+    static int brotliQuality(int level) {
+        return std::clamp(level - 1, 1, 11);
+    }
+#endif
+
+#ifdef CPPSERVER_HAVE_ZSTD
+    static int zstdLevel(int level) {
+        return std::clamp((level + 1) / 2, 1, 19);
+    }
+#endif
+
+    // One deflate state per thread, reset between responses instead of
+    // re-running deflateInit2/deflateEnd (~256 KB of zlib state) each time.
+    class DeflateContext {
+    public:
+        ~DeflateContext() {
+            if (initialized) deflateEnd(&zs);
+        }
+
+        z_stream* acquire(int level) {
+            if (!initialized) {
+                zs.zalloc = Z_NULL;
+                zs.zfree = Z_NULL;
+                zs.opaque = Z_NULL;
+                if (deflateInit2(&zs, level, Z_DEFLATED, 31, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+                    throw std::runtime_error("Failed to initialize zlib deflate");
+                }
+                initialized = true;
+                currentLevel = level;
+                return &zs;
+            }
+
+            if (deflateReset(&zs) != Z_OK) {
+                throw std::runtime_error("Failed to reset zlib deflate");
+            }
+            if (level != currentLevel) {
+                if (deflateParams(&zs, level, Z_DEFAULT_STRATEGY) != Z_OK) {
+                    throw std::runtime_error("Failed to set zlib compression level");
+                }
+                currentLevel = level;
+            }
+            return &zs;
+        }
+
+    private:
+        z_stream zs{};
+        bool initialized = false;
+        int currentLevel = 0;
+    };
+
+    std::string gzip(const std::string& content, int level) {
+        thread_local DeflateContext context;
+        z_stream* zs = context.acquire(level);
+
+        std::string out;
+        out.resize(deflateBound(zs, static_cast<uLong>(content.size())));
+
+        zs->next_in = (Bytef*)content.data();
+        zs->avail_in = static_cast<uInt>(content.size());
+        zs->next_out = reinterpret_cast<Bytef*>(&out[0]);
+        zs->avail_out = static_cast<uInt>(out.size());
+
+        if (deflate(zs, Z_FINISH) != Z_STREAM_END) {
+            throw std::runtime_error("Failed to compress data");
+        }
+
+        out.resize(zs->total_out);
+        return out;
+    }
+
+#ifdef CPPSERVER_HAVE_BROTLI
+    static std::string brotli(const std::string& content, int quality) {
+        std::string out;
+        out.resize(BrotliEncoderMaxCompressedSize(content.size()));
+        size_t size = out.size();
+
+        if (size == 0 ||
+            !BrotliEncoderCompress(quality, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT, content.size(),
+                                   reinterpret_cast<const uint8_t*>(content.data()), &size,
+                                   reinterpret_cast<uint8_t*>(&out[0]))) {
+            throw std::runtime_error("Failed to compress data");
+        }
+
+        out.resize(size);
+        return out;
+    }
+#endif
+
+#ifdef CPPSERVER_HAVE_ZSTD
+    // One compression context per thread, like DeflateContext
+    class ZstdContext {
+    public:
+        ~ZstdContext() {
+            ZSTD_freeCCtx(cctx);
+        }
+
+        ZSTD_CCtx* acquire() {
+            if (!cctx) {
+                cctx = ZSTD_createCCtx();
+                if (!cctx) throw std::runtime_error("Failed to initialize zstd");
+            }
+            return cctx;
+        }
+
+    private:
+        ZSTD_CCtx* cctx = nullptr;
+    };
+
+    static std::string zstd(const std::string& content, int level) {
+        thread_local ZstdContext context;
+
+        std::string out;
+        out.resize(ZSTD_compressBound(content.size()));
+
+        size_t size = ZSTD_compressCCtx(context.acquire(), &out[0], out.size(),
+                                        content.data(), content.size(), level);
+        if (ZSTD_isError(size)) {
+            throw std::runtime_error(std::string("Failed to compress data: ") + ZSTD_getErrorName(size));
+        }
+
+        out.resize(size);
+        return out;
+    }
+#endif
+
+    std::string encode(Encoding encoding, const std::string& content, int level) {
+        switch (encoding) {
+            case Encoding::Identity:
+                return content;
+            case Encoding::Gzip:
+                return gzip(content, level);
+#ifdef CPPSERVER_HAVE_BROTLI
+            case Encoding::Brotli:
+                return brotli(content, brotliQuality(level));
+#endif
+#ifdef CPPSERVER_HAVE_ZSTD
+            case Encoding::Zstd:
+                return zstd(content, zstdLevel(level));
+#endif
+            default:
+                break;
+        }
+        throw std::runtime_error(std::string("Encoding not available: ") + encodingName(encoding));
+    }
+
+    GzipStream::GzipStream(int level) : zs(new z_stream_s()) {
+        zs->zalloc = Z_NULL;
+        zs->zfree = Z_NULL;
+        zs->opaque = Z_NULL;
+        if (deflateInit2(zs.get(), level, Z_DEFLATED, 31, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            throw std::runtime_error("Failed to initialize zlib deflate");
+        }
+    }
+
+    GzipStream::~GzipStream() {
+        deflateEnd(zs.get());
+    }
+
+    void GzipStream::write(const char* data, size_t length, std::string& out, Flush flush) {
+        int mode = flush == Flush::Finish ? Z_FINISH :
+                   flush == Flush::Sync ? Z_SYNC_FLUSH : Z_NO_FLUSH;
+
+        zs->next_in = (Bytef*)data;
+        zs->avail_in = static_cast<uInt>(length);
+
+        char outbuffer[16384];
+        int ret;
+        do {
+            zs->next_out = reinterpret_cast<Bytef*>(outbuffer);
+            zs->avail_out = sizeof(outbuffer);
+
+            ret = deflate(zs.get(), mode);
+            if (ret == Z_STREAM_ERROR) {
+                throw std::runtime_error("Failed to compress data");
+            }
+
+            out.append(outbuffer, sizeof(outbuffer) - zs->avail_out);
+        } while (zs->avail_out == 0 && ret != Z_STREAM_END);
+    }
+
+#ifdef CPPSERVER_HAVE_BROTLI
+    class BrotliStream : public EncoderStream {
+    public:
+        explicit BrotliStream(int quality) : state(BrotliEncoderCreateInstance(nullptr, nullptr, nullptr)) {
+            if (!state) throw std::runtime_error("Failed to initialize brotli");
+            BrotliEncoderSetParameter(state, BROTLI_PARAM_QUALITY, static_cast<uint32_t>(quality));
+            BrotliEncoderSetParameter(state, BROTLI_PARAM_MODE, BROTLI_MODE_TEXT);
+        }
+
+        ~BrotliStream() override {
+            BrotliEncoderDestroyInstance(state);
+        }
+
+        void write(const char* data, size_t length, std::string& out, Flush flush) override {
+            BrotliEncoderOperation op = flush == Flush::Finish ? BROTLI_OPERATION_FINISH :
+                                        flush == Flush::Sync ? BROTLI_OPERATION_FLUSH : BROTLI_OPERATION_PROCESS;
+
+            size_t availableIn = length;
+            const uint8_t* nextIn = reinterpret_cast<const uint8_t*>(data);
+
+            uint8_t outbuffer[16384];
+            do {
+                size_t availableOut = sizeof(outbuffer);
+                uint8_t* nextOut = outbuffer;
+
+                if (!BrotliEncoderCompressStream(state, op, &availableIn, &nextIn, &availableOut, &nextOut, nullptr)) {
+                    throw std::runtime_error("Failed to compress data");
+                }
+
+                out.append(reinterpret_cast<const char*>(outbuffer), sizeof(outbuffer) - availableOut);
+            } while (availableIn > 0 || BrotliEncoderHasMoreOutput(state) ||
+                     (op == BROTLI_OPERATION_FINISH && !BrotliEncoderIsFinished(state)));
+        }
+
+    private:
+        BrotliEncoderState* state;
+    };
+#endif
+
+#ifdef CPPSERVER_HAVE_ZSTD
+    class ZstdStream : public EncoderStream {
+    public:
+        explicit ZstdStream(int level) : cctx(ZSTD_createCCtx()) {
+            if (!cctx) throw std::runtime_error("Failed to initialize zstd");
+            ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level);
+        }
+
+        ~ZstdStream() override {
+            ZSTD_freeCCtx(cctx);
+        }
+
+        void write(const char* data, size_t length, std::string& out, Flush flush) override {
+            ZSTD_EndDirective mode = flush == Flush::Finish ? ZSTD_e_end :
+                                     flush == Flush::Sync ? ZSTD_e_flush : ZSTD_e_continue;
+
+            ZSTD_inBuffer input = {data, length, 0};
+            char outbuffer[16384];
+            size_t remaining;
+            do {
+                ZSTD_outBuffer output = {outbuffer, sizeof(outbuffer), 0};
+                remaining = ZSTD_compressStream2(cctx, &output, &input, mode);
+                if (ZSTD_isError(remaining)) {
+                    throw std::runtime_error(std::string("Failed to compress data: ") + ZSTD_getErrorName(remaining));
+                }
+                out.append(outbuffer, output.pos);
+            } while (mode == ZSTD_e_continue ? input.pos < input.size : remaining != 0);
+        }
+
+    private:
+        ZSTD_CCtx* cctx;
+    };
+#endif
+
+    std::unique_ptr<EncoderStream> makeStream(Encoding encoding, int level) {
+        switch (encoding) {
+            case Encoding::Gzip:
+                return std::make_unique<GzipStream>(level);
+#ifdef CPPSERVER_HAVE_BROTLI
+            case Encoding::Brotli:
+                return std::make_unique<BrotliStream>(brotliQuality(level));
+#endif
+#ifdef CPPSERVER_HAVE_ZSTD
+            case Encoding::Zstd:
+                return std::make_unique<ZstdStream>(zstdLevel(level));
+#endif
+            default:
+                break;
+        }
+        throw std::runtime_error(std::string("Encoding not available: ") + encodingName(encoding));
+    }
+
+    class CompressedCache {
+    public:
+        // The body is kept next to its compressed form: the key is only a
+        // hash, and a collision must not hand out another body
+        struct Cached {
+            std::string source;
+            std::string compressed;
+        };
+        using Value = std::shared_ptr<const Cached>;
+
+        struct Key {
+            uint64_t hash;
+            size_t size;
+            int encoding;
+            int level;
+
+            bool operator==(const Key& other) const {
+                return hash == other.hash && size == other.size &&
+                       encoding == other.encoding && level == other.level;
+            }
+        };
+
+        struct KeyHash {
+            size_t operator()(const Key& key) const {
+                return static_cast<size_t>(key.hash ^ (static_cast<uint64_t>(key.level) << 56) ^ key.encoding);
+            }
+        };
+
+        CompressedCache() : stripes(std::make_unique<Stripe[]>(Config::COMPRESSION_CACHE_STRIPES)) {}
+
+        // maxBytes is shared evenly among the stripes
+        void setCapacity(size_t maxBytes) {
+            capacity = maxBytes / Config::COMPRESSION_CACHE_STRIPES;
+            for (size_t i = 0; i < Config::COMPRESSION_CACHE_STRIPES; i++) {
+                std::lock_guard<std::mutex> lock(stripes[i].mutex);
+                evictLocked(stripes[i]);
+            }
+        }
+
+        bool enabled() const {
+            return capacity.load(std::memory_order_relaxed) > 0;
+        }
+
+        Value find(const Key& key, const std::string& content) {
+            Stripe& stripe = stripeFor(key);
+            Value value;
+            {
+                std::lock_guard<std::mutex> lock(stripe.mutex);
+                auto it = stripe.index.find(key);
+                if (it != stripe.index.end()) {
+                    stripe.lru.splice(stripe.lru.begin(), stripe.lru, it->second);
+                    value = it->second->second;
+                }
+            }
+
+            // compared outside the lock, large bodies being the point
+            if (!value || value->source != content) {
+                misses.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            hits.fetch_add(1, std::memory_order_relaxed);
+            return value;
+        }
+
+        void insert(const Key& key, Value value) {
+            Stripe& stripe = stripeFor(key);
+            std::lock_guard<std::mutex> lock(stripe.mutex);
+            if (sizeOf(*value) > capacity) return;
+
+            auto it = stripe.index.find(key);
+            if (it != stripe.index.end()) {
+                // the newer body wins a collision
+                stripe.bytes -= sizeOf(*it->second->second);
+                stripe.lru.erase(it->second);
+                stripe.index.erase(it);
+            }
+
+            stripe.lru.emplace_front(key, value);
+            stripe.index[key] = stripe.lru.begin();
+            stripe.bytes += sizeOf(*value);
+            evictLocked(stripe);
+        }
+
+        CacheStats snapshot() {
+            CacheStats copy;
+            copy.hits = hits.load(std::memory_order_relaxed);
+            copy.misses = misses.load(std::memory_order_relaxed);
+            copy.evictions = evictions.load(std::memory_order_relaxed);
+            for (size_t i = 0; i < Config::COMPRESSION_CACHE_STRIPES; i++) {
+                std::lock_guard<std::mutex> lock(stripes[i].mutex);
+                copy.entries += stripes[i].index.size();
+                copy.bytes += stripes[i].bytes;
+            }
+            return copy;
+        }
+
+    private:
+        using Entry = std::pair<Key, Value>;
+
+        struct alignas(64) Stripe {
+            std::mutex mutex;
+            std::list<Entry> lru; // most recently used first
+            std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+            size_t bytes = 0;
+        };
+
+        static size_t sizeOf(const Cached& cached) {
+            return cached.source.size() + cached.compressed.size();
+        }
+
+        Stripe& stripeFor(const Key& key) const {
+            return stripes[key.hash % Config::COMPRESSION_CACHE_STRIPES];
+        }
+
+        void evictLocked(Stripe& stripe) {
+            while (stripe.bytes > capacity && !stripe.lru.empty()) {
+                stripe.bytes -= sizeOf(*stripe.lru.back().second);
+                stripe.index.erase(stripe.lru.back().first);
+                stripe.lru.pop_back();
+                evictions.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        std::unique_ptr<Stripe[]> stripes;
+        std::atomic<size_t> capacity{0}; // per stripe
+        std::atomic<uint64_t> hits{0};
+        std::atomic<uint64_t> misses{0};
+        std::atomic<uint64_t> evictions{0};
+    };
+
+    static CompressedCache compressedCache;
+
+    void setCacheCapacity(size_t maxBytes) {
+        compressedCache.setCapacity(maxBytes);
+    }
+
+    CacheStats cacheStats() {
+        return compressedCache.snapshot();
+    }
+
+    std::string gzipCached(const std::string& content, int level) {
+        return encodeCached(Encoding::Gzip, content, level);
+    }
+
+    std::string encodeCached(Encoding encoding, const std::string& content, int level) {
+        if (!compressedCache.enabled()) {
+            return encode(encoding, content, level);
+        }
+
+        CompressedCache::Key key{Utils::hash64(content), content.size(), static_cast<int>(encoding), level};
+        if (auto cached = compressedCache.find(key, content)) {
+            return cached->compressed;
+        }
+
+        std::string compressed = encode(encoding, content, level);
+        compressedCache.insert(key, std::make_shared<const CompressedCache::Cached>(
+            CompressedCache::Cached{content, compressed}));
+        return compressed;
+    }
+
+    static bool needsVariant(const std::filesystem::path& source, const std::filesystem::path& variant) {
+        std::error_code ec;
+        if (!std::filesystem::exists(variant, ec)) return true;
+        return std::filesystem::last_write_time(variant, ec) < std::filesystem::last_write_time(source, ec);
+    }
+
+    static bool writeVariant(const std::filesystem::path& variant, const std::string& content) {
+        std::filesystem::path tmp = variant;
+        tmp += ".tmp";
+
+        {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            if (!out) return false;
+            out.write(content.data(), content.size());
+            if (!out) return false;
+        }
+
+        std::error_code ec;
+        std::filesystem::rename(tmp, variant, ec);
+        if (ec) {
+            std::filesystem::remove(tmp, ec);
+            return false;
+        }
+        return true;
+    }
+
+    // Static variants are written once and served many times, so they use
+    // the strongest settings
+    struct StaticVariant {
+        Encoding encoding;
+        const char* suffix;
+    };
+
+    static const StaticVariant staticVariants[] = {
+        {Encoding::Gzip, ".gz"},
+        {Encoding::Brotli, ".br"}
+    };
+
+    static std::string encodeStatic(Encoding encoding, const std::string& content) {
+#ifdef CPPSERVER_HAVE_BROTLI
+        if (encoding == Encoding::Brotli) {
+            return brotli(content, BROTLI_MAX_QUALITY);
+        }
+#endif
+        return encode(encoding, content, 9);
+    }
+
+    size_t precompressDirectory(const std::string& dir, unsigned int threads) {
+        std::error_code ec;
+        if (!std::filesystem::is_directory(dir, ec)) return 0;
+
+        std::vector<std::pair<std::filesystem::path, const StaticVariant*>> jobs;
+        for (auto it = std::filesystem::recursive_directory_iterator(dir, ec);
+             it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+            if (ec) break;
+            if (!it->is_regular_file(ec)) continue;
+
+            const auto& path = it->path();
+            if (!isCompressibleExtension(path.string())) continue;
+
+            for (const auto& variant : staticVariants) {
+                if (!isAvailable(variant.encoding)) continue;
+
+                std::filesystem::path target = path;
+                target += variant.suffix;
+                if (needsVariant(path, target)) {
+                    jobs.emplace_back(path, &variant);
+                }
+            }
+        }
+
+        if (jobs.empty()) return 0;
+
+        if (threads == 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        threads = std::min<unsigned int>(threads, static_cast<unsigned int>(jobs.size()));
+
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> written{0};
+        auto worker = [&]() {
+            for (size_t i = next++; i < jobs.size(); i = next++) {
+                const auto& [source, variant] = jobs[i];
+                try {
+                    std::string content = Utils::readFile(source.string());
+                    std::string compressed = encodeStatic(variant->encoding, content);
+                    if (compressed.length() >= content.length()) continue;
+
+                    std::filesystem::path target = source;
+                    target += variant->suffix;
+                    if (writeVariant(target, compressed)) {
+                        written++;
+                    }
+                } catch (const std::exception& e) {
+                    std::cerr << "Failed to precompress " << source.string() << ": " << e.what() << std::endl;
+                }
+            }
+        };
+
+        std::vector<std::thread> pool;
+        for (unsigned int i = 0; i < threads; i++) {
+            pool.emplace_back(worker);
+        }
+        for (auto& t : pool) {
+            t.join();
+        }
+
+        return written;
+    }
+}
@@ -0,0 +1,298 @@
+#include <iostream>
+#include <algorithm>
+
+#ifndef _WIN32
+    #include <poll.h>
+#endif
+
+#include "EventLoop.h"
+
+static void setNonBlocking(socket_t fd) {
+#ifdef _WIN32
+    unsigned long mode = 1;
+    ioctlsocket(fd, FIONBIO, &mode);
+#else
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags != -1) {
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    }
+#endif
+}
+
+static bool wouldBlock() {
+#ifdef _WIN32
+    int error = WSAGetLastError();
+    return error == WSAEWOULDBLOCK || error == WSAEINTR;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+}
+
+EventLoop::Connection::Connection(socket_t fd, size_t maxQueuedBytes)
+    : fd(fd), maxQueuedBytes(maxQueuedBytes), lastSend(Clock::now()) {}
+
+EventLoop::Connection::~Connection() {
+    if (fd != INVALID_SOCK) {
+#ifdef _WIN32
+        closesocket(fd);
+#else
+        ::close(fd);
+#endif
+    }
+}
+
+bool EventLoop::Connection::send(Buffer data, bool droppable) {
+    if (!data || data->empty()) return true;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (closeRequested || isClosed()) return false;
+
+        if (droppable && queuedBytes + data->size() > maxQueuedBytes) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        queuedBytes += data->size();
+        queue.push_back(std::move(data));
+        lastSend = Clock::now();
+    }
+
+    if (loop) loop->wake();
+    return true;
+}
+
+void EventLoop::Connection::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closeRequested = true;
+    }
+    if (loop) loop->wake();
+}
+
+EventLoop::Clock::time_point EventLoop::Connection::getLastSend() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return lastSend;
+}
+
+size_t EventLoop::Connection::getQueuedBytes() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return queuedBytes;
+}
+
+bool EventLoop::Connection::hasPending() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return !queue.empty();
+}
+
+// Writes as much as the socket takes. Returns false if the connection
+// should be closed.
+bool EventLoop::Connection::flushPending() {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (!queue.empty()) {
+        Buffer front = queue.front();
+        lock.unlock();
+
+        const char* data = front->data() + frontOffset;
+        size_t remaining = front->size() - frontOffset;
+        int sent = ::send(fd, data, static_cast<int>(remaining),
+#ifdef MSG_NOSIGNAL
+                          MSG_NOSIGNAL);
+#else
+                          0);
+#endif
+
+        lock.lock();
+        if (sent == SOCKET_ERROR) {
+            return wouldBlock();
+        }
+
+        frontOffset += sent;
+        queuedBytes -= sent;
+        if (frontOffset == front->size()) {
+            queue.pop_front();
+            frontOffset = 0;
+        }
+    }
+
+    if (!closeRequested) return true;
+    if (!lingering) {
+        lingering = true;
+        lingerUntil = Clock::now() + std::chrono::seconds(Config::EVENT_LOOP_LINGER);
+#ifdef _WIN32
+        ::shutdown(fd, SD_SEND);
+#else
+        ::shutdown(fd, SHUT_WR);
+#endif
+    }
+    return Clock::now() < lingerUntil;
+}
+
+EventLoop::EventLoop() {}
+
+EventLoop::~EventLoop() {
+    stop();
+}
+
+void EventLoop::start() {
+    if (running) return;
+
+#ifndef _WIN32
+    if (pipe(wakeFds) == 0) {
+        setNonBlocking(wakeFds[0]);
+        setNonBlocking(wakeFds[1]);
+    }
+#endif
+
+    running = true;
+    thread = std::thread([this]() { run(); });
+}
+
+void EventLoop::stop() {
+    if (!running) return;
+
+    running = false;
+    wake();
+    if (thread.joinable()) {
+        thread.join();
+    }
+
+    for (auto& connection : connections) {
+        closeConnection(connection);
+    }
+    connections.clear();
+
+    std::lock_guard<std::mutex> lock(pendingMutex);
+    for (auto& connection : pending) {
+        closeConnection(connection);
+    }
+    pending.clear();
+
+#ifndef _WIN32
+    ::close(wakeFds[0]);
+    ::close(wakeFds[1]);
+    wakeFds[0] = wakeFds[1] = -1;
+#endif
+}
+
+void EventLoop::add(std::shared_ptr<Connection> connection) {
+    setNonBlocking(connection->fd);
+    connection->loop = this;
+
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        pending.push_back(std::move(connection));
+    }
+    count.fetch_add(1, std::memory_order_relaxed);
+    wake();
+}
+
+void EventLoop::wake() {
+#ifndef _WIN32
+    if (wakeFds[1] != -1) {
+        char byte = 1;
+        ssize_t ignored = write(wakeFds[1], &byte, 1);
+        (void)ignored;
+    }
+#endif
+}
+
+void EventLoop::closeConnection(const std::shared_ptr<Connection>& connection) {
+    if (connection->closed.exchange(true)) return;
+
+    connection->onClosed();
+    count.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void EventLoop::run() {
+    std::vector<pollfd> fds;
+    std::vector<char> buffer(Config::BUFFER_SIZE);
+    Clock::time_point lastTick = Clock::now();
+
+    while (running) {
+        {
+            std::lock_guard<std::mutex> lock(pendingMutex);
+            for (auto& connection : pending) {
+                connections.push_back(std::move(connection));
+            }
+            pending.clear();
+        }
+
+        fds.clear();
+#ifndef _WIN32
+        fds.push_back({wakeFds[0], POLLIN, 0});
+        const size_t offset = 1;
+#else
+        const size_t offset = 0;
+#endif
+        for (const auto& connection : connections) {
+            short events = POLLIN;
+            if (connection->hasPending()) events |= POLLOUT;
+            fds.push_back({connection->fd, events, 0});
+        }
+
+#ifdef _WIN32
+        // No wake pipe on Windows; a short timeout picks up queued data
+        int ready = fds.empty() ? (Sleep(10), 0) : WSAPoll(fds.data(), static_cast<ULONG>(fds.size()), 10);
+#else
+        int ready = poll(fds.data(), fds.size(), 1000);
+#endif
+        if (ready < 0 && !wouldBlock()) {
+            std::cerr << "Event loop poll failed" << std::endl;
+            break;
+        }
+
+#ifndef _WIN32
+        if (fds[0].revents & POLLIN) {
+            char drain[256];
+            while (read(wakeFds[0], drain, sizeof(drain)) > 0) {}
+        }
+#endif
+
+        for (size_t i = 0; i < connections.size(); i++) {
+            auto& connection = connections[i];
+            short revents = fds[i + offset].revents;
+            bool alive = !connection->isClosed();
+
+            if (alive && (revents & POLLIN)) {
+                while (true) {
+                    int n = recv(connection->fd, buffer.data(), static_cast<int>(buffer.size()), 0);
+                    if (n > 0) {
+                        // input after our close is read only to be discarded
+                        if (!connection->lingering) connection->onData(buffer.data(), n);
+                        if (static_cast<size_t>(n) < buffer.size()) break;
+                    } else {
+                        if (n == 0 || !wouldBlock()) alive = false;
+                        break;
+                    }
+                }
+            }
+
+            if (alive && (revents & (POLLERR | POLLHUP | POLLNVAL)) && !(revents & POLLIN)) {
+                alive = false;
+            }
+
+            if (alive && !connection->isClosed()) {
+                alive = connection->flushPending();
+            }
+
+            if (!alive || connection->isClosed()) {
+                closeConnection(connection);
+            }
+        }
+
+        Clock::time_point now = Clock::now();
+        if (now - lastTick >= std::chrono::seconds(1)) {
+            lastTick = now;
+            for (auto& connection : connections) {
+                if (!connection->isClosed()) connection->onTick(now);
+            }
+        }
+
+        connections.erase(
+            std::remove_if(connections.begin(), connections.end(),
+                           [](const std::shared_ptr<Connection>& c) { return c->isClosed(); }),
+            connections.end());
+    }
+}
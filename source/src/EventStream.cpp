@@ -0,0 +1,125 @@
+#include <sstream>
+#include <algorithm>
+
+#include "Socket.h"
+#include "HttpServer.h"
+#include "EventStream.h"
+
+namespace {
+    class EventStreamClient : public EventLoop::Connection {
+    public:
+        using EventLoop::Connection::Connection;
+
+    protected:
+        void onTick(EventLoop::Clock::time_point now) override {
+            static const EventLoop::Buffer heartbeat = std::make_shared<const std::string>(":\n\n");
+            if (now - getLastSend() >= std::chrono::seconds(Config::SSE_HEARTBEAT_INTERVAL)) {
+                send(heartbeat);
+            }
+        }
+    };
+}
+
+EventChannel::EventChannel(EventLoop& loop) : loop(loop) {}
+
+std::string EventChannel::serialize(const std::string& data, const std::string& event, const std::string& id) {
+    std::string out;
+    out.reserve(data.length() + event.length() + id.length() + 32);
+
+    if (!event.empty()) out += "event: " + event + "\n";
+    if (!id.empty()) out += "id: " + id + "\n";
+
+    size_t start = 0;
+    while (true) {
+        size_t end = data.find('\n', start);
+        out += "data: ";
+        out.append(data, start, end == std::string::npos ? std::string::npos : end - start);
+        out += "\n";
+        if (end == std::string::npos) break;
+        start = end + 1;
+    }
+
+    out += "\n";
+    return out;
+}
+
+size_t EventChannel::publish(const std::string& data, const std::string& event, const std::string& id) {
+    EventLoop::Buffer buffer = std::make_shared<const std::string>(serialize(data, event, id));
+
+    std::vector<std::shared_ptr<EventLoop::Connection>> targets;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        targets.reserve(subscribers.size());
+        subscribers.erase(
+            std::remove_if(subscribers.begin(), subscribers.end(),
+                [&](const std::weak_ptr<EventLoop::Connection>& weak) {
+                    auto connection = weak.lock();
+                    if (!connection || connection->isClosed()) return true;
+                    targets.push_back(std::move(connection));
+                    return false;
+                }),
+            subscribers.end());
+    }
+
+    size_t queued = 0;
+    for (const auto& connection : targets) {
+        if (connection->send(buffer)) {
+            queued++;
+        } else {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    return queued;
+}
+
+void EventChannel::closeAll() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& weak : subscribers) {
+        if (auto connection = weak.lock()) connection->close();
+    }
+    subscribers.clear();
+}
+
+size_t EventChannel::subscriberCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return static_cast<size_t>(std::count_if(subscribers.begin(), subscribers.end(),
+        [](const std::weak_ptr<EventLoop::Connection>& weak) {
+            auto connection = weak.lock();
+            return connection && !connection->isClosed();
+        }));
+}
+
+bool EventChannel::subscribe(HttpContext& ctx) {
+    if (!loop.isRunning()) {
+        ctx.res.setStatus(HttpStatus::SERVICE_UNAVAILABLE).setBody("Service Unavailable\n");
+        return false;
+    }
+
+    // The socket is shared with other HTTP/2 streams and cannot be parked
+    if (ctx.res.isMultiplexed()) {
+        ctx.res.setStatus(HttpStatus::HTTP_VERSION_NOT_SUPPORTED).setBody("HTTP/1.1 Required\n");
+        return false;
+    }
+
+    ctx.res.setStatus(HttpStatus::OK);
+    ctx.res.setHeader("Content-Type", "text/event-stream");
+    ctx.res.setHeader("Cache-Control", "no-cache");
+    ctx.res.setHeader("Connection", "keep-alive");
+    ctx.res.setHeader("X-Accel-Buffering", "no");
+    ctx.res.detach();
+
+    // The client owns the socket from here on, also if the handshake fails
+    auto client = std::make_shared<EventStreamClient>(ctx.res.getConnfd());
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        subscribers.push_back(client);
+    }
+
+    std::string head = ctx.res.toString() + ": connected\n\n";
+    if (!Socket::sendAll(ctx.res.getConnfd(), head.data(), head.length())) {
+        return false;
+    }
+    loop.add(client);
+    return true;
+}
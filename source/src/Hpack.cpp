@@ -0,0 +1,479 @@
+#include <algorithm>
+#include <unordered_map>
+
+#include "Hpack.h"
+
+namespace Hpack {
+    static const Header STATIC_TABLE[] = {
+        {":authority", ""},
+        {":method", "GET"},
+        {":method", "POST"},
+        {":path", "/"},
+        {":path", "/index.html"},
+        {":scheme", "http"},
+        {":scheme", "https"},
+        {":status", "200"},
+        {":status", "204"},
+        {":status", "206"},
+        {":status", "304"},
+        {":status", "400"},
+        {":status", "404"},
+        {":status", "500"},
+        {"accept-charset", ""},
+        {"accept-encoding", "gzip, deflate"},
+        {"accept-language", ""},
+        {"accept-ranges", ""},
+        {"accept", ""},
+        {"access-control-allow-origin", ""},
+        {"age", ""},
+        {"allow", ""},
+        {"authorization", ""},
+        {"cache-control", ""},
+        {"content-disposition", ""},
+        {"content-encoding", ""},
+        {"content-language", ""},
+        {"content-length", ""},
+        {"content-location", ""},
+        {"content-range", ""},
+        {"content-type", ""},
+        {"cookie", ""},
+        {"date", ""},
+        {"etag", ""},
+        {"expect", ""},
+        {"expires", ""},
+        {"from", ""},
+        {"host", ""},
+        {"if-match", ""},
+        {"if-modified-since", ""},
+        {"if-none-match", ""},
+        {"if-range", ""},
+        {"if-unmodified-since", ""},
+        {"last-modified", ""},
+        {"link", ""},
+        {"location", ""},
+        {"max-forwards", ""},
+        {"proxy-authenticate", ""},
+        {"proxy-authorization", ""},
+        {"range", ""},
+        {"referer", ""},
+        {"refresh", ""},
+        {"retry-after", ""},
+        {"server", ""},
+        {"set-cookie", ""},
+        {"strict-transport-security", ""},
+        {"transfer-encoding", ""},
+        {"user-agent", ""},
+        {"vary", ""},
+        {"via", ""},
+        {"www-authenticate", ""},
+    };
+    static const size_t STATIC_TABLE_SIZE = sizeof(STATIC_TABLE) / sizeof(STATIC_TABLE[0]);
+
+    struct HuffmanCode {
+        uint32_t code;
+        uint8_t bits;
+    };
+
+    // RFC 7541 Appendix B, indexed by symbol (256 = EOS)
+    static const HuffmanCode HUFFMAN_CODES[257] = {
+        {0x1ff8, 13}, {0x7fffd8, 23}, {0xfffffe2, 28}, {0xfffffe3, 28},
+        {0xfffffe4, 28}, {0xfffffe5, 28}, {0xfffffe6, 28}, {0xfffffe7, 28},
+        {0xfffffe8, 28}, {0xffffea, 24}, {0x3ffffffc, 30}, {0xfffffe9, 28},
+        {0xfffffea, 28}, {0x3ffffffd, 30}, {0xfffffeb, 28}, {0xfffffec, 28},
+        {0xfffffed, 28}, {0xfffffee, 28}, {0xfffffef, 28}, {0xffffff0, 28},
+        {0xffffff1, 28}, {0xffffff2, 28}, {0x3ffffffe, 30}, {0xffffff3, 28},
+        {0xffffff4, 28}, {0xffffff5, 28}, {0xffffff6, 28}, {0xffffff7, 28},
+        {0xffffff8, 28}, {0xffffff9, 28}, {0xffffffa, 28}, {0xffffffb, 28},
+        {0x14, 6}, {0x3f8, 10}, {0x3f9, 10}, {0xffa, 12},
+        {0x1ff9, 13}, {0x15, 6}, {0xf8, 8}, {0x7fa, 11},
+        {0x3fa, 10}, {0x3fb, 10}, {0xf9, 8}, {0x7fb, 11},
+        {0xfa, 8}, {0x16, 6}, {0x17, 6}, {0x18, 6},
+        {0x0, 5}, {0x1, 5}, {0x2, 5}, {0x19, 6},
+        {0x1a, 6}, {0x1b, 6}, {0x1c, 6}, {0x1d, 6},
+        {0x1e, 6}, {0x1f, 6}, {0x5c, 7}, {0xfb, 8},
+        {0x7ffc, 15}, {0x20, 6}, {0xffb, 12}, {0x3fc, 10},
+        {0x1ffa, 13}, {0x21, 6}, {0x5d, 7}, {0x5e, 7},
+        {0x5f, 7}, {0x60, 7}, {0x61, 7}, {0x62, 7},
+        {0x63, 7}, {0x64, 7}, {0x65, 7}, {0x66, 7},
+        {0x67, 7}, {0x68, 7}, {0x69, 7}, {0x6a, 7},
+        {0x6b, 7}, {0x6c, 7}, {0x6d, 7}, {0x6e, 7},
+        {0x6f, 7}, {0x70, 7}, {0x71, 7}, {0x72, 7},
+        {0xfc, 8}, {0x73, 7}, {0xfd, 8}, {0x1ffb, 13},
+        {0x7fff0, 19}, {0x1ffc, 13}, {0x3ffc, 14}, {0x22, 6},
+        {0x7ffd, 15}, {0x3, 5}, {0x23, 6}, {0x4, 5},
+        {0x24, 6}, {0x5, 5}, {0x25, 6}, {0x26, 6},
+        {0x27, 6}, {0x6, 5}, {0x74, 7}, {0x75, 7},
+        {0x28, 6}, {0x29, 6}, {0x2a, 6}, {0x7, 5},
+        {0x2b, 6}, {0x76, 7}, {0x2c, 6}, {0x8, 5},
+        {0x9, 5}, {0x2d, 6}, {0x77, 7}, {0x78, 7},
+        {0x79, 7}, {0x7a, 7}, {0x7b, 7}, {0x7ffe, 15},
+        {0x7fc, 11}, {0x3ffd, 14}, {0x1ffd, 13}, {0xffffffc, 28},
+        {0xfffe6, 20}, {0x3fffd2, 22}, {0xfffe7, 20}, {0xfffe8, 20},
+        {0x3fffd3, 22}, {0x3fffd4, 22}, {0x3fffd5, 22}, {0x7fffd9, 23},
+        {0x3fffd6, 22}, {0x7fffda, 23}, {0x7fffdb, 23}, {0x7fffdc, 23},
+        {0x7fffdd, 23}, {0x7fffde, 23}, {0xffffeb, 24}, {0x7fffdf, 23},
+        {0xffffec, 24}, {0xffffed, 24}, {0x3fffd7, 22}, {0x7fffe0, 23},
+        {0xffffee, 24}, {0x7fffe1, 23}, {0x7fffe2, 23}, {0x7fffe3, 23},
+        {0x7fffe4, 23}, {0x1fffdc, 21}, {0x3fffd8, 22}, {0x7fffe5, 23},
+        {0x3fffd9, 22}, {0x7fffe6, 23}, {0x7fffe7, 23}, {0xffffef, 24},
+        {0x3fffda, 22}, {0x1fffdd, 21}, {0xfffe9, 20}, {0x3fffdb, 22},
+        {0x3fffdc, 22}, {0x7fffe8, 23}, {0x7fffe9, 23}, {0x1fffde, 21},
+        {0x7fffea, 23}, {0x3fffdd, 22}, {0x3fffde, 22}, {0xfffff0, 24},
+        {0x1fffdf, 21}, {0x3fffdf, 22}, {0x7fffeb, 23}, {0x7fffec, 23},
+        {0x1fffe0, 21}, {0x1fffe1, 21}, {0x3fffe0, 22}, {0x1fffe2, 21},
+        {0x7fffed, 23}, {0x3fffe1, 22}, {0x7fffee, 23}, {0x7fffef, 23},
+        {0xfffea, 20}, {0x3fffe2, 22}, {0x3fffe3, 22}, {0x3fffe4, 22},
+        {0x7ffff0, 23}, {0x3fffe5, 22}, {0x3fffe6, 22}, {0x7ffff1, 23},
+        {0x3ffffe0, 26}, {0x3ffffe1, 26}, {0xfffeb, 20}, {0x7fff1, 19},
+        {0x3fffe7, 22}, {0x7ffff2, 23}, {0x3fffe8, 22}, {0x1ffffec, 25},
+        {0x3ffffe2, 26}, {0x3ffffe3, 26}, {0x3ffffe4, 26}, {0x7ffffde, 27},
+        {0x7ffffdf, 27}, {0x3ffffe5, 26}, {0xfffff1, 24}, {0x1ffffed, 25},
+        {0x7fff2, 19}, {0x1fffe3, 21}, {0x3ffffe6, 26}, {0x7ffffe0, 27},
+        {0x7ffffe1, 27}, {0x3ffffe7, 26}, {0x7ffffe2, 27}, {0xfffff2, 24},
+        {0x1fffe4, 21}, {0x1fffe5, 21}, {0x3ffffe8, 26}, {0x3ffffe9, 26},
+        {0xffffffd, 28}, {0x7ffffe3, 27}, {0x7ffffe4, 27}, {0x7ffffe5, 27},
+        {0xfffec, 20}, {0xfffff3, 24}, {0xfffed, 20}, {0x1fffe6, 21},
+        {0x3fffe9, 22}, {0x1fffe7, 21}, {0x1fffe8, 21}, {0x7ffff3, 23},
+        {0x3fffea, 22}, {0x3fffeb, 22}, {0x1ffffee, 25}, {0x1ffffef, 25},
+        {0xfffff4, 24}, {0xfffff5, 24}, {0x3ffffea, 26}, {0x7ffff4, 23},
+        {0x3ffffeb, 26}, {0x7ffffe6, 27}, {0x3ffffec, 26}, {0x3ffffed, 26},
+        {0x7ffffe7, 27}, {0x7ffffe8, 27}, {0x7ffffe9, 27}, {0x7ffffea, 27},
+        {0x7ffffeb, 27}, {0xffffffe, 28}, {0x7ffffec, 27}, {0x7ffffed, 27},
+        {0x7ffffee, 27}, {0x7ffffef, 27}, {0x7fffff0, 27}, {0x3ffffee, 26},
+        {0x3fffffff, 30},
+    };
+
+    // The code is canonical: codes of one length are consecutive in symbol
+    // order, so decoding only needs the first code of every length
+    struct HuffmanDecodeTable {
+        uint32_t firstCode[31] = {};
+        uint16_t firstIndex[31] = {};
+        uint16_t count[31] = {};
+        uint16_t symbols[257] = {};
+
+        HuffmanDecodeTable() {
+            uint16_t sorted = 0;
+            for (int bits = 1; bits <= 30; bits++) {
+                firstIndex[bits] = sorted;
+                for (uint16_t symbol = 0; symbol < 257; symbol++) {
+                    if (HUFFMAN_CODES[symbol].bits != bits) continue;
+                    if (count[bits] == 0) firstCode[bits] = HUFFMAN_CODES[symbol].code;
+                    count[bits]++;
+                    symbols[sorted++] = symbol;
+                }
+            }
+        }
+    };
+
+    static const HuffmanDecodeTable& decodeTable() {
+        static const HuffmanDecodeTable table;
+        return table;
+    }
+
+    size_t huffmanEncodedLength(const std::string& data) {
+        uint64_t bits = 0;
+        for (unsigned char c : data) {
+            bits += HUFFMAN_CODES[c].bits;
+        }
+        return static_cast<size_t>((bits + 7) / 8);
+    }
+
+    std::string huffmanEncode(const std::string& data) {
+        std::string out;
+        out.reserve(huffmanEncodedLength(data));
+
+        uint64_t accumulator = 0;
+        int pending = 0;
+        for (unsigned char c : data) {
+            const HuffmanCode& code = HUFFMAN_CODES[c];
+            accumulator = (accumulator << code.bits) | code.code;
+            pending += code.bits;
+            while (pending >= 8) {
+                pending -= 8;
+                out += static_cast<char>((accumulator >> pending) & 0xFF);
+            }
+        }
+
+        if (pending > 0) {
+            // Pad with the most significant bits of EOS (all ones)
+            accumulator = (accumulator << (8 - pending)) | ((1u << (8 - pending)) - 1);
+            out += static_cast<char>(accumulator & 0xFF);
+        }
+        return out;
+    }
+
+    std::string huffmanDecode(const uint8_t* data, size_t length) {
+        const HuffmanDecodeTable& table = decodeTable();
+
+        std::string out;
+        out.reserve(length * 8 / 5);
+
+        uint32_t code = 0;
+        int bits = 0;
+        for (size_t i = 0; i < length; i++) {
+            for (int bit = 7; bit >= 0; bit--) {
+                code = (code << 1) | ((data[i] >> bit) & 1);
+                bits++;
+
+                if (table.count[bits] != 0 && code >= table.firstCode[bits] &&
+                    code - table.firstCode[bits] < table.count[bits]) {
+                    uint16_t symbol = table.symbols[table.firstIndex[bits] + (code - table.firstCode[bits])];
+                    if (symbol == 256) {
+                        throw Error("EOS symbol in Huffman string");
+                    }
+                    out += static_cast<char>(symbol);
+                    code = 0;
+                    bits = 0;
+                } else if (bits >= 30) {
+                    throw Error("Invalid Huffman code");
+                }
+            }
+        }
+
+        // Up to 7 bits of padding, which must be a prefix of EOS
+        if (bits > 7 || code != (1u << bits) - 1) {
+            throw Error("Invalid Huffman padding");
+        }
+        return out;
+    }
+
+    void encodeInteger(uint64_t value, int prefixBits, uint8_t flags, std::string& out) {
+        uint64_t max = (1u << prefixBits) - 1;
+        if (value < max) {
+            out += static_cast<char>(flags | value);
+            return;
+        }
+
+        out += static_cast<char>(flags | max);
+        value -= max;
+        while (value >= 0x80) {
+            out += static_cast<char>((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        out += static_cast<char>(value);
+    }
+
+    void encodeString(const std::string& value, std::string& out) {
+        size_t huffmanLength = huffmanEncodedLength(value);
+        if (huffmanLength < value.length()) {
+            encodeInteger(huffmanLength, 7, 0x80, out);
+            out += huffmanEncode(value);
+        } else {
+            encodeInteger(value.length(), 7, 0x00, out);
+            out += value;
+        }
+    }
+
+    static uint64_t decodeInteger(const uint8_t*& p, const uint8_t* end, int prefixBits) {
+        if (p >= end) throw Error("Truncated integer");
+
+        uint64_t max = (1u << prefixBits) - 1;
+        uint64_t value = *p++ & max;
+        if (value < max) return value;
+
+        for (int shift = 0; ; shift += 7) {
+            if (p >= end) throw Error("Truncated integer");
+            if (shift > 28) throw Error("Integer overflow");
+
+            uint8_t byte = *p++;
+            value += static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) break;
+        }
+        return value;
+    }
+
+    static std::string decodeString(const uint8_t*& p, const uint8_t* end) {
+        if (p >= end) throw Error("Truncated string");
+
+        bool huffman = (*p & 0x80) != 0;
+        uint64_t length = decodeInteger(p, end, 7);
+        if (length > static_cast<uint64_t>(end - p)) {
+            throw Error("Truncated string");
+        }
+
+        std::string value = huffman ? huffmanDecode(p, static_cast<size_t>(length))
+                                    : std::string(reinterpret_cast<const char*>(p), static_cast<size_t>(length));
+        p += length;
+        return value;
+    }
+
+    static void skipString(const uint8_t*& p, const uint8_t* end) {
+        if (p >= end) throw Error("Truncated string");
+
+        uint64_t length = decodeInteger(p, end, 7);
+        if (length > static_cast<uint64_t>(end - p)) {
+            throw Error("Truncated string");
+        }
+        p += length;
+    }
+
+    void DynamicTable::add(const std::string& name, const std::string& value) {
+        size_t entrySize = name.length() + value.length() + 32;
+        if (entrySize > maxSize) {
+            // An entry larger than the table empties it (RFC 7541 4.4)
+            entries.clear();
+            size = 0;
+            return;
+        }
+
+        entries.emplace_front(name, value);
+        size += entrySize;
+        evict();
+    }
+
+    void DynamicTable::setMaxSize(size_t newSize) {
+        maxSize = newSize;
+        evict();
+    }
+
+    const Header* DynamicTable::get(size_t index) const {
+        return index < entries.size() ? &entries[index] : nullptr;
+    }
+
+    void DynamicTable::evict() {
+        while (size > maxSize && !entries.empty()) {
+            size -= entries.back().first.length() + entries.back().second.length() + 32;
+            entries.pop_back();
+        }
+    }
+
+    Decoder::Decoder(size_t maxTableSize) : table(maxTableSize), settingsMaxSize(maxTableSize) {}
+
+    const Header& Decoder::lookup(uint64_t index) const {
+        if (index == 0) throw Error("Invalid header index 0");
+        if (index <= STATIC_TABLE_SIZE) return STATIC_TABLE[index - 1];
+
+        const Header* entry = table.get(static_cast<size_t>(index - STATIC_TABLE_SIZE - 1));
+        if (!entry) throw Error("Header index out of range");
+        return *entry;
+    }
+
+    bool Decoder::decode(const uint8_t* data, size_t length, HeaderList& headers, size_t maxListSize) {
+        headers.clear();
+        const uint8_t* p = data;
+        const uint8_t* end = data + length;
+        bool fieldSeen = false;
+        bool tooLarge = false;
+        size_t listSize = 0;
+
+        auto collect = [&](Header header) {
+            listSize += header.first.size() + header.second.size() + 32;
+            if (listSize > maxListSize) {
+                tooLarge = true;
+                headers.clear();
+                headers.shrink_to_fit();
+            } else {
+                headers.push_back(std::move(header));
+            }
+        };
+
+        while (p < end) {
+            uint8_t first = *p;
+
+            if (first & 0x80) {
+                const Header& header = lookup(decodeInteger(p, end, 7));
+                if (!tooLarge) collect(header);
+            } else if ((first & 0xE0) == 0x20) {
+                // Table size updates may only start a block
+                if (fieldSeen) throw Error("Table size update after header field");
+                uint64_t size = decodeInteger(p, end, 5);
+                if (size > settingsMaxSize) throw Error("Table size update above limit");
+                table.setMaxSize(static_cast<size_t>(size));
+                continue;
+            } else {
+                bool indexed = (first & 0xC0) == 0x40;
+                uint64_t nameIndex = decodeInteger(p, end, indexed ? 6 : 4);
+
+                if (tooLarge && !indexed) {
+                    // Nothing to keep: skip without Huffman decoding
+                    if (nameIndex != 0) {
+                        lookup(nameIndex);
+                    } else {
+                        skipString(p, end);
+                    }
+                    skipString(p, end);
+                } else {
+                    std::string name = nameIndex != 0 ? lookup(nameIndex).first : decodeString(p, end);
+                    std::string value = decodeString(p, end);
+                    if (indexed) table.add(name, value);
+                    if (!tooLarge) collect(Header(std::move(name), std::move(value)));
+                }
+            }
+            fieldSeen = true;
+        }
+
+        return !tooLarge;
+    }
+
+    Encoder::Encoder(size_t maxTableSize) : table(maxTableSize), preferredSize(maxTableSize) {}
+
+    void Encoder::setMaxTableSize(size_t size) {
+        size_t newSize = std::min(size, preferredSize);
+        if (newSize != table.getMaxSize()) {
+            table.setMaxSize(newSize);
+            sizeUpdatePending = true;
+        }
+    }
+
+    void Encoder::encode(const HeaderList& headers, std::string& out) {
+        if (sizeUpdatePending) {
+            encodeInteger(table.getMaxSize(), 5, 0x20, out);
+            sizeUpdatePending = false;
+        }
+
+        for (const auto& [name, value] : headers) {
+            encodeHeader(name, value, out);
+        }
+    }
+
+    void Encoder::encodeHeader(const std::string& name, const std::string& value, std::string& out) {
+        static const std::unordered_map<std::string, size_t> staticNames = [] {
+            std::unordered_map<std::string, size_t> names;
+            for (size_t i = STATIC_TABLE_SIZE; i > 0; i--) {
+                names[STATIC_TABLE[i - 1].first] = i;
+            }
+            return names;
+        }();
+
+        size_t nameIndex = 0;
+        auto staticName = staticNames.find(name);
+        if (staticName != staticNames.end()) {
+            nameIndex = staticName->second;
+            for (size_t i = nameIndex; i <= STATIC_TABLE_SIZE && STATIC_TABLE[i - 1].first == name; i++) {
+                if (STATIC_TABLE[i - 1].second == value) {
+                    encodeInteger(i, 7, 0x80, out);
+                    return;
+                }
+            }
+        }
+
+        for (size_t i = 0; i < table.count(); i++) {
+            const Header* entry = table.get(i);
+            if (entry->first != name) continue;
+            if (entry->second == value) {
+                encodeInteger(STATIC_TABLE_SIZE + 1 + i, 7, 0x80, out);
+                return;
+            }
+            if (nameIndex == 0) nameIndex = STATIC_TABLE_SIZE + 1 + i;
+        }
+
+        // Values that change on every response would only churn the table
+        static const char* const unindexed[] = {
+            "content-length", "date", "etag", "last-modified", "age", "expires", "content-range"
+        };
+        bool sensitive = name == "set-cookie" || name == "authorization" || name == "cookie";
+        bool index = !sensitive && value.length() <= table.getMaxSize() / 4 &&
+            std::none_of(std::begin(unindexed), std::end(unindexed),
+                         [&name](const char* field) { return name == field; });
+
+        if (index) {
+            encodeInteger(nameIndex, 6, 0x40, out);
+        } else {
+            encodeInteger(nameIndex, 4, sensitive ? 0x10 : 0x00, out);
+        }
+        if (nameIndex == 0) encodeString(name, out);
+        encodeString(value, out);
+
+        if (index) table.add(name, value);
+    }
+}
@@ -0,0 +1,923 @@
+#include <chrono>
+#include <thread>
+#include <cctype>
+#include <iostream>
+#include <algorithm>
+#include <system_error>
+
+#include "Utils.h"
+#include "Socket.h"
+#include "HttpServer.h"
+#include "Http2.h"
+
+static const char CLIENT_PREFACE[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+static const size_t CLIENT_PREFACE_LENGTH = sizeof(CLIENT_PREFACE) - 1;
+
+static const uint8_t FLAG_END_STREAM = 0x1;
+static const uint8_t FLAG_ACK = 0x1;
+static const uint8_t FLAG_END_HEADERS = 0x4;
+static const uint8_t FLAG_PADDED = 0x8;
+static const uint8_t FLAG_PRIORITY = 0x20;
+
+static const uint16_t SETTINGS_HEADER_TABLE_SIZE = 0x1;
+static const uint16_t SETTINGS_ENABLE_PUSH = 0x2;
+static const uint16_t SETTINGS_MAX_CONCURRENT_STREAMS = 0x3;
+static const uint16_t SETTINGS_INITIAL_WINDOW_SIZE = 0x4;
+static const uint16_t SETTINGS_MAX_FRAME_SIZE = 0x5;
+static const uint16_t SETTINGS_MAX_HEADER_LIST_SIZE = 0x6;
+
+static const int64_t MAX_WINDOW = 0x7fffffff;
+static const uint32_t DEFAULT_WINDOW = 65535;
+// Largest frame we accept; SETTINGS_MAX_FRAME_SIZE is never raised
+static const uint32_t MAX_FRAME_SIZE = 16384;
+
+static uint32_t readUint32(const char* p) {
+    const unsigned char* b = reinterpret_cast<const unsigned char*>(p);
+    return (uint32_t(b[0]) << 24) | (uint32_t(b[1]) << 16) | (uint32_t(b[2]) << 8) | b[3];
+}
+
+static void appendUint32(std::string& out, uint32_t value) {
+    out += static_cast<char>((value >> 24) & 0xFF);
+    out += static_cast<char>((value >> 16) & 0xFF);
+    out += static_cast<char>((value >> 8) & 0xFF);
+    out += static_cast<char>(value & 0xFF);
+}
+
+static void appendSetting(std::string& out, uint16_t id, uint32_t value) {
+    out += static_cast<char>(id >> 8);
+    out += static_cast<char>(id & 0xFF);
+    appendUint32(out, value);
+}
+
+// Removes the pad length, priority fields and padding of DATA and HEADERS
+// payloads; false if the padding does not fit
+static bool stripPadding(std::string& payload, uint8_t flags, size_t prefix) {
+    size_t start = 0;
+    size_t padLength = 0;
+    if (flags & FLAG_PADDED) {
+        if (payload.empty()) return false;
+        padLength = static_cast<unsigned char>(payload[0]);
+        start = 1;
+    }
+    start += prefix;
+
+    if (start + padLength > payload.size()) return false;
+    payload = payload.substr(start, payload.size() - start - padLength);
+    return true;
+}
+
+// Routes ResponseWriter output of one stream into HEADERS and DATA frames
+class Http2Connection::StreamSink : public ResponseSink {
+public:
+    StreamSink(Http2Connection& connection, Stream& stream) : connection(connection), stream(stream) {}
+
+    bool sendHeaders(HttpResponse& res, bool endStream) override {
+        return connection.sendHeaders(stream, res, true, endStream);
+    }
+
+    bool sendData(const char* data, size_t length, bool endStream) override {
+        return connection.sendData(stream, data, length, endStream);
+    }
+
+private:
+    Http2Connection& connection;
+    Stream& stream;
+};
+
+Http2Connection::Http2Connection(socket_t fd, Dispatcher dispatcher, const std::atomic<bool>& running)
+    : fd(fd), dispatcher(std::move(dispatcher)), running(running),
+      recvWindow(Config::HTTP2_CONNECTION_WINDOW_SIZE), lastActivity(time(nullptr)) {
+    Socket::setSendTimeout(fd, Config::SOCKET_TIMEOUT);
+}
+
+Http2Connection::~Http2Connection() {
+    // Stream threads use this object until they finish
+    std::unique_lock<std::mutex> lock(mutex);
+    closing = true;
+    windowChanged.notify_all();
+    streamsFinished.wait(lock, [this] { return runningStreams == 0; });
+}
+
+bool Http2Connection::isPreface(const HttpRequest& req) {
+    return req.method == "PRI" && req.path == "*" && req.version == "HTTP/2.0";
+}
+
+bool Http2Connection::isUpgradeRequest(const HttpRequest& req) {
+    return req.version == "HTTP/1.1" &&
+           Utils::hasToken(req.headers.get("Upgrade", ""), "h2c") &&
+           Utils::hasToken(req.headers.get("Connection", ""), "upgrade") &&
+           req.headers.has("HTTP2-Settings");
+}
+
+void Http2Connection::serve(const HttpRequest& preface) {
+    // The HTTP/1.1 parser stops at the blank line after "PRI * HTTP/2.0";
+    // the rest of the preface and any frames after it ended up in the body
+    input = preface.body;
+    if (!ensureInput(6) || input.compare(0, 6, "SM\r\n\r\n") != 0) {
+        return;
+    }
+    inputOffset = 6;
+
+    sendSettings();
+    run();
+}
+
+void Http2Connection::serveUpgrade(const HttpRequest& req) {
+    std::string settings;
+    if (!Utils::base64Decode(req.headers.get("HTTP2-Settings", ""), settings)) {
+        return;
+    }
+
+    try {
+        applySettings(settings);
+    } catch (const ConnectionError& e) {
+        std::cerr << "Invalid HTTP2-Settings: " << e.what() << std::endl;
+        return;
+    }
+
+    static const char switching[] = "HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n";
+    if (!Socket::sendAll(fd, switching, sizeof(switching) - 1)) {
+        return;
+    }
+    sendSettings();
+
+    // The upgrade request becomes stream 1, already half-closed by the client
+    auto stream = std::make_shared<Stream>(1, peerInitialWindow, Config::HTTP2_INITIAL_WINDOW_SIZE);
+    stream->endStreamReceived = true;
+    lastStreamId = 1;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        streams[1] = stream;
+    }
+
+    auto ctx = std::make_unique<HttpContext>(fd);
+    ctx->req = req;
+    ctx->req.version = "HTTP/2.0";
+    startStream(stream, std::move(ctx));
+
+    if (!ensureInput(CLIENT_PREFACE_LENGTH) ||
+        input.compare(inputOffset, CLIENT_PREFACE_LENGTH, CLIENT_PREFACE) != 0) {
+        sendGoaway(ErrorCode::PROTOCOL);
+        return;
+    }
+    inputOffset += CLIENT_PREFACE_LENGTH;
+
+    run();
+}
+
+void Http2Connection::run() {
+    Frame frame;
+    try {
+        while (readFrame(frame)) {
+            handleFrame(frame);
+
+            if (goawayReceived) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (streams.empty()) break;
+            }
+        }
+        sendGoaway(ErrorCode::NONE);
+    } catch (const ConnectionError& e) {
+        std::cerr << "HTTP/2 connection error: " << e.what() << std::endl;
+        sendGoaway(e.code);
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    closing = true;
+    windowChanged.notify_all();
+    streamsFinished.wait(lock, [this] { return runningStreams == 0; });
+}
+
+bool Http2Connection::readMore() {
+    char buffer[16384];
+
+    while (running) {
+        fd_set read_fds;
+        FD_ZERO(&read_fds);
+        FD_SET(fd, &read_fds);
+
+        struct timeval timeout;
+        timeout.tv_sec = 1;
+        timeout.tv_usec = 0;
+
+        int ready = select(fd + 1, &read_fds, NULL, NULL, &timeout);
+        if (ready < 0) {
+#ifdef _WIN32
+            if (WSAGetLastError() == WSAEINTR) continue;
+#else
+            if (errno == EINTR) continue;
+#endif
+            return false;
+        }
+
+        if (ready == 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (streams.empty() && time(nullptr) - lastActivity > Config::HTTP2_IDLE_TIMEOUT) {
+                return false;
+            }
+            continue;
+        }
+
+        int n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n <= 0) {
+#ifdef _WIN32
+            if (n < 0 && WSAGetLastError() == WSAEINTR) continue;
+#else
+            if (n < 0 && errno == EINTR) continue;
+#endif
+            return false;
+        }
+
+        if (inputOffset == input.size()) {
+            input.clear();
+            inputOffset = 0;
+        } else if (inputOffset > 65536) {
+            input.erase(0, inputOffset);
+            inputOffset = 0;
+        }
+
+        input.append(buffer, n);
+        lastActivity = time(nullptr);
+        return true;
+    }
+
+    return false;
+}
+
+bool Http2Connection::ensureInput(size_t bytes) {
+    while (input.size() - inputOffset < bytes) {
+        if (!readMore()) return false;
+    }
+    return true;
+}
+
+bool Http2Connection::readFrame(Frame& frame) {
+    if (!ensureInput(9)) return false;
+
+    const unsigned char* header = reinterpret_cast<const unsigned char*>(input.data() + inputOffset);
+    uint32_t length = (uint32_t(header[0]) << 16) | (uint32_t(header[1]) << 8) | header[2];
+    frame.type = header[3];
+    frame.flags = header[4];
+    frame.streamId = readUint32(input.data() + inputOffset + 5) & 0x7fffffff;
+
+    if (length > MAX_FRAME_SIZE) {
+        throw ConnectionError(ErrorCode::FRAME_SIZE, "Frame exceeds SETTINGS_MAX_FRAME_SIZE");
+    }
+    if (!ensureInput(9 + length)) return false;
+
+    frame.payload.assign(input, inputOffset + 9, length);
+    inputOffset += 9 + length;
+    return true;
+}
+
+void Http2Connection::handleFrame(Frame& frame) {
+    // A header block must not be interleaved with any other frame
+    if (continuationStream != 0 &&
+        (frame.type != CONTINUATION || frame.streamId != continuationStream)) {
+        throw ConnectionError(ErrorCode::PROTOCOL, "Expected CONTINUATION");
+    }
+
+    switch (frame.type) {
+        case DATA:
+            handleData(frame);
+            break;
+
+        case HEADERS:
+            handleHeaders(frame);
+            break;
+
+        case CONTINUATION:
+            if (continuationStream == 0) {
+                throw ConnectionError(ErrorCode::PROTOCOL, "Unexpected CONTINUATION");
+            }
+            headerBlock += frame.payload;
+            if (headerBlock.size() > Config::HTTP2_MAX_HEADER_LIST_SIZE * 2) {
+                throw ConnectionError(ErrorCode::ENHANCE_YOUR_CALM, "Header block too large");
+            }
+            if (frame.flags & FLAG_END_HEADERS) {
+                uint32_t streamId = continuationStream;
+                std::string block;
+                block.swap(headerBlock);
+                continuationStream = 0;
+                processHeaderBlock(streamId, block, headerEndStream);
+            }
+            break;
+
+        case PRIORITY:
+            if (frame.streamId == 0) {
+                throw ConnectionError(ErrorCode::PROTOCOL, "PRIORITY on stream 0");
+            }
+            if (frame.payload.size() != 5) {
+                resetStream(frame.streamId, ErrorCode::FRAME_SIZE);
+            }
+            break;
+
+        case RST_STREAM:
+            handleRstStream(frame);
+            break;
+
+        case SETTINGS:
+            handleSettings(frame);
+            break;
+
+        case PUSH_PROMISE:
+            throw ConnectionError(ErrorCode::PROTOCOL, "Clients cannot push");
+
+        case PING:
+            if (frame.streamId != 0) {
+                throw ConnectionError(ErrorCode::PROTOCOL, "PING on a stream");
+            }
+            if (frame.payload.size() != 8) {
+                throw ConnectionError(ErrorCode::FRAME_SIZE, "PING must carry 8 bytes");
+            }
+            if (!(frame.flags & FLAG_ACK)) {
+                writeFrame(PING, FLAG_ACK, 0, frame.payload.data(), frame.payload.size());
+            }
+            break;
+
+        case GOAWAY:
+            if (frame.streamId != 0) {
+                throw ConnectionError(ErrorCode::PROTOCOL, "GOAWAY on a stream");
+            }
+            goawayReceived = true;
+            break;
+
+        case WINDOW_UPDATE:
+            handleWindowUpdate(frame);
+            break;
+
+        default:
+            // Unknown frame types are ignored
+            break;
+    }
+}
+
+void Http2Connection::handleHeaders(Frame& frame) {
+    if (frame.streamId == 0) {
+        throw ConnectionError(ErrorCode::PROTOCOL, "HEADERS on stream 0");
+    }
+    if (!stripPadding(frame.payload, frame.flags, (frame.flags & FLAG_PRIORITY) ? 5 : 0)) {
+        throw ConnectionError(ErrorCode::PROTOCOL, "Invalid HEADERS padding");
+    }
+
+    bool endStream = (frame.flags & FLAG_END_STREAM) != 0;
+    if (frame.flags & FLAG_END_HEADERS) {
+        processHeaderBlock(frame.streamId, frame.payload, endStream);
+    } else {
+        continuationStream = frame.streamId;
+        headerBlock = std::move(frame.payload);
+        headerEndStream = endStream;
+    }
+}
+
+void Http2Connection::processHeaderBlock(uint32_t streamId, const std::string& block, bool endStream) {
+    // Every block is decoded, even for refused streams, to keep the HPACK
+    // tables of both sides in step
+    Hpack::HeaderList headers;
+    bool withinLimit;
+    try {
+        withinLimit = decoder.decode(reinterpret_cast<const uint8_t*>(block.data()), block.size(), headers,
+                                     Config::HTTP2_MAX_HEADER_LIST_SIZE);
+    } catch (const Hpack::Error& e) {
+        throw ConnectionError(ErrorCode::COMPRESSION, e.what());
+    }
+
+    std::shared_ptr<Stream> stream;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = streams.find(streamId);
+        if (it != streams.end()) stream = it->second;
+    }
+
+    if (stream) {
+        // Trailers: they end the request and are otherwise ignored
+        if (stream->endStreamReceived) {
+            resetStream(streamId, ErrorCode::STREAM_CLOSED);
+        } else if (!endStream) {
+            resetStream(streamId, ErrorCode::PROTOCOL);
+        } else {
+            stream->endStreamReceived = true;
+            startStream(stream, buildContext(*stream));
+        }
+        return;
+    }
+
+    // Frames for streams we already closed or reset are ignored
+    if (streamId <= lastStreamId) return;
+    if ((streamId & 1) == 0) {
+        throw ConnectionError(ErrorCode::PROTOCOL, "Client opened an even stream");
+    }
+    lastStreamId = streamId;
+
+    if (goawayReceived) return;
+
+    int64_t initialWindow;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (streams.size() >= Config::HTTP2_MAX_CONCURRENT_STREAMS) {
+            initialWindow = -1;
+        } else {
+            initialWindow = peerInitialWindow;
+        }
+    }
+    if (initialWindow < 0) {
+        resetStream(streamId, ErrorCode::REFUSED_STREAM);
+        return;
+    }
+
+    stream = std::make_shared<Stream>(streamId, initialWindow, Config::HTTP2_INITIAL_WINDOW_SIZE);
+    stream->headers = std::move(headers);
+    stream->endStreamReceived = endStream;
+    if (!withinLimit) {
+        stream->rejectStatus = static_cast<int>(HttpStatus::REQUEST_HEADER_FIELDS_TOO_LARGE);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        streams[streamId] = stream;
+    }
+
+    if (endStream) {
+        startStream(stream, buildContext(*stream));
+    }
+}
+
+void Http2Connection::handleData(Frame& frame) {
+    if (frame.streamId == 0) {
+        throw ConnectionError(ErrorCode::PROTOCOL, "DATA on stream 0");
+    }
+
+    // Flow control counts the whole payload, padding included
+    int64_t flowLength = static_cast<int64_t>(frame.payload.size());
+    recvWindow -= flowLength;
+    if (recvWindow < 0) {
+        throw ConnectionError(ErrorCode::FLOW_CONTROL, "Connection receive window exceeded");
+    }
+    if (!stripPadding(frame.payload, frame.flags, 0)) {
+        throw ConnectionError(ErrorCode::PROTOCOL, "Invalid DATA padding");
+    }
+
+    if (recvWindow < static_cast<int64_t>(Config::HTTP2_CONNECTION_WINDOW_SIZE) / 2) {
+        std::string increment;
+        appendUint32(increment, static_cast<uint32_t>(Config::HTTP2_CONNECTION_WINDOW_SIZE - recvWindow));
+        recvWindow = Config::HTTP2_CONNECTION_WINDOW_SIZE;
+        writeFrame(WINDOW_UPDATE, 0, 0, increment.data(), increment.size());
+    }
+
+    std::shared_ptr<Stream> stream;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = streams.find(frame.streamId);
+        if (it != streams.end()) stream = it->second;
+    }
+
+    if (!stream) {
+        if (frame.streamId > lastStreamId) {
+            throw ConnectionError(ErrorCode::PROTOCOL, "DATA on idle stream");
+        }
+        return;
+    }
+    if (stream->endStreamReceived) {
+        resetStream(frame.streamId, ErrorCode::STREAM_CLOSED);
+        return;
+    }
+
+    stream->recvWindow -= flowLength;
+    if (stream->recvWindow < 0) {
+        resetStream(frame.streamId, ErrorCode::FLOW_CONTROL);
+        return;
+    }
+
+    if (stream->rejectStatus == 0) {
+        if (stream->body.size() + frame.payload.size() > Config::MAX_REQUEST_SIZE) {
+            // Keep reading (and discarding) the body, then answer 413
+            stream->rejectStatus = static_cast<int>(HttpStatus::PAYLOAD_TOO_LARGE);
+            std::string().swap(stream->body);
+        } else {
+            stream->body += frame.payload;
+        }
+    }
+
+    if (frame.flags & FLAG_END_STREAM) {
+        stream->endStreamReceived = true;
+        startStream(stream, buildContext(*stream));
+    } else if (stream->recvWindow < static_cast<int64_t>(Config::HTTP2_INITIAL_WINDOW_SIZE) / 2) {
+        std::string increment;
+        appendUint32(increment, static_cast<uint32_t>(Config::HTTP2_INITIAL_WINDOW_SIZE - stream->recvWindow));
+        stream->recvWindow = Config::HTTP2_INITIAL_WINDOW_SIZE;
+        writeFrame(WINDOW_UPDATE, 0, frame.streamId, increment.data(), increment.size());
+    }
+}
+
+void Http2Connection::handleSettings(const Frame& frame) {
+    if (frame.streamId != 0) {
+        throw ConnectionError(ErrorCode::PROTOCOL, "SETTINGS on a stream");
+    }
+    if (frame.flags & FLAG_ACK) {
+        if (!frame.payload.empty()) {
+            throw ConnectionError(ErrorCode::FRAME_SIZE, "SETTINGS ack with payload");
+        }
+        return;
+    }
+
+    applySettings(frame.payload);
+    writeFrame(SETTINGS, FLAG_ACK, 0, nullptr, 0);
+}
+
+void Http2Connection::applySettings(const std::string& payload) {
+    if (payload.size() % 6 != 0) {
+        throw ConnectionError(ErrorCode::FRAME_SIZE, "SETTINGS length not a multiple of 6");
+    }
+
+    for (size_t i = 0; i < payload.size(); i += 6) {
+        uint16_t id = static_cast<uint16_t>((static_cast<unsigned char>(payload[i]) << 8) |
+                                            static_cast<unsigned char>(payload[i + 1]));
+        uint32_t value = readUint32(payload.data() + i + 2);
+
+        switch (id) {
+            case SETTINGS_HEADER_TABLE_SIZE: {
+                std::lock_guard<std::mutex> lock(writeMutex);
+                encoder.setMaxTableSize(value);
+                break;
+            }
+
+            case SETTINGS_ENABLE_PUSH:
+                if (value > 1) {
+                    throw ConnectionError(ErrorCode::PROTOCOL, "Invalid SETTINGS_ENABLE_PUSH");
+                }
+                break;
+
+            case SETTINGS_INITIAL_WINDOW_SIZE: {
+                if (value > MAX_WINDOW) {
+                    throw ConnectionError(ErrorCode::FLOW_CONTROL, "Invalid SETTINGS_INITIAL_WINDOW_SIZE");
+                }
+
+                // Applies retroactively to every open stream
+                std::lock_guard<std::mutex> lock(mutex);
+                int64_t delta = static_cast<int64_t>(value) - peerInitialWindow;
+                peerInitialWindow = value;
+                for (auto& [streamId, stream] : streams) {
+                    stream->sendWindow += delta;
+                    if (stream->sendWindow > MAX_WINDOW) {
+                        throw ConnectionError(ErrorCode::FLOW_CONTROL, "Stream window overflow");
+                    }
+                }
+                windowChanged.notify_all();
+                break;
+            }
+
+            case SETTINGS_MAX_FRAME_SIZE:
+                if (value < 16384 || value > 16777215) {
+                    throw ConnectionError(ErrorCode::PROTOCOL, "Invalid SETTINGS_MAX_FRAME_SIZE");
+                }
+                peerMaxFrameSize = value;
+                break;
+
+            default:
+                // SETTINGS_MAX_CONCURRENT_STREAMS only limits pushes, which we
+                // never send; unknown settings are ignored
+                break;
+        }
+    }
+}
+
+void Http2Connection::handleWindowUpdate(const Frame& frame) {
+    if (frame.payload.size() != 4) {
+        throw ConnectionError(ErrorCode::FRAME_SIZE, "WINDOW_UPDATE must carry 4 bytes");
+    }
+    uint32_t increment = readUint32(frame.payload.data()) & 0x7fffffff;
+
+    if (frame.streamId == 0) {
+        if (increment == 0) {
+            throw ConnectionError(ErrorCode::PROTOCOL, "Zero WINDOW_UPDATE increment");
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        sendWindow += increment;
+        if (sendWindow > MAX_WINDOW) {
+            throw ConnectionError(ErrorCode::FLOW_CONTROL, "Connection window overflow");
+        }
+        windowChanged.notify_all();
+        return;
+    }
+
+    if (increment == 0) {
+        resetStream(frame.streamId, ErrorCode::PROTOCOL);
+        return;
+    }
+
+    bool overflow = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = streams.find(frame.streamId);
+        if (it != streams.end()) {
+            it->second->sendWindow += increment;
+            overflow = it->second->sendWindow > MAX_WINDOW;
+            windowChanged.notify_all();
+        }
+    }
+    if (overflow) {
+        resetStream(frame.streamId, ErrorCode::FLOW_CONTROL);
+    }
+}
+
+void Http2Connection::handleRstStream(const Frame& frame) {
+    if (frame.streamId == 0) {
+        throw ConnectionError(ErrorCode::PROTOCOL, "RST_STREAM on stream 0");
+    }
+    if (frame.payload.size() != 4) {
+        throw ConnectionError(ErrorCode::FRAME_SIZE, "RST_STREAM must carry 4 bytes");
+    }
+    if (frame.streamId > lastStreamId) {
+        throw ConnectionError(ErrorCode::PROTOCOL, "RST_STREAM on idle stream");
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = streams.find(frame.streamId);
+    if (it != streams.end()) {
+        it->second->reset = true;
+        streams.erase(it);
+        windowChanged.notify_all();
+    }
+}
+
+std::unique_ptr<HttpContext> Http2Connection::buildContext(Stream& stream) {
+    auto ctx = std::make_unique<HttpContext>(fd);
+    HttpRequest& req = ctx->req;
+    req.version = "HTTP/2.0";
+
+    std::string authority;
+    std::string cookies;
+    bool regularSeen = false;
+    bool valid = true;
+
+    for (const auto& [name, value] : stream.headers) {
+        if (!name.empty() && name[0] == ':') {
+            // Pseudo-headers must all come before regular fields
+            if (regularSeen) valid = false;
+
+            if (name == ":method") req.method = value;
+            else if (name == ":path") req.path = value;
+            else if (name == ":authority") authority = value;
+            else if (name != ":scheme") valid = false;
+            continue;
+        }
+        regularSeen = true;
+
+        if (std::any_of(name.begin(), name.end(), [](unsigned char c) { return std::isupper(c); }) ||
+            name == "connection" || name == "keep-alive" || name == "transfer-encoding") {
+            valid = false;
+        } else if (name == "cookie") {
+            // Cookies may arrive split into several fields
+            if (!cookies.empty()) cookies += "; ";
+            cookies += value;
+        } else if (req.headers.has(name)) {
+            req.headers[name] += ", " + value;
+        } else {
+            req.headers[name] = value;
+        }
+    }
+
+    if (req.method.empty() || req.path.empty()) valid = false;
+    req.methodType = parseHttpMethod(req.method);
+    if (!cookies.empty()) req.headers["Cookie"] = cookies;
+    if (!authority.empty() && !req.headers.has("Host")) req.headers["Host"] = authority;
+
+    req.body = std::move(stream.body);
+    stream.headers.clear();
+
+    if (!valid && stream.rejectStatus == 0) {
+        stream.rejectStatus = static_cast<int>(HttpStatus::BAD_REQUEST);
+    }
+    if (stream.rejectStatus != 0) return ctx;
+
+    req.parseQueryParams();
+    req.parseFormData();
+    req.parseCookies();
+    req.parseJsonData();
+    return ctx;
+}
+
+void Http2Connection::startStream(const std::shared_ptr<Stream>& stream, std::unique_ptr<HttpContext> ctx) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        runningStreams++;
+    }
+
+    try {
+        std::thread([this, stream, ctx = std::move(ctx)]() {
+            runStream(stream, *ctx);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            runningStreams--;
+            streamsFinished.notify_all();
+        }).detach();
+    } catch (const std::system_error& e) {
+        std::cerr << "Failed to start HTTP/2 stream: " << e.what() << std::endl;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            runningStreams--;
+        }
+        resetStream(stream->id, ErrorCode::REFUSED_STREAM);
+    }
+}
+
+void Http2Connection::runStream(const std::shared_ptr<Stream>& stream, HttpContext& ctx) {
+    StreamSink sink(*this, *stream);
+    ctx.res.setSink(&sink);
+
+    try {
+        if (stream->rejectStatus != 0) {
+            ctx.res.setStatus(stream->rejectStatus);
+            ctx.res.setBody(ctx.res.getStatusText() + "\n");
+            sendResponse(*stream, ctx.res);
+        } else {
+            dispatcher(ctx);
+
+            if (ctx.res.isStreamed()) {
+                // A handler that failed mid-body leaves the stream open
+                if (!ctx.res.isStreamComplete()) {
+                    resetStream(stream->id, ErrorCode::INTERNAL);
+                }
+            } else {
+                sendResponse(*stream, ctx.res);
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "HTTP/2 stream " << stream->id << " failed: " << e.what() << std::endl;
+        resetStream(stream->id, ErrorCode::INTERNAL);
+    }
+
+    finishStream(*stream);
+}
+
+bool Http2Connection::sendResponse(Stream& stream, HttpResponse& res) {
+    res.prepareResponse();
+
+    bool hasBody = !res.body.empty() &&
+                   res.statusCode != HttpStatus::NOT_MODIFIED &&
+                   res.statusCode != HttpStatus::NO_CONTENT;
+
+    if (!sendHeaders(stream, res, false, !hasBody)) return false;
+    return !hasBody || sendData(stream, res.body.data(), res.body.size(), true);
+}
+
+bool Http2Connection::sendHeaders(Stream& stream, const HttpResponse& res, bool streamed, bool endStream) {
+    bool bodiless = res.statusCode == HttpStatus::NOT_MODIFIED || res.statusCode == HttpStatus::NO_CONTENT;
+
+    Hpack::HeaderList fields;
+    fields.emplace_back(":status", std::to_string(static_cast<int>(res.statusCode)));
+
+    bool hasLength = false;
+    for (const auto& [key, value] : res.headers) {
+        std::string name = key;
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+
+        // Connection-specific fields are not allowed in HTTP/2
+        if (name == "connection" || name == "keep-alive" || name == "transfer-encoding" ||
+            name == "upgrade" || name == "proxy-connection") {
+            continue;
+        }
+        if (name == "content-length") {
+            if (streamed || bodiless) continue;
+            hasLength = true;
+        }
+        fields.emplace_back(std::move(name), value);
+    }
+    if (!streamed && !bodiless && !hasLength) {
+        fields.emplace_back("content-length", std::to_string(res.body.length()));
+    }
+
+    std::lock_guard<std::mutex> writeLock(writeMutex);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stream.reset) return false;
+    }
+
+    std::string block;
+    encoder.encode(fields, block);
+
+    size_t maxFrame = peerMaxFrameSize;
+    size_t offset = 0;
+    uint8_t type = HEADERS;
+    uint8_t flags = endStream ? FLAG_END_STREAM : 0;
+    do {
+        size_t chunk = std::min(block.size() - offset, maxFrame);
+        bool last = offset + chunk == block.size();
+        if (!writeFrameLocked(type, flags | (last ? FLAG_END_HEADERS : 0), stream.id, block.data() + offset, chunk)) {
+            return false;
+        }
+        offset += chunk;
+        type = CONTINUATION;
+        flags = 0;
+    } while (offset < block.size());
+
+    return true;
+}
+
+bool Http2Connection::sendData(Stream& stream, const char* data, size_t length, bool endStream) {
+    if (length == 0 && !endStream) return true;
+
+    size_t offset = 0;
+    do {
+        size_t chunk = 0;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (offset < length) {
+                // Blocks the handler while the client's windows are used up
+                bool ready = windowChanged.wait_for(lock, std::chrono::seconds(Config::SOCKET_TIMEOUT), [&] {
+                    return stream.reset || closing || (sendWindow > 0 && stream.sendWindow > 0);
+                });
+                if (!ready || stream.reset || closing) return false;
+
+                int64_t allowed = std::min({sendWindow, stream.sendWindow,
+                                            static_cast<int64_t>(peerMaxFrameSize.load())});
+                chunk = static_cast<size_t>(std::min<int64_t>(allowed, static_cast<int64_t>(length - offset)));
+                sendWindow -= static_cast<int64_t>(chunk);
+                stream.sendWindow -= static_cast<int64_t>(chunk);
+            } else if (stream.reset) {
+                return false;
+            }
+        }
+
+        bool last = endStream && offset + chunk == length;
+        if (!writeFrame(DATA, last ? FLAG_END_STREAM : 0, stream.id, data + offset, chunk)) {
+            return false;
+        }
+        offset += chunk;
+    } while (offset < length);
+
+    return true;
+}
+
+void Http2Connection::finishStream(Stream& stream) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = streams.find(stream.id);
+    if (it != streams.end() && it->second.get() == &stream) {
+        streams.erase(it);
+    }
+}
+
+bool Http2Connection::writeFrame(uint8_t type, uint8_t flags, uint32_t streamId, const char* data, size_t length) {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    return writeFrameLocked(type, flags, streamId, data, length);
+}
+
+bool Http2Connection::writeFrameLocked(uint8_t type, uint8_t flags, uint32_t streamId, const char* data, size_t length) {
+    if (writeFailed) return false;
+
+    std::string frame;
+    frame.reserve(9 + length);
+    frame += static_cast<char>((length >> 16) & 0xFF);
+    frame += static_cast<char>((length >> 8) & 0xFF);
+    frame += static_cast<char>(length & 0xFF);
+    frame += static_cast<char>(type);
+    frame += static_cast<char>(flags);
+    appendUint32(frame, streamId & 0x7fffffff);
+    if (length > 0) frame.append(data, length);
+
+    if (!Socket::sendAll(fd, frame.data(), frame.size())) {
+        writeFailed = true;
+        return false;
+    }
+    return true;
+}
+
+void Http2Connection::resetStream(uint32_t streamId, ErrorCode code) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = streams.find(streamId);
+        if (it != streams.end()) {
+            it->second->reset = true;
+            streams.erase(it);
+            windowChanged.notify_all();
+        }
+    }
+
+    std::string payload;
+    appendUint32(payload, static_cast<uint32_t>(code));
+    writeFrame(RST_STREAM, 0, streamId, payload.data(), payload.size());
+}
+
+void Http2Connection::sendGoaway(ErrorCode code) {
+    std::string payload;
+    appendUint32(payload, lastStreamId);
+    appendUint32(payload, static_cast<uint32_t>(code));
+    writeFrame(GOAWAY, 0, 0, payload.data(), payload.size());
+}
+
+void Http2Connection::sendSettings() {
+    std::string payload;
+    appendSetting(payload, SETTINGS_MAX_CONCURRENT_STREAMS, Config::HTTP2_MAX_CONCURRENT_STREAMS);
+    appendSetting(payload, SETTINGS_INITIAL_WINDOW_SIZE, Config::HTTP2_INITIAL_WINDOW_SIZE);
+    appendSetting(payload, SETTINGS_MAX_HEADER_LIST_SIZE, static_cast<uint32_t>(Config::HTTP2_MAX_HEADER_LIST_SIZE));
+    if (Config::HTTP2_HEADER_TABLE_SIZE != 4096) {
+        appendSetting(payload, SETTINGS_HEADER_TABLE_SIZE, static_cast<uint32_t>(Config::HTTP2_HEADER_TABLE_SIZE));
+    }
+    writeFrame(SETTINGS, 0, 0, payload.data(), payload.size());
+
+    // The connection window can only be raised with WINDOW_UPDATE
+    if (Config::HTTP2_CONNECTION_WINDOW_SIZE > DEFAULT_WINDOW) {
+        std::string increment;
+        appendUint32(increment, Config::HTTP2_CONNECTION_WINDOW_SIZE - DEFAULT_WINDOW);
+        writeFrame(WINDOW_UPDATE, 0, 0, increment.data(), increment.size());
+    }
+}
@@ -43,6 +43,7 @@ bool HttpRequest::parseHeaders(const std::string& headerData) {
     if (!(requestLine >> method >> path >> version)) {
         return false;
     }
+    methodType = parseHttpMethod(method);
     
     while (std::getline(stream, line)) {
         if (line.empty() || line == "\r") break;
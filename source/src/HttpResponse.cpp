@@ -1,35 +1,46 @@
 #include <sstream>
+#include <algorithm>
+#include <vector>
 #include <filesystem>
-#include <zlib.h>
 
 #include "Defs.h"
 #include "Utils.h"
+#include "Compression.h"
 #include "MimeType.h"
+#include "Template.h"
+#include "Socket.h"
 #include "HttpResponse.h"
 
-extern const MimeType MIME_TYPES[];
-
 // HttpResponse::HttpResponse(int fd) : connfd(fd), statusCode(HttpStatus::OK) {}
-HttpResponse::HttpResponse(socket_t fd, HttpRequest& req) : connfd(fd), req(req), statusCode(HttpStatus::OK) {
+HttpResponse::HttpResponse(socket_t fd, HttpRequest& req) : connfd(fd), req(&req), statusCode(HttpStatus::OK),
+      lastModified(-1), bodyETag(false), bodyETagWeak(false), streamState(StreamState::None), sink(nullptr),
+      encoded(false), prepared(false) {
     headers["Server"] = "CPPServer/1.1";
 }
 
 HttpResponse& HttpResponse::setStatus(HttpStatus code) { 
+    dropPrepared();
     statusCode = code; 
     return *this; 
 }
 
 HttpResponse& HttpResponse::setStatus(int code) { 
-    statusCode = static_cast<HttpStatus>(code); 
-    return *this; 
+    return setStatus(static_cast<HttpStatus>(code));
 }
 
 HttpResponse& HttpResponse::setHeader(const std::string& key, const std::string& value) { 
+    dropPrepared();
     headers[key] = value; 
     return *this; 
 }
 
 HttpResponse& HttpResponse::setBody(const std::string& content) { 
+    if (encoded) {
+        // a new body is compressed again
+        encoded = false;
+        headers.erase("Content-Encoding");
+        headers.erase("Content-Length");
+    }
     body = content; 
     return *this; 
 }
@@ -40,7 +51,61 @@ HttpResponse& HttpResponse::setJson(const json& data) {
     return *this; 
 }
 
+HttpResponse& HttpResponse::setETag(const std::string& tag, bool weak) {
+    headers["ETag"] = (weak ? "W/\"" : "\"") + tag + "\"";
+    bodyETag = false;
+    return *this;
+}
+
+HttpResponse& HttpResponse::setBodyETag(bool weak) {
+    bodyETag = true;
+    bodyETagWeak = weak;
+    return *this;
+}
+
+HttpResponse& HttpResponse::setLastModified(time_t time) {
+    lastModified = time;
+    headers["Last-Modified"] = Utils::formatHttpDate(time);
+    return *this;
+}
+
+static bool etagMatches(const std::string& ifNoneMatch, const std::string& etag) {
+    auto opaque = [](const std::string& tag) {
+        return tag.compare(0, 2, "W/") == 0 ? tag.substr(2) : tag;
+    };
+
+    std::string current = opaque(etag);
+    std::istringstream ss(ifNoneMatch);
+    std::string candidate;
+    while (std::getline(ss, candidate, ',')) {
+        candidate = Utils::trim(candidate);
+        if (candidate == "*" || opaque(candidate) == current) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool HttpResponse::isNotModified() const {
+    if (req->methodType != HttpMethod::GET && req->methodType != HttpMethod::HEAD) return false;
+
+    std::string ifNoneMatch = req->headers.get("If-None-Match", "");
+    if (!ifNoneMatch.empty()) {
+        auto etag = headers.find("ETag");
+        return etag != headers.end() && etagMatches(ifNoneMatch, etag->second);
+    }
+
+    std::string ifModifiedSince = req->headers.get("If-Modified-Since", "");
+    if (!ifModifiedSince.empty() && lastModified >= 0) {
+        time_t since = Utils::parseHttpDate(ifModifiedSince);
+        return since >= 0 && lastModified <= since;
+    }
+
+    return false;
+}
+
 HttpResponse& HttpResponse::setCookie(const std::string& key, const std::string& value, const std::string& path, int maxAge, bool secure, bool httpOnly) {
+    dropPrepared();
     std::ostringstream cookie;
     cookie << key << "=" << value;
     
@@ -94,14 +159,51 @@ HttpResponse& HttpResponse::redirect(const std::string& location, HttpStatus sta
 
 
 HttpResponse& HttpResponse::renderTemplate(const std::string& templateName) {
-    std::string templatePath = std::string(Config::TEMPLATE_DIR) + "/" + templateName;
-    if (!std::filesystem::exists(templatePath)) {
-        throw std::runtime_error("Template not found: " + templatePath);
+    try {
+        const Template::Precompiled* precompiled =
+            Config::TEMPLATE_DEV_MODE ? nullptr : Template::findPrecompiled(templateName);
+        if (precompiled) {
+            headers["Content-Type"] = "text/html";
+            if (setFileValidators(precompiled->source, "")) {
+                return *this;
+            }
+
+            body.clear();
+            precompiled->render(json::object(), body);
+            return *this;
+        }
+
+        auto compiled = Template::load(templateName);
+        headers["Content-Type"] = "text/html";
+
+        // Without a context the output only depends on the template files
+        if (setFileValidators(compiled->sourceInfo(), "")) {
+            return *this;
+        }
+
+        body.clear();
+        compiled->render(json::object(), body);
+        return *this;
+    } catch (const std::exception& e) {
+        throw std::runtime_error("Failed to render template: " + std::string(e.what()));
     }
+}
 
+HttpResponse& HttpResponse::renderTemplate(const std::string& templateName, const json& data) {
     try {
-        body = Utils::readFile(templatePath);
+        const Template::Precompiled* precompiled =
+            Config::TEMPLATE_DEV_MODE ? nullptr : Template::findPrecompiled(templateName);
+        if (precompiled) {
+            headers["Content-Type"] = "text/html";
+            body.clear();
+            precompiled->render(data, body);
+            return *this;
+        }
+
+        auto compiled = Template::load(templateName);
         headers["Content-Type"] = "text/html";
+        body.clear();
+        compiled->render(data, body);
         return *this;
     } catch (const std::exception& e) {
         throw std::runtime_error("Failed to render template: " + std::string(e.what()));
@@ -114,56 +216,350 @@ HttpResponse& HttpResponse::sendFile(const std::string& fullPath) {
     }
 
     try {
-        std::string content = Utils::readFile(fullPath);
-        setBody(content);
-
-        std::string contentType = "application/octet-stream";
-        for (const auto& signature : MIME_TYPES) {
-            if (checkMimeType(reinterpret_cast<const unsigned char*>(content.c_str()), 
-                            content.size(), 
-                            signature)) {
-                contentType = signature.mimeType;
-                break;
-            }
+        std::string encoding;
+        std::string variantPath = selectPrecompressed(fullPath, encoding);
+
+        if (Compression::isCompressibleExtension(fullPath)) {
+            setHeader("Vary", "Accept-Encoding");
+        }
+        setHeader("Accept-Ranges", "bytes");
+
+        Utils::FileInfo info;
+        if (!Utils::statFile(variantPath, info)) {
+            return setStatus(HttpStatus::NOT_FOUND).setBody("Not Found\n");
+        }
+
+        if (setFileValidators(info, encoding)) {
+            return *this;
         }
 
+        std::string contentType = detectMimeType(fullPath);
         setHeader("Content-Type", contentType);
+        if (!encoding.empty()) {
+            setHeader("Content-Encoding", encoding);
+        }
+
+        if (sendFileRanges(variantPath, info.size, contentType)) {
+            return *this;
+        }
+
+        setBody(Utils::readFile(variantPath));
         return *this;
     } catch (const std::exception& e) {
         return setStatus(HttpStatus::INTERNAL_SERVER_ERROR).setBody(std::string(e.what()) + "\n");
     }
 }
 
+bool HttpResponse::setFileValidators(const Utils::FileInfo& info, const std::string& encoding) {
+    // size and mtime only, so replicas serving the same build agree on the tag
+    std::ostringstream tag;
+    tag << std::hex << info.mtime << "-" << info.size;
+    if (!encoding.empty()) {
+        tag << "-" << encoding;
+    }
+
+    setETag(tag.str());
+    setLastModified(info.mtime);
+
+    if (isNotModified()) {
+        statusCode = HttpStatus::NOT_MODIFIED;
+        body.clear();
+        return true;
+    }
+    return false;
+}
+
+bool HttpResponse::rangeValidatorMatches() const {
+    std::string ifRange = Utils::trim(req->headers.get("If-Range", ""));
+    if (ifRange.empty()) return true;
+
+    if (ifRange.front() == '"') {
+        auto etag = headers.find("ETag");
+        return etag != headers.end() && etag->second == ifRange;
+    }
+
+    time_t date = Utils::parseHttpDate(ifRange);
+    return date >= 0 && date == lastModified;
+}
+
+// Parses a "bytes=" Range header against a representation of the given size.
+// Returns -1 if the header should be ignored, 0 if no range is satisfiable
+// and 1 if ranges holds at least one inclusive [first, last] pair, sorted
+// with overlapping and adjacent ranges merged.
+static int parseByteRanges(const std::string& header, uint64_t size,
+                           std::vector<std::pair<uint64_t, uint64_t>>& ranges) {
+    const std::string prefix = "bytes=";
+    if (header.compare(0, prefix.length(), prefix) != 0) return -1;
+
+    std::istringstream ss(header.substr(prefix.length()));
+    std::string spec;
+    while (std::getline(ss, spec, ',')) {
+        spec = Utils::trim(spec);
+        size_t dash = spec.find('-');
+        if (spec.empty() || dash == std::string::npos) return -1;
+
+        std::string firstStr = spec.substr(0, dash);
+        std::string lastStr = spec.substr(dash + 1);
+        if (firstStr.find_first_not_of("0123456789") != std::string::npos ||
+            lastStr.find_first_not_of("0123456789") != std::string::npos ||
+            (firstStr.empty() && lastStr.empty())) {
+            return -1;
+        }
+
+        uint64_t first, last;
+        try {
+            if (firstStr.empty()) {
+                uint64_t suffix = std::stoull(lastStr);
+                if (suffix == 0 || size == 0) continue;
+                first = suffix >= size ? 0 : size - suffix;
+                last = size - 1;
+            } else {
+                first = std::stoull(firstStr);
+                last = lastStr.empty() ? first : std::stoull(lastStr);
+                if (last < first) return -1;
+                if (first >= size) continue;
+                if (lastStr.empty()) last = size - 1;
+                if (last >= size) last = size - 1;
+            }
+        } catch (const std::exception&) {
+            return -1;
+        }
+
+        ranges.emplace_back(first, last);
+        if (ranges.size() > Config::MAX_RANGES) return -1;
+    }
+
+    if (ranges.empty()) return 0;
+
+    // Asking for more than the whole file is cheaper to answer with all of it
+    uint64_t requested = 0;
+    for (const auto& [first, last] : ranges) {
+        requested += last - first + 1;
+    }
+    if (requested > size) return -1;
+
+    std::sort(ranges.begin(), ranges.end());
+    size_t merged = 0;
+    for (size_t i = 1; i < ranges.size(); i++) {
+        if (ranges[i].first <= ranges[merged].second + 1) {
+            ranges[merged].second = std::max(ranges[merged].second, ranges[i].second);
+        } else {
+            ranges[++merged] = ranges[i];
+        }
+    }
+    ranges.resize(merged + 1);
+    return 1;
+}
+
+bool HttpResponse::sendFileRanges(const std::string& path, uint64_t size, const std::string& contentType) {
+    std::string rangeHeader = req->headers.get("Range", "");
+    if (rangeHeader.empty() || req->methodType != HttpMethod::GET || !rangeValidatorMatches()) {
+        return false;
+    }
+
+    std::vector<std::pair<uint64_t, uint64_t>> ranges;
+    int parsed = parseByteRanges(rangeHeader, size, ranges);
+    if (parsed < 0) return false;
+
+    if (parsed == 0) {
+        statusCode = HttpStatus::RANGE_NOT_SATISFIABLE;
+        headers.erase("Content-Encoding");
+        headers["Content-Range"] = "bytes */" + std::to_string(size);
+        body.clear();
+        return true;
+    }
+
+    statusCode = HttpStatus::PARTIAL_CONTENT;
+
+    if (ranges.size() == 1) {
+        const auto& [first, last] = ranges.front();
+        body = Utils::readFileRange(path, first, last - first + 1);
+        headers["Content-Range"] = "bytes " + std::to_string(first) + "-" +
+                                   std::to_string(last) + "/" + std::to_string(size);
+        return true;
+    }
+
+    std::ostringstream boundary;
+    boundary << std::hex << Utils::hash64(headers["ETag"] + rangeHeader);
+    std::string marker = "--" + boundary.str();
+
+    body.clear();
+    for (const auto& [first, last] : ranges) {
+        body += "\r\n" + marker + "\r\n";
+        body += "Content-Type: " + contentType + "\r\n";
+        body += "Content-Range: bytes " + std::to_string(first) + "-" +
+                std::to_string(last) + "/" + std::to_string(size) + "\r\n\r\n";
+        body += Utils::readFileRange(path, first, last - first + 1);
+    }
+    body += "\r\n" + marker + "--\r\n";
+
+    headers["Content-Type"] = "multipart/byteranges; boundary=" + boundary.str();
+    return true;
+}
+
+std::string HttpResponse::selectPrecompressed(const std::string& fullPath, std::string& encoding) const {
+    static const std::pair<Compression::Encoding, const char*> variants[] = {
+        {Compression::Encoding::Brotli, ".br"},
+        {Compression::Encoding::Gzip, ".gz"}
+    };
+
+    std::string acceptEncoding = req->headers.get("Accept-Encoding", "");
+    if (acceptEncoding.empty()) return fullPath;
+
+    std::vector<Compression::Encoding> candidates;
+    for (const auto& variant : variants) {
+        candidates.push_back(variant.first);
+    }
+
+    Utils::FileInfo source;
+    if (!Utils::statFile(fullPath, source)) return fullPath;
+
+    // Variants exist on disk regardless of which encoders are compiled in
+    for (Compression::Encoding coding : Compression::rankEncodings(acceptEncoding, candidates)) {
+        for (const auto& [variantCoding, suffix] : variants) {
+            if (variantCoding != coding) continue;
+
+            // one older than the source was left behind by an earlier build
+            std::string candidate = fullPath + suffix;
+            Utils::FileInfo info;
+            if (Utils::statFile(candidate, info) && info.mtime >= source.mtime) {
+                encoding = Compression::encodingName(coding);
+                return candidate;
+            }
+        }
+    }
+    return fullPath;
+}
+
+std::string HttpResponse::detectMimeType(const std::string& path) const {
+    if (const char* type = mimeTypeForPath(path)) {
+        return type;
+    }
+
+    std::string head = Utils::readFileHead(path, 8);
+    if (const char* type = sniffMimeType(reinterpret_cast<const unsigned char*>(head.data()), head.size())) {
+        return type;
+    }
+    return "application/octet-stream";
+}
+
 std::string HttpResponse::toString() {
+    if (preparedResponse) {
+        return preparedResponse->head + connectionFields() + "\r\n" + preparedResponse->body;
+    }
+    prepareResponse();
+    return headerBlock(false) + body;
+}
+
+std::shared_ptr<const PreparedResponse> HttpResponse::serialize() {
+    if (preparedResponse) return preparedResponse;
     prepareResponse();
 
+    auto prepared = std::make_shared<PreparedResponse>();
+    prepared->status = statusCode;
+    prepared->headers = headers;
+    prepared->body = body;
+    if (statusCode != HttpStatus::NOT_MODIFIED && statusCode != HttpStatus::NO_CONTENT) {
+        prepared->headers.emplace("Content-Length", std::to_string(body.length()));
+    }
+
+    std::ostringstream head;
+    head << "HTTP/1.1 " << (int)statusCode << " " << getStatusText() << "\r\n";
+    for (const auto& [key, value] : prepared->headers) {
+        if (key != "Connection" && key != "Keep-Alive") {
+            head << key << ": " << value << "\r\n";
+        }
+    }
+    prepared->head = head.str();
+    return prepared;
+}
+
+HttpResponse& HttpResponse::setPrepared(std::shared_ptr<const PreparedResponse> response) {
+    statusCode = response->status;
+    headers = response->headers;
+    body.clear();
+    bodyETag = false;
+    prepared = true;
+    preparedResponse = nullptr;
+
+    auto modified = headers.find("Last-Modified");
+    lastModified = modified != headers.end() ? Utils::parseHttpDate(modified->second) : -1;
+
+    if (statusCode == HttpStatus::OK && isNotModified()) {
+        statusCode = HttpStatus::NOT_MODIFIED;
+        headers.erase("Content-Length");
+    } else if (isMultiplexed()) {
+        // HTTP/2 encodes the headers per connection
+        body = response->body;
+    } else {
+        preparedResponse = std::move(response);
+    }
+    return *this;
+}
+
+// Back to a response built from its fields, once they change
+void HttpResponse::dropPrepared() {
+    if (preparedResponse) {
+        body = preparedResponse->body;
+        preparedResponse = nullptr;
+    }
+}
+
+bool HttpResponse::send() {
+    if (isStreamed()) return false;
+
+    bool sent;
+    if (sink) {
+        prepareResponse();
+        bool hasBody = !body.empty() && statusCode != HttpStatus::NOT_MODIFIED && statusCode != HttpStatus::NO_CONTENT;
+        sent = sink->sendHeaders(*this, !hasBody) && (!hasBody || sink->sendData(body.data(), body.size(), true));
+    } else {
+        std::string response = toString();
+        sent = Socket::sendAll(connfd, response.data(), response.length());
+    }
+
+    streamState = StreamState::Finished;
+    return sent;
+}
+
+std::string HttpResponse::connectionFields() const {
+    if (req->headers.get("Connection", "") == "keep-alive") {
+        return "Connection: keep-alive\r\nKeep-Alive: timeout=" + std::to_string(Config::KEEP_ALIVE_TIMEOUT) +
+               ", max=" + std::to_string(Config::MAX_KEEP_ALIVE_REQUESTS) + "\r\n";
+    }
+    return "Connection: close\r\n";
+}
+
+std::string HttpResponse::headerBlock(bool chunked) const {
     std::ostringstream response;
     response << "HTTP/1.1 " << (int)statusCode << " " << getStatusText() << "\r\n";
     
     auto headersCopy = headers;
-    if (headersCopy.find("Content-Length") == headersCopy.end()) {
+    if (chunked) {
+        headersCopy.erase("Content-Length");
+        headersCopy["Transfer-Encoding"] = "chunked";
+    } else if (statusCode == HttpStatus::NOT_MODIFIED || statusCode == HttpStatus::NO_CONTENT) {
+        headersCopy.erase("Content-Length");
+    } else if (headersCopy.find("Content-Length") == headersCopy.end() && !isStreamed()) {
         headersCopy["Content-Length"] = std::to_string(body.length());
     }
 
-    if (req.headers.get("Connection", "") == "keep-alive") {
-        headersCopy["Connection"] = "keep-alive";
-        headersCopy["Keep-Alive"] = "timeout=" + 
-            std::to_string(Config::KEEP_ALIVE_TIMEOUT) + 
-            ", max=" + std::to_string(Config::MAX_KEEP_ALIVE_REQUESTS);
-    } else {
-        headersCopy["Connection"] = "close";
-    }
-
     for (const auto& [key, value] : headersCopy) {
         response << key << ": " << value << "\r\n";
     }
-    response << "\r\n" << body;
+    if (headersCopy.find("Connection") == headersCopy.end()) {
+        response << connectionFields();
+    }
+    response << "\r\n";
     return response.str();
 }
 
 
 std::string HttpResponse::getStatusText() const {
     switch (statusCode) {
+        // 1xx Informational
+        case HttpStatus::SWITCHING_PROTOCOLS: return "Switching Protocols";
+
         // 2xx Success
         case HttpStatus::OK: return "OK";
         case HttpStatus::CREATED: return "Created";
@@ -234,63 +630,72 @@ std::string HttpResponse::getStatusText() const {
 }
 
 bool HttpResponse::shouldCompress(const std::string& contentTypes) const {
-    return contentTypes.find("text/") != std::string::npos ||
-           contentTypes.find("application/json") != std::string::npos ||
-           contentTypes.find("application/javascript") != std::string::npos ||
-           contentTypes.find("application/xml") != std::string::npos || 
-           contentTypes.find("application/x-www-form-urlencoded") != std::string::npos;
-}
-
-std::string HttpResponse::compressGzip(const std::string& content) const {
-    std::ostringstream compressed;
-    z_stream zs;
-    zs.zalloc = Z_NULL;
-    zs.zfree = Z_NULL;
-    zs.opaque = Z_NULL;
-    zs.next_in = (Bytef*)content.data();
-    zs.avail_in = content.size();
-    
-    if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 31, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
-        throw std::runtime_error("Failed to initialize zlib deflate");
-    }
-    
-    char outbuffer[32768];
-    std::string outstring;
-    
-    do {
-        zs.next_out = reinterpret_cast<Bytef*>(outbuffer);
-        zs.avail_out = sizeof(outbuffer);
-        
-        if (deflate(&zs, Z_FINISH) == Z_STREAM_ERROR) {
-            deflateEnd(&zs);
-            throw std::runtime_error("Failed to compress data");
-        }
-        
-        outstring.append(outbuffer, sizeof(outbuffer) - zs.avail_out);
-    } while (zs.avail_out == 0);
-    
-    deflateEnd(&zs);
-    return outstring;
+    return Compression::isCompressible(contentTypes);
 }
 
-void HttpResponse::prepareResponse() {
-    const std::string& acceptEncoding = req.headers.get("Accept-Encoding", "");
-    const std::string& contentType = headers["Content-Type"];
-    
-    if (body.length() > 1024 && 
-        acceptEncoding.find("gzip") != std::string::npos &&
+std::string HttpResponse::compressBody(Compression::Encoding encoding, const std::string& content, int level) const {
+    return Compression::encodeCached(encoding, content, level);
+}
+
+HttpResponse& HttpResponse::compress() {
+    if (encoded || prepared || isStreamed()) return *this;
+    encoded = true;
+    if (statusCode == HttpStatus::NOT_MODIFIED) return *this;
+
+    std::string acceptEncoding = req->headers.get("Accept-Encoding", "");
+    auto contentTypeIt = headers.find("Content-Type");
+    std::string contentType = contentTypeIt != headers.end() ? contentTypeIt->second : "";
+
+    bool encode = statusCode == HttpStatus::OK &&
+        body.length() >= Compression::policy().minSize &&
         shouldCompress(contentType) &&
-        headers.find("Content-Encoding") == headers.end()) {
-        
+        headers.find("Content-Encoding") == headers.end();
+
+    Compression::Encoding encoding = Compression::Encoding::Identity;
+    if (encode) {
+        encoding = Compression::negotiate(acceptEncoding, contentType);
+        encode = encoding != Compression::Encoding::Identity;
+    }
+
+    if (bodyETag && statusCode == HttpStatus::OK) {
+        std::ostringstream tag;
+        tag << std::hex << Utils::hash64(body);
+        setETag(tag.str(), bodyETagWeak);
+    }
+
+    auto etag = headers.find("ETag");
+    if (encode && etag != headers.end() && etag->second.compare(0, 2, "W/") != 0) {
+        // a strong validator must differ between the identity and encoded representations
+        etag->second.insert(etag->second.length() - 1, std::string("-") + Compression::encodingName(encoding));
+    }
+
+    // prepareResponse() turns it into a 304
+    if (statusCode == HttpStatus::OK && isNotModified()) return *this;
+
+    if (encode) {
         try {
-            std::string compressed = compressGzip(body);
+            std::string compressed = compressBody(encoding, body, Compression::chooseLevel(contentType, body.length()));
             if (compressed.length() < body.length()) {
-                body = compressed;
-                headers["Content-Encoding"] = "gzip";
+                body = std::move(compressed);
+                headers["Content-Encoding"] = Compression::encodingName(encoding);
+                headers["Vary"] = "Accept-Encoding";
                 headers["Content-Length"] = std::to_string(body.length());
             }
         } catch (const std::exception& e) {
             throw std::runtime_error("Failed to compress response: " + std::string(e.what()));
         }
     }
-}
\ No newline at end of file
+    return *this;
+}
+
+void HttpResponse::prepareResponse() {
+    if (prepared) return;
+    compress();
+    prepared = true;
+
+    if (statusCode == HttpStatus::OK && isNotModified()) {
+        statusCode = HttpStatus::NOT_MODIFIED;
+        body.clear();
+        headers.erase("Content-Length");
+    }
+}
@@ -1,13 +1,124 @@
 #include <iostream>
 #include <thread>
 #include <cstring>
-#include <regex>
+#include <limits>
+#include <charconv>
 
 #include "Defs.h"
 #include "HttpServer.h"
+#include "Compression.h"
+#include "Socket.h"
+#include "Http2.h"
+
+const Router::Param* PathVars::find(std::string_view name) const {
+    if (!names_) return nullptr;
+    for (size_t i = 0; i < params_.count; i++) {
+        if ((*names_)[i] == name) return &params_.values[i];
+    }
+    return nullptr;
+}
+
+const Router::Param& PathVars::at(std::string_view name) const {
+    const Router::Param* param = find(name);
+    if (!param) {
+        throw std::out_of_range("Path variable not found: " + std::string(name));
+    }
+    return *param;
+}
+
+int64_t PathVars::getInt64(std::string_view name) const {
+    const Router::Param& param = at(name);
+    switch (param.type) {
+        case Router::VarType::Int:
+        case Router::VarType::Int64:
+            return param.integer;
+        case Router::VarType::Uint:
+            if (param.uinteger > static_cast<uint64_t>(std::numeric_limits<int64_t>::max())) {
+                throw std::out_of_range("Path variable out of range: " + std::string(name));
+            }
+            return static_cast<int64_t>(param.uinteger);
+        default: {
+            int64_t value;
+            auto [end, ec] = std::from_chars(param.value.data(), param.value.data() + param.value.size(), value);
+            if (ec == std::errc::result_out_of_range) {
+                throw std::out_of_range("Path variable out of range: " + std::string(name));
+            }
+            if (ec != std::errc() || end != param.value.data() + param.value.size()) {
+                throw std::invalid_argument("Path variable is not an integer: " + std::string(name));
+            }
+            return value;
+        }
+    }
+}
+
+void PathVars::rebase(const std::string& matched, const std::string& copy) {
+    auto begin = reinterpret_cast<uintptr_t>(matched.data());
+    for (size_t i = 0; i < params_.count; i++) {
+        std::string_view& value = params_.values[i].value;
+        auto at = reinterpret_cast<uintptr_t>(value.data());
+        if (at >= begin && at + value.size() <= begin + matched.size()) {
+            value = std::string_view(copy.data() + (at - begin), value.size());
+        }
+    }
+}
+
+int PathVars::getInt(std::string_view name) const {
+    int64_t value = getInt64(name);
+    if (value < std::numeric_limits<int>::min() || value > std::numeric_limits<int>::max()) {
+        throw std::out_of_range("Path variable out of range: " + std::string(name));
+    }
+    return static_cast<int>(value);
+}
+
+uint64_t PathVars::getUint(std::string_view name) const {
+    const Router::Param& param = at(name);
+    if (param.type == Router::VarType::Uint) {
+        return param.uinteger;
+    }
+    if (param.type == Router::VarType::Int || param.type == Router::VarType::Int64) {
+        if (param.integer < 0) {
+            throw std::out_of_range("Path variable out of range: " + std::string(name));
+        }
+        return static_cast<uint64_t>(param.integer);
+    }
+
+    uint64_t value;
+    auto [end, ec] = std::from_chars(param.value.data(), param.value.data() + param.value.size(), value);
+    if (ec == std::errc::result_out_of_range) {
+        throw std::out_of_range("Path variable out of range: " + std::string(name));
+    }
+    if (ec != std::errc() || end != param.value.data() + param.value.size()) {
+        throw std::invalid_argument("Path variable is not an unsigned integer: " + std::string(name));
+    }
+    return value;
+}
+
+static PeerAddress peerAddress(const struct sockaddr_storage& addr) {
+    PeerAddress peer;
+    char ip[INET6_ADDRSTRLEN] = {0};
+
+    if (addr.ss_family == AF_INET) {
+        const auto& v4 = reinterpret_cast<const struct sockaddr_in&>(addr);
+        inet_ntop(AF_INET, &v4.sin_addr, ip, sizeof(ip));
+        peer.port = ntohs(v4.sin_port);
+    } else if (addr.ss_family == AF_INET6) {
+        const auto& v6 = reinterpret_cast<const struct sockaddr_in6&>(addr);
+        inet_ntop(AF_INET6, &v6.sin6_addr, ip, sizeof(ip));
+        peer.port = ntohs(v6.sin6_port);
+    }
+
+    peer.ip = ip;
+    return peer;
+}
 
 HttpServer::HttpServer(const std::string& host, int port) 
-    : host_(host), port_(port), sockfd_(INVALID_SOCK), running_(false) {
+    : host_(host), port_(port), sockfd_(INVALID_SOCK), running_(false),
+      builtins_(Middleware::Compress(),
+                Middleware::StaticFiles("/" + Config::STATIC_DIR + "/", Config::STATIC_DIR),
+                Middleware::HealthCheck(Config::HEALTH_CHECK_ENABLED ? "/health" : "")) {
+    if (Config::COMPRESSION_CACHE_SIZE > 0) {
+        Compression::setCacheCapacity(Config::COMPRESSION_CACHE_SIZE);
+    }
 #ifdef _WIN32
     if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
         throw ServerException("WSAStartup failed");
@@ -82,13 +193,20 @@ std::string HttpServer::getLastError() {
 void HttpServer::run() {
     if (running_) throw ServerException("Server is already running");
     
+    if (Config::PRECOMPRESS_STATIC_ON_STARTUP) {
+        precompressStatic(Config::PRECOMPRESS_THREADS);
+    }
+
+    freezeRoutes();
     setupServer();
+    loop_.start();
+    background_.start();
     running_ = true;
 
     std::cout << "Listening on " << host_ << ":" << port_ << std::endl;
 
     while (running_) {
-        struct sockaddr_in client_addr;
+        struct sockaddr_storage client_addr;
         socklen_t client_addr_len = sizeof(client_addr);
         
         socket_t connfd;
@@ -119,9 +237,9 @@ void HttpServer::run() {
         if (!running_) break;
         
         if (connfd != INVALID_SOCK) {
-            std::thread([this, connfd]() {
-                handleConnection(connfd);
-                closeSocket(connfd);
+            PeerAddress peer = peerAddress(client_addr);
+            std::thread([this, connfd, peer]() {
+                handleConnection(connfd, peer);
             }).detach();
         }
     }
@@ -129,6 +247,23 @@ void HttpServer::run() {
     cleanup();
 }
 
+void HttpServer::setCompressionPolicy(const Compression::Policy& policy) {
+    if (running_) throw ServerException("Cannot change compression policy while server is running");
+    Compression::setPolicy(policy);
+}
+
+void HttpServer::setCompressionCache(size_t maxBytes) {
+    Compression::setCacheCapacity(maxBytes);
+}
+
+size_t HttpServer::precompressStatic(unsigned int threads) {
+    size_t written = Compression::precompressDirectory(Config::STATIC_DIR, threads);
+    if (written > 0) {
+        std::cout << "Precompressed " << written << " static file(s) in " << Config::STATIC_DIR << std::endl;
+    }
+    return written;
+}
+
 void HttpServer::stop() {
     if (running_) {
         running_ = false;
@@ -139,169 +274,238 @@ void HttpServer::stop() {
     }
 }
 
-bool HttpServer::RoutePattern::match(const std::string& path, 
-                                   std::map<std::string, std::string>& out_vars) const {
-    std::smatch matches;
-    if (!std::regex_match(path, matches, regex)) {
-        return false;
-    }
-    
-    for (size_t i = 0; i < vars.size(); i++) {
-        const auto& [var_name, var_type] = vars[i];
-        std::string value = matches[i + 1].str();
-        
-        if (var_type == "int") {
-            try {
-                std::stoi(value);
-            } catch (const std::exception&) {
-                return false;
+// Pattern without variable names: /users/{id:int} and /users/{uid:int}
+// occupy the same place in a Router
+static std::string patternShape(const std::string& pattern) {
+    std::string shape;
+    for (size_t pos = 0; pos < pattern.size(); pos++) {
+        shape += pattern[pos];
+        if (pattern[pos] == '{') {
+            while (pos + 1 < pattern.size() && pattern[pos + 1] != ':' && pattern[pos + 1] != '*' &&
+                   pattern[pos + 1] != '}') {
+                pos++;
             }
         }
-        
-        out_vars[var_name] = value;
     }
-    
-    return true;
+    return shape;
 }
 
-HttpServer::RoutePattern::RoutePattern(const std::string& pattern) : pattern(pattern) {
-    std::string regex_pattern;
-    size_t pos = 0;
-    
-    while (pos < pattern.length()) {
-        if (pattern[pos] == '{') {
-            size_t end_pos = pattern.find('}', pos);
-            if (end_pos == std::string::npos) {
-                throw ServerException("Invalid pattern: unclosed parameter bracket");
-            }
-            
-            std::string param = pattern.substr(pos + 1, end_pos - pos - 1);
-            size_t colon_pos = param.find(':');
-            
-            std::string var_name;
-            std::string var_type;
-            
-            if (colon_pos != std::string::npos) {
-                var_name = param.substr(0, colon_pos);
-                var_type = param.substr(colon_pos + 1);
-            } else {
-                var_name = param;
-                var_type = "string";
-            }
-            
-            if (!std::regex_match(var_name, std::regex("^[a-zA-Z_][a-zA-Z0-9_]*$"))) {
-                throw ServerException("Invalid variable name: " + var_name);
-            }
-            
-            vars.emplace_back(var_name, var_type);
-            
-            if (var_type == "int") {
-                regex_pattern += "([0-9]+)";
-            } else if (var_type == "string") {
-                regex_pattern += "([^/]+)";
-            } else {
-                throw ServerException("Unsupported variable type: " + var_type);
-            }
-            
-            pos = end_pos + 1;
-        } else {
-            if (std::string("{}[]()^$.|*+?\\").find(pattern[pos]) != std::string::npos) {
-                regex_pattern += '\\';
-            }
-            regex_pattern += pattern[pos];
-            pos++;
+static std::string allowHeader(uint32_t methods) {
+    std::string allow;
+    for (size_t i = 0; i < HTTP_METHOD_COUNT; i++) {
+        HttpMethod method = static_cast<HttpMethod>(i);
+        if (methods & httpMethodBit(method)) {
+            if (!allow.empty()) allow += ", ";
+            allow += httpMethodName(method);
         }
     }
-    
-    regex = std::regex("^" + regex_pattern + "$");
+    return allow;
 }
 
-bool HttpServer::matchRoute(const std::string& method, const std::string& path, HttpContext& ctx, AnyRouteHandler& matched_handler) {
-    auto method_it = routes_.find(method);
-    if (method_it != routes_.end()) {
-        auto route_it = method_it->second.find(path);
-        if (route_it != method_it->second.end()) {
-            matched_handler = route_it->second;
-            return true;
-        }
+void HttpServer::addHandler(uint32_t methods, const std::string& path, std::unique_ptr<StoredHandler> handler) {
+    if (frozen_) {
+        throw ServerException("Routes cannot be added after the server has started: " + path);
     }
-    
-    auto pattern_method_it = pattern_routes_.find(method);
-    if (pattern_method_it != pattern_routes_.end()) {
-        for (const auto& [pattern, handler] : pattern_method_it->second) {
-            if (pattern.match(path, ctx.path_vars.vars_)) {
-                matched_handler = handler;
-                return true;
+
+    try {
+        for (size_t i = 0; i < HTTP_METHOD_COUNT; i++) {
+            if (methods & httpMethodBit(static_cast<HttpMethod>(i))) {
+                routes_[i].add(path, handlers_.size());
             }
         }
+    } catch (const Router::Error& e) {
+        throw ServerException(e.what());
     }
-    
-    return false;
+    handlers_.push_back(std::move(handler));
+
+    auto& [pattern, registered] = pattern_methods_[patternShape(path)];
+    pattern = path;
+    registered |= methods;
 }
 
-void HttpServer::handleConnection(socket_t connfd) {
-    if (Config::KEEP_ALIVE_ENABLED) {
-        handleKeepAliveConnection(connfd);
-        return;
+void HttpServer::addMiddleware(std::unique_ptr<MiddlewareLayer> layer) {
+    if (frozen_) {
+        throw ServerException("Middleware cannot be added after the server has started");
+    }
+    layer->server = this;
+    MiddlewareLayer* added = layer.get();
+    if (lastLayer_) {
+        lastLayer_->next = std::move(layer);
+    } else {
+        pipeline_ = std::move(layer);
     }
+    lastLayer_ = added;
+}
 
-    HttpContext ctx(connfd);
-    try {
-        if (!ctx.req.readRequest()) {
-            ctx.res.setStatus(HttpStatus::BAD_REQUEST);
-            ctx.res.setBody("Bad Request\n");
-            sendResponse(ctx.res);
-            return;
-        }
+void HttpServer::freezeRoutes() {
+    if (frozen_) return;
 
-        const auto& method = ctx.req.method;
-        const auto& path = ctx.req.path;
+    for (const auto& [shape, entry] : pattern_methods_) {
+        allowed_.add(entry.first, entry.second);
+    }
+    pattern_methods_.clear();
+    frozen_ = true;
+}
 
-        std::cout << method << " " << path << " " << ctx.req.version << std::endl;
+EventChannel& HttpServer::sse(const std::string& path, std::function<bool(HttpContext&)> onConnect) {
+    // Store a new channel only once its route is registered; addHandler throws
+    // after run() and the map must not change under the running server
+    std::unique_ptr<EventChannel> created;
+    auto found = channels_.find(path);
+    if (found == channels_.end()) {
+        created = std::make_unique<EventChannel>(loop_);
+    }
 
-        if (path.length() > 1024) {
-            ctx.res.setStatus(HttpStatus::URI_TOO_LONG);
-            ctx.res.setBody("URI Too Long\n");
-            sendResponse(ctx.res);
+    EventChannel* target = created ? created.get() : found->second.get();
+    addRouteFromHandler(httpMethodBit(HttpMethod::GET), path, [target, onConnect](HttpContext& ctx) {
+        if (onConnect && !onConnect(ctx)) {
             return;
         }
+        target->subscribe(ctx);
+    });
 
-        if (method == "GET" && path.find("/" + Config::STATIC_DIR + "/") == 0) {
-            std::string file_path = Config::STATIC_DIR + path.substr(1 + Config::STATIC_DIR.length());
-            ctx.res = ctx.res.sendFile(file_path);
-            sendResponse(ctx.res);
+    if (created) {
+        channels_[path] = std::move(created);
+    }
+    return *target;
+}
+
+WebSocketChannel& HttpServer::websocket(const std::string& path, WebSocketHandlers handlers,
+                                        WebSocketCompression compression) {
+    auto channel = std::make_unique<WebSocketChannel>(loop_, std::move(handlers), compression);
+
+    WebSocketChannel* target = channel.get();
+    addRouteFromHandler(httpMethodBit(HttpMethod::GET), path, [target](HttpContext& ctx) {
+        target->accept(ctx);
+    });
+
+    // The route now points at the new channel, so a previous one for this
+    // path is unreachable and safe to replace. If registration threw, the
+    // old channel and the route that captures it are left untouched.
+    websockets_[path] = std::move(channel);
+    return *target;
+}
+
+const HttpServer::StoredHandler* HttpServer::matchRoute(HttpContext& ctx) const {
+    if (ctx.req.methodType == HttpMethod::UNKNOWN) {
+        return nullptr;
+    }
+
+    const Router& router = routes_[static_cast<size_t>(ctx.req.methodType)];
+    const Router::Route* route = router.match(ctx.req.path, ctx.path_vars.params_);
+    if (!route) {
+        return nullptr;
+    }
+
+    ctx.path_vars.names_ = &route->names;
+    return handlers_[route->value].get();
+}
+
+uint32_t HttpServer::allowedMethods(const std::string& path) const {
+    Router::Params params;
+    const Router::Route* route = allowed_.match(path, params);
+    return route ? static_cast<uint32_t>(route->value) : 0;
+}
+
+void HttpServer::dispatchRequest(HttpContext& ctx) {
+    const auto& path = ctx.req.path;
+
+    std::cout << ctx.req.method << " " << path << " " << ctx.req.version << std::endl;
+
+    if (path.length() > 1024) {
+        ctx.res.setStatus(HttpStatus::URI_TOO_LONG);
+        ctx.res.setBody("URI Too Long\n");
+        return;
+    }
+
+    ctx.background = &background_;
+    try {
+        if (pipeline_) {
+            pipeline_->run(ctx);
+        } else {
+            runBuiltins(ctx);
+        }
+    } catch (const std::exception& e) {
+        if (ctx.res.streamState == HttpResponse::StreamState::Started) {
+            // nothing was sent yet, so the error can still be the response
+            ctx.res.streamState = HttpResponse::StreamState::None;
+        } else if (ctx.res.isStreamed()) {
+            // part of the body is already on the wire; the connection is unusable
             return;
         }
+        ctx.res.setStatus(HttpStatus::INTERNAL_SERVER_ERROR);
+        ctx.res.setBody(std::string(e.what()) + "\n");
+    }
+}
 
-        if (Config::HEALTH_CHECK_ENABLED) {
-            if (method == "GET" && path == "/health") {
-                ctx.res.setStatus(HttpStatus::OK);
-                ctx.res.setBody("OK\n");
-                sendResponse(ctx.res);
-                return;
-            }
+void HttpServer::routeRequest(HttpContext& ctx) const {
+    uint32_t allowed = 0;
+    if (static_dispatch_ && static_dispatch_(static_table_, ctx, allowed)) {
+        return;
+    }
+
+    const StoredHandler* handler = matchRoute(ctx);
+    if (!handler) {
+        allowed |= allowedMethods(ctx.req.path);
+        if (allowed) {
+            ctx.res.setStatus(HttpStatus::METHOD_NOT_ALLOWED);
+            ctx.res.setHeader("Allow", allowHeader(allowed));
+            ctx.res.setBody("Method Not Allowed\n");
+        } else {
+            ctx.res.setStatus(HttpStatus::NOT_FOUND);
+            ctx.res.setBody("Not Found\n");
         }
+        return;
+    }
 
-        AnyRouteHandler handler;
-        if (!matchRoute(method, path, ctx, handler)) {
-            if (routes_.find(method) == routes_.end()) {
-                ctx.res.setStatus(HttpStatus::METHOD_NOT_ALLOWED);
-                ctx.res.setBody("Method Not Allowed\n");
-            } else {
-                ctx.res.setStatus(HttpStatus::NOT_FOUND);
-                ctx.res.setBody("Not Found\n");
-            }
+    (*handler)(ctx);
+}
+
+bool HttpServer::serveHttp2(HttpContext& ctx) {
+    if (!Config::HTTP2_ENABLED) return false;
+
+    bool preface = Http2Connection::isPreface(ctx.req);
+    if (!preface && !Http2Connection::isUpgradeRequest(ctx.req)) return false;
+
+    Http2Connection connection(ctx.res.getConnfd(), [this, &ctx](HttpContext& stream) {
+        stream.peer = ctx.peer;
+        Compression::BusyScope busy;
+        dispatchRequest(stream);
+    }, running_);
+
+    if (preface) {
+        connection.serve(ctx.req);
+    } else {
+        connection.serveUpgrade(ctx.req);
+    }
+    return true;
+}
+
+void HttpServer::handleConnection(socket_t connfd, const PeerAddress& peer) {
+    if (Config::KEEP_ALIVE_ENABLED) {
+        handleKeepAliveConnection(connfd, peer);
+        return;
+    }
+
+    HttpContext ctx(connfd);
+    ctx.peer = peer;
+    try {
+        if (!ctx.req.readRequest()) {
+            ctx.res.setStatus(HttpStatus::BAD_REQUEST);
+            ctx.res.setBody("Bad Request\n");
             sendResponse(ctx.res);
+            closeSocket(connfd);
             return;
         }
 
-        try {
-            handler(ctx);
-        } catch (const std::exception& e) {
-            ctx.res.setStatus(HttpStatus::INTERNAL_SERVER_ERROR);
-            ctx.res.setBody(std::string(e.what()) + "\n");
+        if (serveHttp2(ctx)) {
+            closeSocket(connfd);
+            return;
         }
 
+        Compression::BusyScope busy;
+        dispatchRequest(ctx);
+        if (ctx.res.isDetached()) return;
         sendResponse(ctx.res);
 
     } catch (const std::exception& e) {
@@ -314,9 +518,11 @@ void HttpServer::handleConnection(socket_t connfd) {
             std::cerr << "Failed to send error response: " << e2.what() << std::endl;
         }
     }
+
+    closeSocket(connfd);
 }
 
-void HttpServer::handleKeepAliveConnection(socket_t connfd) {
+void HttpServer::handleKeepAliveConnection(socket_t connfd, const PeerAddress& peer) {
     int request_count = 0;
     time_t last_activity = time(nullptr);
 
@@ -347,6 +553,7 @@ void HttpServer::handleKeepAliveConnection(socket_t connfd) {
         }
 
         HttpContext ctx(connfd);
+        ctx.peer = peer;
 
         try {
             if (!ctx.req.readRequest()) {
@@ -355,41 +562,22 @@ void HttpServer::handleKeepAliveConnection(socket_t connfd) {
 
             last_activity = time(nullptr);
 
-            const auto& method = ctx.req.method;
-            const auto& path = ctx.req.path;
-
-            std::cout << method << " " << path << " " << ctx.req.version << std::endl;
-
-            AnyRouteHandler handler;
-            if (!matchRoute(method, path, ctx, handler)) {
-                if (routes_.find(method) == routes_.end()) {
-                    ctx.res.setStatus(HttpStatus::METHOD_NOT_ALLOWED);
-                    ctx.res.setBody("Method Not Allowed\n");
-                } else {
-                    ctx.res.setStatus(HttpStatus::NOT_FOUND);
-                    ctx.res.setBody("Not Found\n");
-                }
-                sendResponse(ctx.res);
-                
-                request_count++;
-                
-                if (ctx.req.headers.get("Connection", "") != "keep-alive") {
-                    break;
-                }
-                continue;
-            }
-
-            try {
-                handler(ctx);
-            } catch (const std::exception& e) {
-                ctx.res.setStatus(HttpStatus::INTERNAL_SERVER_ERROR);
-                ctx.res.setBody(std::string(e.what()) + "\n");
+            if (serveHttp2(ctx)) {
+                break;
             }
 
+            Compression::BusyScope busy;
+            dispatchRequest(ctx);
+            if (ctx.res.isDetached()) return;
             sendResponse(ctx.res);
 
             request_count++;
 
+            if (ctx.res.isStreamed() &&
+                (!ctx.res.isStreamComplete() || ctx.req.version == "HTTP/1.0")) {
+                break;
+            }
+
             if (ctx.req.headers.get("Connection", "") != "keep-alive") {
                 break;
             }
@@ -410,28 +598,11 @@ void HttpServer::handleKeepAliveConnection(socket_t connfd) {
 }
 
 void HttpServer::sendResponse(HttpResponse& response) {
-    std::string response_str = response.toString();
-    size_t total_sent = 0;
-    const char* data = response_str.c_str();
-    size_t remaining = response_str.length();
-
-    while (total_sent < response_str.length()) {
-        int sent = send(response.getConnfd(), 
-                       data + total_sent, 
-                       static_cast<int>(remaining), 
-                       0);
-        
-        if (sent == SOCKET_ERROR) {
-#ifdef _WIN32
-            if (WSAGetLastError() == WSAEINTR) continue;
-#else
-            if (errno == EINTR) continue;
-#endif
-            throw ServerException("Failed to send response: " + getLastError());
-        }
+    if (response.isStreamed()) return;
 
-        total_sent += sent;
-        remaining -= sent;
+    std::string response_str = response.toString();
+    if (!Socket::sendAll(response.getConnfd(), response_str.data(), response_str.length())) {
+        throw ServerException("Failed to send response: " + getLastError());
     }
 }
 
@@ -503,6 +674,15 @@ void HttpServer::setupServer() {
 }
 
 void HttpServer::cleanup() {
+    for (auto& [path, channel] : channels_) {
+        channel->closeAll();
+    }
+    for (auto& [path, channel] : websockets_) {
+        channel->closeAll(1001, "Server shutting down");
+    }
+    loop_.stop();
+    background_.stop();
+
     if (sockfd_ != INVALID_SOCK) {
         closeSocket(sockfd_);
         sockfd_ = INVALID_SOCK;
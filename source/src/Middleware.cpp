@@ -0,0 +1,45 @@
+#include "Middleware.h"
+
+namespace Middleware {
+    std::string requestKey(const HttpContext& ctx, const std::vector<std::string>& queryParams,
+                           const std::vector<std::string>& headers) {
+        std::string key = ctx.req.method;
+        key += '\0';
+        key += ctx.req.path;
+        for (const std::string& name : queryParams) {
+            key += '\0';
+            if (ctx.req.params.has(name)) key += name + "=" + ctx.req.params[name];
+        }
+        for (const std::string& name : headers) {
+            key += '\0';
+            if (ctx.req.headers.has(name)) key += name + ":" + ctx.req.headers[name];
+        }
+        return key;
+    }
+
+    bool StaticFiles::serve(HttpContext& ctx) const {
+        const std::string& path = ctx.req.path;
+        if (ctx.req.methodType != HttpMethod::GET || path.compare(0, prefix_.length(), prefix_) != 0) {
+            return false;
+        }
+
+        if (path.find("..") != std::string::npos) {
+            ctx.res.setStatus(HttpStatus::NOT_FOUND);
+            ctx.res.setBody("Not Found\n");
+            return true;
+        }
+
+        ctx.res.sendFile(directory_ + "/" + path.substr(prefix_.length()));
+        return true;
+    }
+
+    bool HealthCheck::serve(HttpContext& ctx) const {
+        if (path_.empty() || ctx.req.methodType != HttpMethod::GET || ctx.req.path != path_) {
+            return false;
+        }
+
+        ctx.res.setStatus(HttpStatus::OK);
+        ctx.res.setBody("OK\n");
+        return true;
+    }
+}
@@ -1,5 +1,34 @@
+#include <cctype>
+
 #include "MimeType.h"
 
+static_assert(mimeTypeForExtension(".css") != nullptr, "MIME table is missing .css");
+
+const char* mimeTypeForPath(const std::string& path) {
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos || path.find_first_of("/\\", dot) != std::string::npos) {
+        return nullptr;
+    }
+
+    char ext[16];
+    size_t length = path.length() - dot;
+    if (length >= sizeof(ext)) return nullptr;
+
+    for (size_t i = 0; i < length; i++) {
+        ext[i] = static_cast<char>(std::tolower(static_cast<unsigned char>(path[dot + i])));
+    }
+    return mimeTypeForExtension(std::string_view(ext, length));
+}
+
+const char* sniffMimeType(const unsigned char* data, size_t length) {
+    for (const auto& signature : MIME_TYPES) {
+        if (signature.magicSize > 0 && checkMimeType(data, length, signature)) {
+            return signature.mimeType;
+        }
+    }
+    return nullptr;
+}
+
 bool checkMimeType(const unsigned char* data, size_t length, const MimeType& signature) {
     if (length < signature.magicSize) return false;
     
@@ -0,0 +1,142 @@
+#include <atomic>
+#include <mutex>
+#include <cmath>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+#include <functional>
+#include <shared_mutex>
+#include <unordered_map>
+
+#include "RateLimiter.h"
+
+namespace Middleware {
+    struct RateLimiter::State {
+        // Each bucket holds the time, in steady_clock nanoseconds, at which
+        // it is full again
+        struct alignas(64) Shard {
+            mutable std::shared_mutex mutex;
+            std::unordered_map<std::string, std::atomic<int64_t>> buckets;
+            std::atomic<int64_t> nextSweep{0};
+            size_t sweepCursor = 0; // next hash bucket to sweep, under mutex
+        };
+
+        int64_t interval; // nanoseconds per token
+        int64_t capacity; // nanoseconds to refill an empty bucket
+        int64_t ttl;
+        size_t mask;
+        std::unique_ptr<Shard[]> shards;
+
+        static int64_t now() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        // 0 once a token was taken, otherwise nanoseconds until one is free
+        int64_t take(std::atomic<int64_t>& full, int64_t time) const {
+            int64_t current = full.load(std::memory_order_relaxed);
+            for (;;) {
+                int64_t next = std::max(current, time) + interval;
+                if (next - time > capacity) {
+                    return next - time - capacity;
+                }
+                if (full.compare_exchange_weak(current, next, std::memory_order_relaxed)) {
+                    return 0;
+                }
+            }
+        }
+
+        // A bucket full for longer than ttl is the same as a new one. Each
+        // call sweeps at most RATE_LIMIT_SWEEP_BATCH hash buckets, so a
+        // pass over a large shard is spread across the requests that follow
+        void sweep(Shard& shard, int64_t time) const {
+            int64_t due = shard.nextSweep.load(std::memory_order_relaxed);
+            if (time < due || !shard.nextSweep.compare_exchange_strong(due, time + ttl, std::memory_order_relaxed)) {
+                return;
+            }
+
+            std::unique_lock<std::shared_mutex> lock(shard.mutex);
+            size_t count = shard.buckets.bucket_count();
+            size_t end = std::min(count, shard.sweepCursor + Config::RATE_LIMIT_SWEEP_BATCH);
+            std::vector<std::string> stale;
+            for (size_t i = shard.sweepCursor; i < end; i++) {
+                for (auto it = shard.buckets.begin(i); it != shard.buckets.end(i); ++it) {
+                    if (time - it->second.load(std::memory_order_relaxed) > ttl) {
+                        stale.push_back(it->first);
+                    }
+                }
+            }
+            for (const auto& key : stale) {
+                shard.buckets.erase(key);
+            }
+
+            // An unfinished pass goes on with the next request
+            shard.sweepCursor = end < count ? end : 0;
+            if (shard.sweepCursor != 0) {
+                shard.nextSweep.store(time, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    RateLimiter::RateLimiter(double rate, double burst)
+        : RateLimiter(Options{rate, burst}) {}
+
+    RateLimiter::RateLimiter(const Options& options) : state_(std::make_shared<State>()) {
+        if (!(options.rate > 0) || !(options.burst >= 1)) {
+            throw std::invalid_argument("RateLimiter: rate must be positive and burst at least 1");
+        }
+
+        size_t shards = 1;
+        while (shards < options.shards) shards <<= 1;
+
+        state_->interval = std::max<int64_t>(1, static_cast<int64_t>(1e9 / options.rate));
+        state_->capacity = static_cast<int64_t>(state_->interval * options.burst);
+        state_->ttl = std::chrono::duration_cast<std::chrono::nanoseconds>(options.ttl).count();
+        state_->mask = shards - 1;
+        state_->shards = std::make_unique<State::Shard[]>(shards);
+    }
+
+    std::chrono::nanoseconds RateLimiter::acquire(const std::string& key) const {
+        State& state = *state_;
+        State::Shard& shard = state.shards[std::hash<std::string>()(key) & state.mask];
+        int64_t time = State::now();
+
+        state.sweep(shard, time);
+
+        {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            auto it = shard.buckets.find(key);
+            if (it != shard.buckets.end()) {
+                return std::chrono::nanoseconds(state.take(it->second, time));
+            }
+        }
+
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.buckets.try_emplace(key, time).first;
+        return std::chrono::nanoseconds(state.take(it->second, time));
+    }
+
+    bool RateLimiter::admit(HttpContext& ctx) const {
+        std::chrono::nanoseconds wait = acquire(ctx.peer.ip);
+        if (wait.count() == 0) {
+            return true;
+        }
+
+        // Retry-After is in whole seconds, rounded up
+        auto seconds = std::max<int64_t>(1, static_cast<int64_t>(std::ceil(wait.count() / 1e9)));
+        ctx.res.setStatus(HttpStatus::TOO_MANY_REQUESTS);
+        ctx.res.setHeader("Retry-After", std::to_string(seconds));
+        ctx.res.setBody("Too Many Requests\n");
+        return false;
+    }
+
+    size_t RateLimiter::size() const {
+        size_t total = 0;
+        for (size_t i = 0; i <= state_->mask; i++) {
+            std::shared_lock<std::shared_mutex> lock(state_->shards[i].mutex);
+            total += state_->shards[i].buckets.size();
+        }
+        return total;
+    }
+}
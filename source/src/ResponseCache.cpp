@@ -0,0 +1,211 @@
+#include <list>
+#include <mutex>
+#include <cctype>
+#include <algorithm>
+#include <utility>
+#include <unordered_map>
+
+#include "Compression.h"
+#include "Middleware.h"
+#include "ResponseCache.h"
+
+namespace Middleware {
+    struct ResponseCache::State {
+        using Clock = std::chrono::steady_clock;
+
+        struct Entry {
+            std::string key;
+            std::string contentType;
+            std::vector<std::pair<Compression::Encoding, std::shared_ptr<const PreparedResponse>>> variants;
+            Clock::time_point freshUntil;
+            Clock::time_point staleUntil;
+            bool refreshing = false;
+            size_t bytes = 0;
+        };
+
+        struct alignas(64) Stripe {
+            std::mutex mutex;
+            std::list<Entry> lru; // most recently used first
+            std::unordered_map<std::string, std::list<Entry>::iterator> index;
+            size_t bytes = 0;
+        };
+
+        Options options;
+        size_t stripeCapacity;
+        std::unique_ptr<Stripe[]> stripes;
+
+        Stripe& stripeFor(const std::string& key) const {
+            return stripes[std::hash<std::string>()(key) % options.stripes];
+        }
+
+        static size_t sizeOf(const PreparedResponse& response) {
+            return response.head.size() + response.body.size();
+        }
+
+        void erase(Stripe& stripe, std::list<Entry>::iterator it) const {
+            stripe.bytes -= it->bytes;
+            stripe.index.erase(it->key);
+            stripe.lru.erase(it);
+        }
+    };
+
+    static ResponseCache::Options withTimes(std::chrono::milliseconds ttl, std::chrono::milliseconds staleWhileRevalidate) {
+        ResponseCache::Options options;
+        options.ttl = ttl;
+        options.staleWhileRevalidate = staleWhileRevalidate;
+        return options;
+    }
+
+    ResponseCache::ResponseCache(std::chrono::milliseconds ttl, std::chrono::milliseconds staleWhileRevalidate)
+        : ResponseCache(withTimes(ttl, staleWhileRevalidate)) {}
+
+    ResponseCache::ResponseCache(const Options& options) : state_(std::make_shared<State>()) {
+        state_->options = options;
+        if (state_->options.stripes == 0) state_->options.stripes = 1;
+        state_->stripeCapacity = options.maxBytes / state_->options.stripes;
+        state_->stripes = std::make_unique<State::Stripe[]>(state_->options.stripes);
+    }
+
+    ResponseCache::Result ResponseCache::lookup(HttpContext& ctx, std::string& key) const {
+        if (ctx.req.methodType != HttpMethod::GET) {
+            return Result::Bypass;
+        }
+
+        key = requestKey(ctx, state_->options.queryParams, state_->options.headers);
+
+        State::Stripe& stripe = state_->stripeFor(key);
+        auto now = State::Clock::now();
+        std::shared_ptr<const PreparedResponse> response;
+        Result result = Result::Hit;
+        {
+            std::lock_guard<std::mutex> lock(stripe.mutex);
+            auto found = stripe.index.find(key);
+            if (found == stripe.index.end()) {
+                return Result::Miss;
+            }
+
+            State::Entry& entry = *found->second;
+            stripe.lru.splice(stripe.lru.begin(), stripe.lru, found->second);
+            if (now >= entry.staleUntil) {
+                return Result::Miss;
+            }
+
+            auto encoding = Compression::negotiate(ctx.req.headers.get("Accept-Encoding", ""), entry.contentType);
+            for (const auto& [variantEncoding, variant] : entry.variants) {
+                if (variantEncoding == encoding) response = variant;
+            }
+            if (!response) {
+                return Result::Miss;
+            }
+
+            if (now >= entry.freshUntil && !entry.refreshing) {
+                entry.refreshing = true;
+                result = Result::Refresh;
+            }
+        }
+
+        ctx.res.setPrepared(std::move(response));
+        return result;
+    }
+
+    void ResponseCache::store(HttpContext& ctx, const std::string& key, bool refresh) const {
+        HttpResponse& res = ctx.res;
+        std::string cacheControl = res.getHeader("Cache-Control");
+        std::transform(cacheControl.begin(), cacheControl.end(), cacheControl.begin(), ::tolower);
+        bool cacheable = !res.isStreamed() && !res.isDetached() && res.getStatus() == HttpStatus::OK &&
+                         res.getHeader("Set-Cookie").empty() &&
+                         cacheControl.find("no-store") == std::string::npos &&
+                         cacheControl.find("private") == std::string::npos;
+
+        std::shared_ptr<const PreparedResponse> response;
+        if (cacheable) {
+            response = res.serialize();
+            // a conditional request may have turned it into a 304
+            cacheable = response->status == HttpStatus::OK && State::sizeOf(*response) <= state_->stripeCapacity;
+        }
+
+        State::Stripe& stripe = state_->stripeFor(key);
+        auto now = State::Clock::now();
+        {
+            std::lock_guard<std::mutex> lock(stripe.mutex);
+            auto found = stripe.index.find(key);
+            if (found != stripe.index.end() && refresh) {
+                found->second->refreshing = false;
+            }
+            if (!cacheable) {
+                return;
+            }
+
+            if (found == stripe.index.end()) {
+                stripe.lru.emplace_front();
+                stripe.lru.front().key = key;
+                found = stripe.index.emplace(key, stripe.lru.begin()).first;
+            } else {
+                stripe.lru.splice(stripe.lru.begin(), stripe.lru, found->second);
+            }
+
+            State::Entry& entry = *found->second;
+            std::string contentType = res.getHeader("Content-Type");
+            if (refresh || now >= entry.freshUntil || entry.contentType != contentType) {
+                // New content replaces every variant of the old
+                entry.variants.clear();
+                entry.contentType = contentType;
+                entry.freshUntil = now + state_->options.ttl;
+                entry.staleUntil = entry.freshUntil + state_->options.staleWhileRevalidate;
+            }
+
+            auto encoding = Compression::negotiate(ctx.req.headers.get("Accept-Encoding", ""), contentType);
+            bool replaced = false;
+            for (auto& [variantEncoding, variant] : entry.variants) {
+                if (variantEncoding == encoding) {
+                    variant = response;
+                    replaced = true;
+                }
+            }
+            if (!replaced) {
+                entry.variants.emplace_back(encoding, response);
+            }
+
+            stripe.bytes -= entry.bytes;
+            entry.bytes = key.size();
+            for (const auto& variant : entry.variants) {
+                entry.bytes += State::sizeOf(*variant.second);
+            }
+            stripe.bytes += entry.bytes;
+
+            while (stripe.bytes > state_->stripeCapacity && stripe.lru.size() > 1) {
+                state_->erase(stripe, std::prev(stripe.lru.end()));
+            }
+        }
+
+        // Sent as serialized rather than serialized again
+        res.setPrepared(std::move(response));
+    }
+
+    void ResponseCache::endRefresh(const std::string& key) const {
+        State::Stripe& stripe = state_->stripeFor(key);
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        auto found = stripe.index.find(key);
+        if (found != stripe.index.end()) {
+            found->second->refreshing = false;
+        }
+    }
+
+    size_t ResponseCache::size() const {
+        size_t total = 0;
+        for (size_t i = 0; i < state_->options.stripes; i++) {
+            std::lock_guard<std::mutex> lock(state_->stripes[i].mutex);
+            total += state_->stripes[i].lru.size();
+        }
+        return total;
+    }
+
+    size_t ResponseCache::bytes() const {
+        size_t total = 0;
+        for (size_t i = 0; i < state_->options.stripes; i++) {
+            std::lock_guard<std::mutex> lock(state_->stripes[i].mutex);
+            total += state_->stripes[i].bytes;
+        }
+        return total;
+    }
+}
@@ -0,0 +1,127 @@
+#include <cstdio>
+
+#include "Socket.h"
+#include "ResponseWriter.h"
+
+ResponseWriter::ResponseWriter(HttpResponse& res, size_t flushThreshold)
+    : res(res), flushThreshold(flushThreshold), written(0),
+      headSent(false), ended(false), failed(false) {
+    chunked = !res.sink && res.req->version != "HTTP/1.0";
+    res.streamState = HttpResponse::StreamState::Started;
+    if (!res.sink) {
+        Socket::setSendTimeout(res.getConnfd(), Config::SOCKET_TIMEOUT);
+    }
+}
+
+ResponseWriter& ResponseWriter::write(const char* data, size_t length) {
+    if (failed || ended || length == 0) return *this;
+
+    buffer.append(data, length);
+    written += length;
+
+    if (buffer.length() >= flushThreshold) {
+        emit(Compression::EncoderStream::Flush::None);
+    }
+    return *this;
+}
+
+ResponseWriter& ResponseWriter::write(const std::string& data) {
+    return write(data.data(), data.length());
+}
+
+bool ResponseWriter::sendRaw(const std::string& data) {
+    if (failed) return false;
+    if (!Socket::sendAll(res.getConnfd(), data.data(), data.length())) {
+        failed = true;
+    }
+    return !failed;
+}
+
+bool ResponseWriter::sendHead(bool finishing) {
+    if (headSent) return true;
+    headSent = true;
+    res.streamState = HttpResponse::StreamState::Streaming;
+
+    auto contentType = res.headers.find("Content-Type");
+    bool compress = contentType != res.headers.end() &&
+        Compression::isCompressible(contentType->second) &&
+        res.headers.find("Content-Encoding") == res.headers.end() &&
+        !(finishing && buffer.length() < Compression::policy().minSize);
+
+    if (compress) {
+        Compression::Encoding encoding = Compression::negotiate(
+            res.req->headers.get("Accept-Encoding", ""), contentType->second);
+        if (encoding != Compression::Encoding::Identity) {
+            encoder = Compression::makeStream(encoding,
+                Compression::chooseLevel(contentType->second, buffer.length()));
+            res.headers["Content-Encoding"] = Compression::encodingName(encoding);
+            res.headers["Vary"] = "Accept-Encoding";
+        }
+    }
+
+    if (res.sink) {
+        if (!res.sink->sendHeaders(res, false)) failed = true;
+        return !failed;
+    }
+
+    if (!chunked) {
+        // HTTP/1.0 has no chunked coding; the body ends when we close
+        res.headers["Connection"] = "close";
+    }
+    return sendRaw(res.headerBlock(chunked));
+}
+
+bool ResponseWriter::emit(Compression::EncoderStream::Flush flush) {
+    if (failed || ended) return false;
+    if (!sendHead(flush == Compression::EncoderStream::Flush::Finish)) return false;
+
+    std::string payload;
+    if (encoder) {
+        try {
+            encoder->write(buffer.data(), buffer.length(), payload, flush);
+        } catch (const std::exception&) {
+            failed = true;
+            return false;
+        }
+    } else {
+        payload.swap(buffer);
+    }
+    buffer.clear();
+
+    if (payload.empty()) return true;
+
+    if (res.sink) {
+        if (!res.sink->sendData(payload.data(), payload.length(), false)) failed = true;
+        return !failed;
+    }
+
+    if (chunked) {
+        char size[20];
+        int n = std::snprintf(size, sizeof(size), "%zx\r\n", payload.length());
+        payload.insert(0, size, n);
+        payload.append("\r\n");
+    }
+    return sendRaw(payload);
+}
+
+bool ResponseWriter::flush() {
+    return emit(Compression::EncoderStream::Flush::Sync);
+}
+
+bool ResponseWriter::end() {
+    if (ended) return !failed;
+
+    bool ok = emit(Compression::EncoderStream::Flush::Finish);
+    if (ok && res.sink) {
+        ok = res.sink->sendData(nullptr, 0, true);
+        if (!ok) failed = true;
+    } else if (ok && chunked) {
+        ok = sendRaw("0\r\n\r\n");
+    }
+
+    ended = true;
+    if (ok) {
+        res.streamState = HttpResponse::StreamState::Finished;
+    }
+    return ok;
+}
@@ -0,0 +1,336 @@
+#include <map>
+#include <cctype>
+#include <charconv>
+
+#include "Router.h"
+
+struct Router::Node {
+    std::string prefix;  // static text consumed on entry, empty for variables
+    std::string indices; // first character of each static child
+    std::vector<std::unique_ptr<Node>> children;
+    std::vector<std::unique_ptr<Node>> variables; // in match priority order
+    Route* route = nullptr;    // a pattern ends here
+    Route* wildcard = nullptr; // a pattern ends here with a wildcard
+
+    // Variable nodes
+    bool variable = false;
+    VarType type = VarType::String;
+    std::string typeName;                // Custom
+    const Validator* validate = nullptr; // Custom
+    bool inlineSuffix = false;           // followed by text other than '/', as in {name}.json
+
+    Node* addStatic(std::string_view text);
+    Node* addVariable(VarType type, const std::string& typeName);
+    const Route* match(std::string_view path, size_t pos, Params& params) const;
+    const Route* matchVariable(std::string_view path, size_t pos, Params& params) const;
+    bool parse(std::string_view value, Param& param) const;
+};
+
+namespace {
+    std::map<std::string, Router::Validator>& customTypes() {
+        static std::map<std::string, Router::Validator> types;
+        return types;
+    }
+
+    struct Token {
+        enum class Kind { Static, Variable, Wildcard };
+        Kind kind;
+        std::string text; // Static: the text, Variable: the custom type name
+        Router::VarType type = Router::VarType::String;
+    };
+
+    bool isValidName(const std::string& name) {
+        if (name.empty() || (!std::isalpha(static_cast<unsigned char>(name[0])) && name[0] != '_')) {
+            return false;
+        }
+        for (char c : name) {
+            if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_') return false;
+        }
+        return true;
+    }
+
+    Router::VarType parseType(const std::string& type) {
+        if (type == "string") return Router::VarType::String;
+        if (type == "int") return Router::VarType::Int;
+        if (type == "int64") return Router::VarType::Int64;
+        if (type == "uint") return Router::VarType::Uint;
+        if (type == "uuid") return Router::VarType::Uuid;
+        if (customTypes().count(type)) return Router::VarType::Custom;
+        throw Router::Error("Unsupported variable type: " + type);
+    }
+
+    std::vector<Token> parsePattern(const std::string& pattern, std::vector<std::string>& names) {
+        std::vector<Token> tokens;
+        size_t pos = 0;
+
+        while (pos < pattern.length()) {
+            if (!tokens.empty() && tokens.back().kind == Token::Kind::Wildcard) {
+                throw Router::Error("Invalid pattern: wildcard must be last: " + pattern);
+            }
+
+            if (pattern[pos] == '{') {
+                size_t end_pos = pattern.find('}', pos);
+                if (end_pos == std::string::npos) {
+                    throw Router::Error("Invalid pattern: unclosed parameter bracket");
+                }
+                if (!tokens.empty() && tokens.back().kind != Token::Kind::Static) {
+                    throw Router::Error("Invalid pattern: adjacent path variables: " + pattern);
+                }
+
+                std::string param = pattern.substr(pos + 1, end_pos - pos - 1);
+                Token token{Token::Kind::Variable, ""};
+                size_t colon_pos = param.find(':');
+                if (colon_pos != std::string::npos) {
+                    token.text = param.substr(colon_pos + 1);
+                    token.type = parseType(token.text);
+                    param.resize(colon_pos);
+                    if (token.type != Router::VarType::Custom) token.text.clear();
+                } else if (!param.empty() && param.back() == '*') {
+                    param.pop_back();
+                    token.kind = Token::Kind::Wildcard;
+                }
+
+                if (!isValidName(param)) {
+                    throw Router::Error("Invalid variable name: " + param);
+                }
+
+                names.push_back(param);
+                tokens.push_back(token);
+                pos = end_pos + 1;
+            } else if (pattern[pos] == '*' && pos + 1 == pattern.length()) {
+                names.push_back("*");
+                tokens.push_back({Token::Kind::Wildcard, ""});
+                pos++;
+            } else if (pattern[pos] == '}') {
+                throw Router::Error("Invalid pattern: unmatched '}': " + pattern);
+            } else {
+                if (tokens.empty() || tokens.back().kind != Token::Kind::Static) {
+                    tokens.push_back({Token::Kind::Static, ""});
+                }
+                tokens.back().text += pattern[pos];
+                pos++;
+            }
+        }
+
+        if (names.size() > Config::MAX_PATH_VARS) {
+            throw Router::Error("Too many path variables: " + pattern);
+        }
+        return tokens;
+    }
+
+    // The whole of value as T; fails on anything else, including overflow
+    template <typename T>
+    bool parseNumber(std::string_view value, T& out) {
+        auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), out);
+        return ec == std::errc() && end == value.data() + value.size();
+    }
+
+    bool isUuid(std::string_view value) {
+        if (value.size() != 36) return false;
+        for (size_t i = 0; i < value.size(); i++) {
+            if (i == 8 || i == 13 || i == 18 || i == 23) {
+                if (value[i] != '-') return false;
+            } else if (!std::isxdigit(static_cast<unsigned char>(value[i]))) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+void Router::defineType(const std::string& name, Validator validate) {
+    if (!isValidName(name) || name == "string" || name == "int" || name == "int64" ||
+        name == "uint" || name == "uuid") {
+        throw Error("Invalid variable type name: " + name);
+    }
+    customTypes()[name] = std::move(validate);
+}
+
+Router::Router() : root(std::make_unique<Node>()) {}
+Router::~Router() = default;
+Router::Router(Router&&) noexcept = default;
+Router& Router::operator=(Router&&) noexcept = default;
+
+Router::Node* Router::Node::addStatic(std::string_view text) {
+    Node* node = this;
+
+    while (!text.empty()) {
+        size_t index = node->indices.find(text[0]);
+        if (index == std::string::npos) {
+            auto child = std::make_unique<Node>();
+            child->prefix = std::string(text);
+            if (node->variable && text[0] != '/') {
+                node->inlineSuffix = true;
+            }
+            node->indices += text[0];
+            node->children.push_back(std::move(child));
+            return node->children.back().get();
+        }
+
+        std::unique_ptr<Node>& child = node->children[index];
+        size_t common = 0;
+        while (common < child->prefix.size() && common < text.size() && child->prefix[common] == text[common]) {
+            common++;
+        }
+
+        // Split the edge where the new text diverges
+        if (common < child->prefix.size()) {
+            auto split = std::make_unique<Node>();
+            split->prefix = child->prefix.substr(0, common);
+            child->prefix.erase(0, common);
+            split->indices += child->prefix[0];
+            split->children.push_back(std::move(child));
+            child = std::move(split);
+        }
+
+        node = child.get();
+        text.remove_prefix(common);
+    }
+
+    return node;
+}
+
+Router::Node* Router::Node::addVariable(VarType type, const std::string& typeName) {
+    auto it = variables.begin();
+    for (; it != variables.end(); ++it) {
+        const Node& existing = **it;
+        if (existing.type == type && existing.typeName == typeName) return it->get();
+        if (existing.type > type || (existing.type == type && existing.typeName > typeName)) break;
+    }
+
+    auto node = std::make_unique<Node>();
+    node->variable = true;
+    node->type = type;
+    node->typeName = typeName;
+    if (type == VarType::Custom) {
+        node->validate = &customTypes().at(typeName);
+    }
+    return variables.insert(it, std::move(node))->get();
+}
+
+void Router::add(const std::string& pattern, size_t value) {
+    std::vector<std::string> names;
+    std::vector<Token> tokens = parsePattern(pattern, names);
+
+    Node* node = root.get();
+    Route** slot = &node->route;
+    for (const Token& token : tokens) {
+        switch (token.kind) {
+            case Token::Kind::Static:
+                node = node->addStatic(token.text);
+                slot = &node->route;
+                break;
+            case Token::Kind::Variable:
+                node = node->addVariable(token.type, token.text);
+                slot = &node->route;
+                break;
+            case Token::Kind::Wildcard:
+                slot = &node->wildcard;
+                break;
+        }
+    }
+
+    // Patterns differing only in variable names share a slot; the last one wins
+    if (*slot) {
+        **slot = Route{pattern, std::move(names), value};
+        return;
+    }
+
+    routes.push_back(std::make_unique<Route>(Route{pattern, std::move(names), value}));
+    *slot = routes.back().get();
+}
+
+const Router::Route* Router::match(std::string_view path, Params& params) const {
+    params.count = 0;
+    return root->match(path, 0, params);
+}
+
+const Router::Route* Router::Node::match(std::string_view path, size_t pos, Params& params) const {
+    if (pos == path.size()) {
+        if (route) return route;
+        if (wildcard) {
+            params.values[params.count++] = Param{path.substr(pos), VarType::Wildcard};
+            return wildcard;
+        }
+        return nullptr;
+    }
+
+    size_t index = indices.find(path[pos]);
+    if (index != std::string::npos) {
+        const Node* child = children[index].get();
+        if (path.compare(pos, child->prefix.size(), child->prefix) == 0) {
+            if (const Route* found = child->match(path, pos + child->prefix.size(), params)) {
+                return found;
+            }
+        }
+    }
+
+    for (const auto& next : variables) {
+        if (const Route* found = next->matchVariable(path, pos, params)) {
+            return found;
+        }
+    }
+
+    if (wildcard) {
+        params.values[params.count++] = Param{path.substr(pos), VarType::Wildcard};
+        return wildcard;
+    }
+    return nullptr;
+}
+
+const Router::Route* Router::Node::matchVariable(std::string_view path, size_t pos, Params& params) const {
+    size_t end = path.find('/', pos);
+    if (end == std::string_view::npos) end = path.size();
+
+    // Numbers end at the first non-digit, a uuid after 36 characters
+    size_t longest = end;
+    size_t shortest = inlineSuffix ? pos + 1 : end;
+    if (type == VarType::Int || type == VarType::Int64 || type == VarType::Uint) {
+        longest = pos;
+        if (type != VarType::Uint && longest < end && path[longest] == '-') longest++;
+        while (longest < end && path[longest] >= '0' && path[longest] <= '9') longest++;
+    } else if (type == VarType::Uuid) {
+        longest = shortest = pos + 36;
+    }
+    if (longest > end || (longest != end && !inlineSuffix)) return nullptr;
+
+    // With a suffix after the variable, the longest value the rest of the
+    // pattern still matches
+    size_t saved = params.count;
+    for (size_t valueEnd = longest; valueEnd >= shortest && valueEnd > pos; valueEnd--) {
+        Param& param = params.values[saved];
+        if (!parse(path.substr(pos, valueEnd - pos), param)) continue;
+
+        params.count = saved + 1;
+        if (const Route* found = match(path, valueEnd, params)) {
+            return found;
+        }
+    }
+
+    params.count = saved;
+    return nullptr;
+}
+
+bool Router::Node::parse(std::string_view value, Param& param) const {
+    param.value = value;
+    param.type = type;
+
+    switch (type) {
+        case VarType::Int: {
+            int number;
+            if (!parseNumber(value, number)) return false;
+            param.integer = number;
+            return true;
+        }
+        case VarType::Int64:
+            return parseNumber(value, param.integer);
+        case VarType::Uint:
+            return parseNumber(value, param.uinteger);
+        case VarType::Uuid:
+            return isUuid(value);
+        case VarType::Custom:
+            return (*validate)(value);
+        default:
+            return true;
+    }
+}
@@ -0,0 +1,122 @@
+#include <mutex>
+#include <utility>
+#include <functional>
+#include <unordered_map>
+#include <condition_variable>
+
+#include "Middleware.h"
+#include "SingleFlight.h"
+
+namespace Middleware {
+    struct SingleFlight::Flight {
+        std::string key;
+        std::mutex mutex;
+        std::condition_variable landed;
+        bool done = false;
+        std::shared_ptr<const PreparedResponse> response; // null if it cannot be shared
+    };
+
+    struct SingleFlight::State {
+        struct alignas(64) Shard {
+            std::mutex mutex;
+            std::unordered_map<std::string, std::shared_ptr<Flight>> flights;
+        };
+
+        Options options;
+        std::unique_ptr<Shard[]> shards;
+
+        Shard& shardFor(const std::string& key) const {
+            return shards[std::hash<std::string>()(key) % options.shards];
+        }
+    };
+
+    SingleFlight::SingleFlight() : SingleFlight(Options()) {}
+
+    SingleFlight::SingleFlight(const Options& options) : state_(std::make_shared<State>()) {
+        state_->options = options;
+        if (state_->options.shards == 0) state_->options.shards = 1;
+        state_->shards = std::make_unique<State::Shard[]>(state_->options.shards);
+    }
+
+    SingleFlight::Role SingleFlight::join(HttpContext& ctx, std::shared_ptr<Flight>& flight) const {
+        // A partial response would be no use to anyone else
+        if (ctx.req.methodType != HttpMethod::GET || ctx.req.headers.has("Range")) {
+            return Role::Alone;
+        }
+
+        // The leader's body is compressed for its Accept-Encoding
+        std::string key = requestKey(ctx, state_->options.queryParams, state_->options.headers);
+        key += '\0';
+        key += ctx.req.headers.get("Accept-Encoding", "");
+
+        State::Shard& shard = state_->shardFor(key);
+        std::shared_ptr<Flight> running;
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto found = shard.flights.find(key);
+            if (found != shard.flights.end()) {
+                running = found->second;
+            } else if (ctx.req.headers.has("If-None-Match") || ctx.req.headers.has("If-Modified-Since")) {
+                // its 304 would be no use to anyone else
+                return Role::Alone;
+            } else {
+                flight = std::make_shared<Flight>();
+                flight->key = std::move(key);
+                shard.flights.emplace(flight->key, flight);
+                return Role::Leader;
+            }
+        }
+
+        std::shared_ptr<const PreparedResponse> response;
+        {
+            std::unique_lock<std::mutex> lock(running->mutex);
+            if (!running->landed.wait_for(lock, state_->options.maxWait, [&] { return running->done; })) {
+                return Role::Alone;
+            }
+            response = running->response;
+        }
+
+        if (!response) {
+            return Role::Alone;
+        }
+        ctx.res.setPrepared(std::move(response));
+        return Role::Follower;
+    }
+
+    void SingleFlight::land(const std::shared_ptr<Flight>& flight, HttpResponse* res) const {
+        std::shared_ptr<const PreparedResponse> response;
+        if (res && !res->isStreamed() && !res->isDetached() && res->getStatus() == HttpStatus::OK &&
+            res->getHeader("Set-Cookie").empty()) {
+            response = res->serialize();
+            res->setPrepared(response);
+            // only the full representation is shared
+            if (response->status != HttpStatus::OK) response = nullptr;
+        }
+
+        // Requests from now on start a new flight
+        State::Shard& shard = state_->shardFor(flight->key);
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto found = shard.flights.find(flight->key);
+            if (found != shard.flights.end() && found->second == flight) {
+                shard.flights.erase(found);
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(flight->mutex);
+            flight->done = true;
+            flight->response = std::move(response);
+        }
+        flight->landed.notify_all();
+    }
+
+    size_t SingleFlight::inFlight() const {
+        size_t total = 0;
+        for (size_t i = 0; i < state_->options.shards; i++) {
+            std::lock_guard<std::mutex> lock(state_->shards[i].mutex);
+            total += state_->shards[i].flights.size();
+        }
+        return total;
+    }
+}
@@ -0,0 +1,45 @@
+#include "Socket.h"
+
+namespace Socket {
+    bool sendAll(socket_t fd, const char* data, size_t length) {
+        size_t total_sent = 0;
+
+        while (total_sent < length) {
+            int sent = send(fd,
+                           data + total_sent,
+                           static_cast<int>(length - total_sent),
+#ifdef MSG_NOSIGNAL
+                           MSG_NOSIGNAL);
+#else
+                           0);
+#endif
+
+            if (sent == SOCKET_ERROR) {
+#ifdef _WIN32
+                if (WSAGetLastError() == WSAEINTR) continue;
+#else
+                if (errno == EINTR) continue;
+#endif
+                return false;
+            }
+
+            total_sent += sent;
+        }
+
+        return true;
+    }
+
+    bool setSendTimeout(socket_t fd, int seconds) {
+#ifdef _WIN32
+        DWORD timeout = seconds * 1000;
+        return setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO,
+                         reinterpret_cast<const char*>(&timeout),
+                         sizeof(timeout)) != SOCKET_ERROR;
+#else
+        struct timeval tv;
+        tv.tv_sec = seconds;
+        tv.tv_usec = 0;
+        return setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)) == 0;
+#endif
+    }
+}
@@ -0,0 +1,480 @@
+#include <mutex>
+#include <cctype>
+#include <charconv>
+#include <algorithm>
+#include <shared_mutex>
+#include <unordered_map>
+
+#include "Config.h"
+#include "Utils.h"
+#include "Template.h"
+
+static const size_t MAX_INCLUDE_DEPTH = 16;
+
+namespace TemplateSupport {
+    const json* field(const json& data, std::string_view name) {
+        if (!data.is_object()) return nullptr;
+        auto it = data.find(name);
+        return it == data.end() ? nullptr : &*it;
+    }
+
+    const json* find(const json* value, std::initializer_list<std::string_view> path) {
+        for (std::string_view key : path) {
+            if (!value) return nullptr;
+
+            if (value->is_object()) {
+                auto it = value->find(key);
+                if (it == value->end()) return nullptr;
+                value = &*it;
+            } else if (value->is_array()) {
+                size_t index = 0;
+                auto result = std::from_chars(key.data(), key.data() + key.size(), index);
+                if (result.ec != std::errc() || result.ptr != key.data() + key.size() || index >= value->size()) {
+                    return nullptr;
+                }
+                value = &(*value)[index];
+            } else {
+                return nullptr;
+            }
+        }
+        return value;
+    }
+
+    void appendEscaped(std::string_view text, std::string& out) {
+        for (char c : text) {
+            switch (c) {
+                case '&': out += "&amp;"; break;
+                case '<': out += "&lt;"; break;
+                case '>': out += "&gt;"; break;
+                case '"': out += "&quot;"; break;
+                case '\'': out += "&#39;"; break;
+                default: out += c;
+            }
+        }
+    }
+
+    void appendValue(const json* value, bool escape, std::string& out) {
+        if (!value || value->is_null()) return;
+
+        if (value->is_string()) {
+            const auto& text = value->get_ref<const std::string&>();
+            if (escape) appendEscaped(text, out);
+            else out += text;
+            return;
+        }
+
+        std::string text = value->dump();
+        if (escape && !value->is_primitive()) appendEscaped(text, out);
+        else out += text;
+    }
+
+    bool isTruthy(const json* value) {
+        if (!value) return false;
+        switch (value->type()) {
+            case json::value_t::null: return false;
+            case json::value_t::boolean: return value->get<bool>();
+            case json::value_t::number_integer:
+            case json::value_t::number_unsigned:
+            case json::value_t::number_float: return value->get<double>() != 0;
+            case json::value_t::string: return !value->get_ref<const std::string&>().empty();
+            default: return !value->empty();
+        }
+    }
+}
+
+struct Template::Scope {
+    const json& root;
+    std::vector<std::pair<const std::string*, const json*>> locals; // innermost last
+    size_t depth = 0;
+
+    const json* find(const std::vector<std::string>& path) const {
+        const json* value = nullptr;
+        for (auto it = locals.rbegin(); it != locals.rend(); ++it) {
+            if (*it->first == path[0]) {
+                value = it->second;
+                break;
+            }
+        }
+        if (!value) {
+            value = TemplateSupport::field(root, path[0]);
+        }
+
+        for (size_t i = 1; i < path.size() && value; i++) {
+            value = TemplateSupport::find(value, {path[i]});
+        }
+        return value;
+    }
+};
+
+static std::vector<std::string> splitWords(const std::string& text) {
+    std::vector<std::string> words;
+    size_t pos = 0;
+    while (pos < text.length()) {
+        while (pos < text.length() && std::isspace(static_cast<unsigned char>(text[pos]))) pos++;
+        size_t start = pos;
+        while (pos < text.length() && !std::isspace(static_cast<unsigned char>(text[pos]))) pos++;
+        if (pos > start) words.push_back(text.substr(start, pos - start));
+    }
+    return words;
+}
+
+Template Template::compile(const std::string& source, const std::string& name) {
+    struct OpenBlock {
+        size_t index;
+        bool hasElse;
+        size_t line;
+    };
+
+    Template tmpl;
+    tmpl.name = name;
+    auto& segments = tmpl.segments;
+
+    std::vector<OpenBlock> open;
+    size_t line = 1;
+    size_t pos = 0;
+    bool mergeText = false;
+
+    auto fail = [&](const std::string& msg) -> Error {
+        return Error((name.empty() ? std::string("template") : name) + ":" + std::to_string(line) + ": " + msg);
+    };
+
+    auto parsePath = [&](const std::string& expr) {
+        if (expr.empty() || std::any_of(expr.begin(), expr.end(), [](unsigned char c) { return std::isspace(c); })) {
+            throw fail("invalid expression '" + expr + "'");
+        }
+
+        std::vector<std::string> path;
+        size_t start = 0;
+        while (true) {
+            size_t dot = expr.find('.', start);
+            std::string part = expr.substr(start, dot == std::string::npos ? std::string::npos : dot - start);
+            if (part.empty()) throw fail("invalid expression '" + expr + "'");
+            path.push_back(part);
+            if (dot == std::string::npos) break;
+            start = dot + 1;
+        }
+
+        // loop.* belongs to the innermost for
+        if (path[0] == "loop") {
+            for (auto it = open.rbegin(); it != open.rend(); ++it) {
+                if (segments[it->index].kind == Kind::For) {
+                    segments[it->index].usesLoop = true;
+                    break;
+                }
+            }
+        }
+        return path;
+    };
+
+    auto addText = [&](size_t begin, size_t end) {
+        if (begin >= end) return;
+        line += std::count(source.begin() + begin, source.begin() + end, '\n');
+        if (mergeText) {
+            segments.back().text.append(source, begin, end - begin);
+        } else {
+            Segment segment(Kind::Text);
+            segment.text = source.substr(begin, end - begin);
+            segments.push_back(std::move(segment));
+        }
+        mergeText = true;
+    };
+
+    while (pos < source.length()) {
+        size_t tag = pos;
+        while ((tag = source.find('{', tag)) != std::string::npos) {
+            if (tag + 1 < source.length() &&
+                (source[tag + 1] == '{' || source[tag + 1] == '%' || source[tag + 1] == '#')) {
+                break;
+            }
+            tag++;
+        }
+
+        if (tag == std::string::npos) {
+            addText(pos, source.length());
+            break;
+        }
+
+        char type = source[tag + 1];
+        const char* closer = type == '{' ? "}}" : type == '%' ? "%}" : "#}";
+        size_t close = source.find(closer, tag + 2);
+        if (close == std::string::npos) {
+            addText(pos, tag);
+            throw fail("unclosed tag");
+        }
+
+        // A block or comment tag alone on its line takes the whole line with
+        // it, so the markup around loops and conditions stays tidy
+        size_t textEnd = tag;
+        size_t next = close + 2;
+        if (type != '{') {
+            size_t newline = tag == 0 ? std::string::npos : source.rfind('\n', tag - 1);
+            size_t lineStart = newline == std::string::npos ? 0 : newline + 1;
+
+            size_t after = next;
+            while (after < source.length() && (source[after] == ' ' || source[after] == '\t')) after++;
+            if (after < source.length() && source[after] == '\r') after++;
+
+            bool leadingBlank = lineStart >= pos && std::all_of(source.begin() + lineStart, source.begin() + tag,
+                                                                [](char c) { return c == ' ' || c == '\t'; });
+            if (leadingBlank && (after == source.length() || source[after] == '\n')) {
+                textEnd = lineStart;
+                next = after == source.length() ? after : after + 1;
+            }
+        }
+        addText(pos, textEnd);
+
+        std::string inner = Utils::trim(source.substr(tag + 2, close - tag - 2));
+        size_t tagLine = line;
+        line += std::count(source.begin() + textEnd, source.begin() + next, '\n');
+        pos = next;
+
+        if (type == '#') continue;
+        mergeText = false;
+
+        if (type == '{') {
+            Segment segment(Kind::Escaped);
+            size_t bar = inner.rfind('|');
+            if (bar != std::string::npos) {
+                std::string filter = Utils::trim(inner.substr(bar + 1));
+                if (filter != "raw") throw fail("unknown filter '" + filter + "'");
+                segment.kind = Kind::Raw;
+                inner = Utils::trim(inner.substr(0, bar));
+            }
+            segment.path = parsePath(inner);
+            segments.push_back(std::move(segment));
+            continue;
+        }
+
+        std::vector<std::string> words = splitWords(inner);
+        if (words.empty()) throw fail("empty tag");
+        const std::string& keyword = words[0];
+
+        if (keyword == "if") {
+            Segment segment(Kind::If);
+            size_t expr = 1;
+            if (words.size() == 3 && words[1] == "not") {
+                segment.negate = true;
+                expr = 2;
+            }
+            if (words.size() != expr + 1) throw fail("expected {% if [not] value %}");
+            segment.path = parsePath(words[expr]);
+            open.push_back({segments.size(), false, tagLine});
+            segments.push_back(std::move(segment));
+        } else if (keyword == "else") {
+            if (words.size() != 1 || open.empty() || segments[open.back().index].kind != Kind::If || open.back().hasElse) {
+                throw fail("unexpected {% else %}");
+            }
+            segments[open.back().index].elseIndex = segments.size();
+            open.back().hasElse = true;
+        } else if (keyword == "endif") {
+            if (words.size() != 1 || open.empty() || segments[open.back().index].kind != Kind::If) {
+                throw fail("unexpected {% endif %}");
+            }
+            Segment& block = segments[open.back().index];
+            block.end = segments.size();
+            if (!open.back().hasElse) block.elseIndex = block.end;
+            open.pop_back();
+        } else if (keyword == "for") {
+            if (words.size() != 4 || words[2] != "in") throw fail("expected {% for item in values %}");
+            Segment segment(Kind::For);
+            segment.text = words[1];
+            segment.path = parsePath(words[3]);
+            open.push_back({segments.size(), false, tagLine});
+            segments.push_back(std::move(segment));
+        } else if (keyword == "endfor") {
+            if (words.size() != 1 || open.empty() || segments[open.back().index].kind != Kind::For) {
+                throw fail("unexpected {% endfor %}");
+            }
+            segments[open.back().index].end = segments.size();
+            open.pop_back();
+        } else if (keyword == "include") {
+            std::string target = words.size() == 2 ? words[1] : "";
+            if (target.length() < 2 || (target.front() != '"' && target.front() != '\'') || target.back() != target.front()) {
+                throw fail("expected {% include \"name\" %}");
+            }
+            Segment segment(Kind::Include);
+            segment.text = target.substr(1, target.length() - 2);
+            segments.push_back(std::move(segment));
+        } else {
+            throw fail("unknown tag '" + keyword + "'");
+        }
+    }
+
+    if (!open.empty()) {
+        line = open.back().line;
+        throw fail(segments[open.back().index].kind == Kind::For ? "unclosed {% for %}" : "unclosed {% if %}");
+    }
+    return tmpl;
+}
+
+void Template::render(const json& data, std::string& out) const {
+    Scope scope{data, {}, 0};
+    renderRange(0, segments.size(), scope, out);
+}
+
+std::string Template::render(const json& data) const {
+    std::string out;
+    render(data, out);
+    return out;
+}
+
+void Template::renderRange(size_t begin, size_t end, Scope& scope, std::string& out) const {
+    static const std::string loopName = "loop";
+
+    size_t i = begin;
+    while (i < end) {
+        const Segment& segment = segments[i];
+
+        switch (segment.kind) {
+            case Kind::Text:
+                out += segment.text;
+                i++;
+                break;
+
+            case Kind::Escaped:
+            case Kind::Raw:
+                TemplateSupport::appendValue(scope.find(segment.path), segment.kind == Kind::Escaped, out);
+                i++;
+                break;
+
+            case Kind::If: {
+                bool condition = TemplateSupport::isTruthy(scope.find(segment.path)) != segment.negate;
+                if (condition) {
+                    renderRange(i + 1, segment.elseIndex, scope, out);
+                } else {
+                    renderRange(segment.elseIndex, segment.end, scope, out);
+                }
+                i = segment.end;
+                break;
+            }
+
+            case Kind::For: {
+                const json* values = scope.find(segment.path);
+                if (values && values->is_array()) {
+                    json loop;
+                    scope.locals.emplace_back(&segment.text, nullptr);
+                    if (segment.usesLoop) scope.locals.emplace_back(&loopName, &loop);
+                    size_t slot = scope.locals.size() - (segment.usesLoop ? 2 : 1);
+
+                    size_t count = values->size();
+                    for (size_t n = 0; n < count; n++) {
+                        scope.locals[slot].second = &(*values)[n];
+                        if (segment.usesLoop) {
+                            loop = {{"index", n + 1}, {"first", n == 0}, {"last", n + 1 == count}};
+                        }
+                        renderRange(i + 1, segment.end, scope, out);
+                    }
+
+                    scope.locals.resize(slot);
+                }
+                i = segment.end;
+                break;
+            }
+
+            case Kind::Include: {
+                if (scope.depth >= MAX_INCLUDE_DEPTH) {
+                    throw Error(name + ": includes nested too deeply");
+                }
+                auto included = load(segment.text);
+                scope.depth++;
+                included->renderRange(0, included->segments.size(), scope, out);
+                scope.depth--;
+                i++;
+                break;
+            }
+        }
+    }
+}
+
+Utils::FileInfo Template::sourceInfo() const {
+    return sourceInfo(0);
+}
+
+Utils::FileInfo Template::sourceInfo(size_t depth) const {
+    if (depth >= MAX_INCLUDE_DEPTH) {
+        throw Error(name + ": includes nested too deeply");
+    }
+
+    Utils::FileInfo info = file;
+    for (const auto& segment : segments) {
+        if (segment.kind != Kind::Include) continue;
+
+        Utils::FileInfo included = load(segment.text)->sourceInfo(depth + 1);
+        info.mtime = std::max(info.mtime, included.mtime);
+        info.size += included.size;
+    }
+    return info;
+}
+
+class Template::Cache {
+public:
+    std::shared_ptr<const Template> get(const std::string& name) {
+        if (name.empty() || name.find("..") != std::string::npos) {
+            throw Template::Error("Invalid template name: " + name);
+        }
+
+        std::string path = std::string(Config::TEMPLATE_DIR) + "/" + name;
+        Utils::FileInfo info;
+        if (!Utils::statFile(path, info)) {
+            throw Template::Error("Template not found: " + path);
+        }
+
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex);
+            auto it = entries.find(name);
+            if (it != entries.end() && it->second.mtime == info.mtime && it->second.size == info.size) {
+                return it->second.compiled;
+            }
+        }
+
+        auto compiled = std::make_shared<Template>(Template::compile(Utils::readFile(path), name));
+        compiled->file = info;
+
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        entries[name] = {compiled, info.mtime, info.size};
+        return compiled;
+    }
+
+    void clear() {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        entries.clear();
+    }
+
+private:
+    struct Entry {
+        std::shared_ptr<const Template> compiled;
+        time_t mtime;
+        uint64_t size;
+    };
+
+    std::shared_mutex mutex;
+    std::unordered_map<std::string, Entry> entries;
+};
+
+static std::unordered_map<std::string, Template::Precompiled>& precompiledTemplates() {
+    static std::unordered_map<std::string, Template::Precompiled> templates;
+    return templates;
+}
+
+void Template::registerPrecompiled(const std::string& name, RenderFunction render, const Utils::FileInfo& source) {
+    precompiledTemplates()[name] = {render, source};
+}
+
+const Template::Precompiled* Template::findPrecompiled(const std::string& name) {
+    auto& templates = precompiledTemplates();
+    auto it = templates.find(name);
+    return it == templates.end() ? nullptr : &it->second;
+}
+
+Template::Cache& Template::cache() {
+    static Cache instance;
+    return instance;
+}
+
+std::shared_ptr<const Template> Template::load(const std::string& name) {
+    return cache().get(name);
+}
+
+void Template::clearCache() {
+    cache().clear();
+}
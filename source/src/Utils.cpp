@@ -3,6 +3,10 @@
 #include <sstream>
 #include <fstream>
 #include <stdexcept>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <sys/stat.h>
 
 #ifdef _WIN32
     #include <windows.h>
@@ -63,6 +67,236 @@ namespace Utils {
         return result;
     }
 
+    bool hasToken(const std::string& headerValue, const std::string& token) {
+        std::istringstream ss(headerValue);
+        std::string item;
+
+        while (std::getline(ss, item, ',')) {
+            item = trim(item);
+            if (item.length() == token.length() &&
+                std::equal(item.begin(), item.end(), token.begin(),
+                           [](unsigned char a, unsigned char b) { return std::tolower(a) == std::tolower(b); })) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::string formatHttpDate(time_t time) {
+        struct tm tm;
+    #ifdef _WIN32
+        gmtime_s(&tm, &time);
+    #else
+        gmtime_r(&time, &tm);
+    #endif
+        char buffer[64];
+        size_t len = strftime(buffer, sizeof(buffer), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+        return std::string(buffer, len);
+    }
+
+    time_t parseHttpDate(const std::string& date) {
+        static const char* const months[] = {
+            "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+            "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+        };
+
+        char weekday[16] = {0};
+        char month[4] = {0};
+        struct tm tm;
+        std::memset(&tm, 0, sizeof(tm));
+
+        // IMF-fixdate, e.g. "Sun, 06 Nov 1994 08:49:37 GMT"
+        if (std::sscanf(date.c_str(), "%15[^,], %d %3s %d %d:%d:%d GMT",
+                        weekday, &tm.tm_mday, month, &tm.tm_year,
+                        &tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 7) {
+            return -1;
+        }
+
+        tm.tm_mon = -1;
+        for (int i = 0; i < 12; i++) {
+            if (std::strcmp(month, months[i]) == 0) {
+                tm.tm_mon = i;
+                break;
+            }
+        }
+        if (tm.tm_mon < 0) return -1;
+        tm.tm_year -= 1900;
+
+    #ifdef _WIN32
+        return _mkgmtime(&tm);
+    #else
+        return timegm(&tm);
+    #endif
+    }
+
+    uint64_t hash64(const void* data, size_t length, uint64_t seed) {
+        // MurmurHash64A
+        const uint64_t m = 0xc6a4a7935bd1e995ULL;
+        const int r = 47;
+
+        uint64_t h = seed ^ (length * m);
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        const unsigned char* end = p + (length & ~static_cast<size_t>(7));
+
+        for (; p != end; p += 8) {
+            uint64_t k;
+            std::memcpy(&k, p, sizeof(k));
+
+            k *= m;
+            k ^= k >> r;
+            k *= m;
+
+            h ^= k;
+            h *= m;
+        }
+
+        switch (length & 7) {
+            case 7: h ^= uint64_t(p[6]) << 48; [[fallthrough]];
+            case 6: h ^= uint64_t(p[5]) << 40; [[fallthrough]];
+            case 5: h ^= uint64_t(p[4]) << 32; [[fallthrough]];
+            case 4: h ^= uint64_t(p[3]) << 24; [[fallthrough]];
+            case 3: h ^= uint64_t(p[2]) << 16; [[fallthrough]];
+            case 2: h ^= uint64_t(p[1]) << 8; [[fallthrough]];
+            case 1: h ^= uint64_t(p[0]);
+                    h *= m;
+        }
+
+        h ^= h >> r;
+        h *= m;
+        h ^= h >> r;
+        return h;
+    }
+
+    uint64_t hash64(const std::string& data, uint64_t seed) {
+        return hash64(data.data(), data.size(), seed);
+    }
+
+    std::string sha1(const std::string& data) {
+        uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+
+        std::string message = data;
+        uint64_t bitLength = static_cast<uint64_t>(data.size()) * 8;
+        message += static_cast<char>(0x80);
+        while (message.size() % 64 != 56) {
+            message += '\0';
+        }
+        for (int i = 7; i >= 0; i--) {
+            message += static_cast<char>((bitLength >> (i * 8)) & 0xFF);
+        }
+
+        auto rotl = [](uint32_t value, int bits) {
+            return (value << bits) | (value >> (32 - bits));
+        };
+
+        for (size_t chunk = 0; chunk < message.size(); chunk += 64) {
+            uint32_t w[80];
+            for (int i = 0; i < 16; i++) {
+                const unsigned char* p = reinterpret_cast<const unsigned char*>(&message[chunk + i * 4]);
+                w[i] = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+            }
+            for (int i = 16; i < 80; i++) {
+                w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+            }
+
+            uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+            for (int i = 0; i < 80; i++) {
+                uint32_t f, k;
+                if (i < 20) {
+                    f = (b & c) | (~b & d);
+                    k = 0x5A827999;
+                } else if (i < 40) {
+                    f = b ^ c ^ d;
+                    k = 0x6ED9EBA1;
+                } else if (i < 60) {
+                    f = (b & c) | (b & d) | (c & d);
+                    k = 0x8F1BBCDC;
+                } else {
+                    f = b ^ c ^ d;
+                    k = 0xCA62C1D6;
+                }
+
+                uint32_t temp = rotl(a, 5) + f + e + k + w[i];
+                e = d;
+                d = c;
+                c = rotl(b, 30);
+                b = a;
+                a = temp;
+            }
+
+            h[0] += a;
+            h[1] += b;
+            h[2] += c;
+            h[3] += d;
+            h[4] += e;
+        }
+
+        std::string digest(20, '\0');
+        for (int i = 0; i < 5; i++) {
+            digest[i * 4] = static_cast<char>(h[i] >> 24);
+            digest[i * 4 + 1] = static_cast<char>(h[i] >> 16);
+            digest[i * 4 + 2] = static_cast<char>(h[i] >> 8);
+            digest[i * 4 + 3] = static_cast<char>(h[i]);
+        }
+        return digest;
+    }
+
+    std::string base64Encode(const std::string& data) {
+        static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+        std::string encoded;
+        encoded.reserve((data.size() + 2) / 3 * 4);
+
+        size_t i = 0;
+        for (; i + 2 < data.size(); i += 3) {
+            uint32_t n = (uint32_t(static_cast<unsigned char>(data[i])) << 16) |
+                         (uint32_t(static_cast<unsigned char>(data[i + 1])) << 8) |
+                         static_cast<unsigned char>(data[i + 2]);
+            encoded += table[(n >> 18) & 63];
+            encoded += table[(n >> 12) & 63];
+            encoded += table[(n >> 6) & 63];
+            encoded += table[n & 63];
+        }
+
+        if (i < data.size()) {
+            uint32_t n = uint32_t(static_cast<unsigned char>(data[i])) << 16;
+            if (i + 1 < data.size()) {
+                n |= uint32_t(static_cast<unsigned char>(data[i + 1])) << 8;
+            }
+            encoded += table[(n >> 18) & 63];
+            encoded += table[(n >> 12) & 63];
+            encoded += i + 1 < data.size() ? table[(n >> 6) & 63] : '=';
+            encoded += '=';
+        }
+
+        return encoded;
+    }
+
+    bool base64Decode(const std::string& data, std::string& decoded) {
+        decoded.clear();
+        decoded.reserve(data.size() / 4 * 3 + 3);
+
+        uint32_t buffer = 0;
+        int bits = 0;
+        for (char c : data) {
+            int value;
+            if (c >= 'A' && c <= 'Z') value = c - 'A';
+            else if (c >= 'a' && c <= 'z') value = c - 'a' + 26;
+            else if (c >= '0' && c <= '9') value = c - '0' + 52;
+            else if (c == '+' || c == '-') value = 62;
+            else if (c == '/' || c == '_') value = 63;
+            else if (c == '=') break;
+            else return false;
+
+            buffer = (buffer << 6) | static_cast<uint32_t>(value);
+            bits += 6;
+            if (bits >= 8) {
+                bits -= 8;
+                decoded += static_cast<char>((buffer >> bits) & 0xFF);
+            }
+        }
+        return true;
+    }
+
     std::string normalizePath(const std::string& path) {
         std::string normalized = path;
     #ifdef _WIN32
@@ -93,6 +327,50 @@ namespace Utils {
         return content;
     }
 
+    std::string readFileHead(const std::string& path, size_t maxBytes) {
+        std::string normalizedPath = normalizePath(path);
+
+        std::ifstream file(normalizedPath, std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open file: " + normalizedPath);
+        }
+
+        std::string content(maxBytes, '\0');
+        file.read(&content[0], maxBytes);
+        content.resize(static_cast<size_t>(file.gcount()));
+        return content;
+    }
+
+    std::string readFileRange(const std::string& path, uint64_t offset, uint64_t length) {
+        std::string normalizedPath = normalizePath(path);
+
+        std::ifstream file(normalizedPath, std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open file: " + normalizedPath);
+        }
+
+        file.seekg(static_cast<std::streamoff>(offset), std::ios::beg);
+        std::string content(static_cast<size_t>(length), '\0');
+        if (!file.read(&content[0], static_cast<std::streamsize>(length))) {
+            throw std::runtime_error("Failed to read file: " + normalizedPath);
+        }
+
+        return content;
+    }
+
+    bool statFile(const std::string& path, FileInfo& info) {
+    #ifdef _WIN32
+        struct _stat64 st;
+        if (_stat64(normalizePath(path).c_str(), &st) != 0) return false;
+    #else
+        struct stat st;
+        if (stat(normalizePath(path).c_str(), &st) != 0) return false;
+    #endif
+        info.size = static_cast<uint64_t>(st.st_size);
+        info.mtime = st.st_mtime;
+        return true;
+    }
+
     bool fileExists(const std::string& path) {
     #ifdef _WIN32
         DWORD attrs = GetFileAttributesA(normalizePath(path).c_str());
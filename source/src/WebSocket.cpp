@@ -0,0 +1,849 @@
+#include <cstring>
+#include <atomic>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include <zlib.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define WEBSOCKET_UNMASK_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #include <arm_neon.h>
+    #define WEBSOCKET_UNMASK_NEON
+#endif
+
+#include "Utils.h"
+#include "Socket.h"
+#include "HttpServer.h"
+#include "WebSocket.h"
+
+static const char* const WEBSOCKET_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+// Every deflate block flushed with Z_SYNC_FLUSH ends in this empty stored
+// block; RFC 7692 strips it on the wire and the receiver appends it back.
+static const char DEFLATE_TAIL[4] = {'\x00', '\x00', '\xff', '\xff'};
+
+static std::atomic<size_t> deflateMemory{0};
+
+static bool reserveDeflateMemory(size_t bytes) {
+    size_t current = deflateMemory.load(std::memory_order_relaxed);
+    do {
+        if (current + bytes > Config::WEBSOCKET_DEFLATE_MEMORY_LIMIT) return false;
+    } while (!deflateMemory.compare_exchange_weak(current, current + bytes, std::memory_order_relaxed));
+    return true;
+}
+
+// Raw deflate stream; without context takeover one per thread is shared by
+// all connections and reset before each message.
+class RawDeflater {
+public:
+    ~RawDeflater() {
+        if (initialized) deflateEnd(&zs);
+    }
+
+    z_stream* acquire(int level, int windowBits, int memLevel, bool reset) {
+        if (initialized && (windowBits != currentWindowBits || memLevel != currentMemLevel)) {
+            deflateEnd(&zs);
+            initialized = false;
+        }
+
+        if (!initialized) {
+            zs = z_stream();
+            if (deflateInit2(&zs, level, Z_DEFLATED, -windowBits, memLevel, Z_DEFAULT_STRATEGY) != Z_OK) {
+                throw std::runtime_error("Failed to initialize zlib deflate");
+            }
+            initialized = true;
+            currentLevel = level;
+            currentWindowBits = windowBits;
+            currentMemLevel = memLevel;
+            return &zs;
+        }
+
+        if (reset && deflateReset(&zs) != Z_OK) {
+            throw std::runtime_error("Failed to reset zlib deflate");
+        }
+        if (level != currentLevel) {
+            if (deflateParams(&zs, level, Z_DEFAULT_STRATEGY) != Z_OK) {
+                throw std::runtime_error("Failed to set zlib compression level");
+            }
+            currentLevel = level;
+        }
+        return &zs;
+    }
+
+private:
+    z_stream zs{};
+    bool initialized = false;
+    int currentLevel = 0;
+    int currentWindowBits = 0;
+    int currentMemLevel = 0;
+};
+
+class RawInflater {
+public:
+    ~RawInflater() {
+        if (initialized) inflateEnd(&zs);
+    }
+
+    z_stream* acquire(int windowBits, bool reset) {
+        if (!initialized) {
+            zs = z_stream();
+            if (inflateInit2(&zs, -windowBits) != Z_OK) {
+                throw std::runtime_error("Failed to initialize zlib inflate");
+            }
+            initialized = true;
+        } else if (reset && inflateReset(&zs) != Z_OK) {
+            throw std::runtime_error("Failed to reset zlib inflate");
+        }
+        return &zs;
+    }
+
+private:
+    z_stream zs{};
+    bool initialized = false;
+};
+
+// Negotiated permessage-deflate state of one connection
+class PerMessageDeflate {
+public:
+    struct Params {
+        bool serverContextTakeover = false;
+        bool clientContextTakeover = false;
+        int serverWindowBits = 15;
+        int clientWindowBits = 15;
+        int memLevel = Config::WEBSOCKET_DEFLATE_MEM_LEVEL;
+        int level = Config::COMPRESSION_LEVEL;
+        size_t minSize = Config::WEBSOCKET_DEFLATE_MIN_SIZE;
+    };
+
+    explicit PerMessageDeflate(const Params& params, size_t reserved)
+        : params(params), reserved(reserved) {}
+
+    ~PerMessageDeflate() {
+        deflateMemory.fetch_sub(reserved, std::memory_order_relaxed);
+    }
+
+    // Picks the first acceptable offer from a Sec-WebSocket-Extensions
+    // header and writes the matching response value
+    static std::unique_ptr<PerMessageDeflate> negotiate(const std::string& header,
+                                                        const WebSocketCompression& options,
+                                                        std::string& response);
+
+    const Params& getParams() const { return params; }
+    bool sharesEncoder() const { return !params.serverContextTakeover; }
+
+    // Appends the compressed message (without the sync tail) to out.
+    // Callers keeping the context must hold mutex from here until the
+    // frame is queued so frames go out in compression order.
+    void compress(const char* data, size_t length, std::string& out) {
+        z_stream* zs;
+        if (params.serverContextTakeover) {
+            zs = ownDeflater.acquire(params.level, params.serverWindowBits, params.memLevel, false);
+        } else {
+            zs = sharedDeflater(params.level, params.serverWindowBits, params.memLevel);
+        }
+        compressWith(zs, data, length, out);
+    }
+
+    static void compressShared(const Params& params, const char* data, size_t length, std::string& out) {
+        compressWith(sharedDeflater(params.level, params.serverWindowBits, params.memLevel), data, length, out);
+    }
+
+    // Returns false when the inflated message would exceed limit; throws on
+    // corrupt input. Loop thread only.
+    bool decompress(std::string& in, std::string& out, size_t limit) {
+        z_stream* zs;
+        if (params.clientContextTakeover) {
+            zs = ownInflater.acquire(params.clientWindowBits, false);
+        } else {
+            // A 15-bit window can decode any smaller window the client used
+            thread_local RawInflater shared;
+            zs = shared.acquire(15, true);
+        }
+
+        in.append(DEFLATE_TAIL, sizeof(DEFLATE_TAIL));
+        zs->next_in = reinterpret_cast<Bytef*>(&in[0]);
+        zs->avail_in = static_cast<uInt>(in.size());
+
+        char buffer[16384];
+        while (true) {
+            zs->next_out = reinterpret_cast<Bytef*>(buffer);
+            zs->avail_out = sizeof(buffer);
+
+            int ret = inflate(zs, Z_SYNC_FLUSH);
+            if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+                throw std::runtime_error("Invalid compressed message");
+            }
+
+            size_t produced = sizeof(buffer) - zs->avail_out;
+            if (out.size() + produced > limit) return false;
+            out.append(buffer, produced);
+
+            if (ret == Z_STREAM_END) {
+                // The client ended the deflate stream; the next message starts a new one
+                inflateReset(zs);
+                if (zs->avail_in == 0) break;
+            } else if (zs->avail_in == 0 && zs->avail_out != 0) {
+                break;
+            } else if (ret == Z_BUF_ERROR && produced == 0) {
+                throw std::runtime_error("Invalid compressed message");
+            }
+        }
+        return true;
+    }
+
+    std::mutex mutex;
+
+private:
+    static z_stream* sharedDeflater(int level, int windowBits, int memLevel) {
+        thread_local RawDeflater shared;
+        return shared.acquire(level, windowBits, memLevel, true);
+    }
+
+    static void compressWith(z_stream* zs, const char* data, size_t length, std::string& out) {
+        size_t start = out.size();
+        out.resize(start + deflateBound(zs, static_cast<uLong>(length)) + 16);
+
+        zs->next_in = (Bytef*)data;
+        zs->avail_in = static_cast<uInt>(length);
+        zs->next_out = reinterpret_cast<Bytef*>(&out[start]);
+        zs->avail_out = static_cast<uInt>(out.size() - start);
+
+        if (deflate(zs, Z_SYNC_FLUSH) != Z_OK || zs->avail_in != 0) {
+            throw std::runtime_error("Failed to compress message");
+        }
+
+        out.resize(out.size() - zs->avail_out);
+        if (out.size() - start >= sizeof(DEFLATE_TAIL)) {
+            out.resize(out.size() - sizeof(DEFLATE_TAIL));
+        }
+    }
+
+    Params params;
+    size_t reserved;
+    RawDeflater ownDeflater;
+    RawInflater ownInflater;
+};
+
+static std::vector<std::string> splitList(const std::string& value, char delimiter) {
+    std::vector<std::string> items;
+    std::stringstream ss(value);
+    std::string item;
+    while (std::getline(ss, item, delimiter)) {
+        items.push_back(item);
+    }
+    return items;
+}
+
+static bool parseWindowBits(const std::string& value, int min, int& bits) {
+    std::string digits = value;
+    if (digits.size() >= 2 && digits.front() == '"' && digits.back() == '"') {
+        digits = digits.substr(1, digits.size() - 2);
+    }
+    if (digits.empty() || digits.size() > 2 ||
+        !std::all_of(digits.begin(), digits.end(), ::isdigit)) {
+        return false;
+    }
+    bits = std::stoi(digits);
+    return bits >= min && bits <= 15;
+}
+
+std::unique_ptr<PerMessageDeflate> PerMessageDeflate::negotiate(const std::string& header,
+                                                                const WebSocketCompression& options,
+                                                                std::string& response) {
+    for (const auto& offer : splitList(header, ',')) {
+        auto tokens = splitList(offer, ';');
+        if (tokens.empty() || Utils::trim(tokens[0]) != "permessage-deflate") continue;
+
+        bool valid = true;
+        bool serverNoTakeover = false, clientNoTakeover = false;
+        bool hasServerBits = false, hasClientBits = false;
+        int serverBits = 15, clientBits = 15;
+
+        for (size_t i = 1; i < tokens.size() && valid; i++) {
+            std::string param = Utils::trim(tokens[i]);
+            std::string name = param, value;
+            bool hasValue = false;
+            size_t eq = param.find('=');
+            if (eq != std::string::npos) {
+                name = Utils::trim(param.substr(0, eq));
+                value = Utils::trim(param.substr(eq + 1));
+                hasValue = true;
+            }
+
+            if (name == "server_no_context_takeover" && !hasValue && !serverNoTakeover) {
+                serverNoTakeover = true;
+            } else if (name == "client_no_context_takeover" && !hasValue && !clientNoTakeover) {
+                clientNoTakeover = true;
+            } else if (name == "server_max_window_bits" && hasValue && !hasServerBits) {
+                hasServerBits = true;
+                valid = parseWindowBits(value, 8, serverBits);
+            } else if (name == "client_max_window_bits" && !hasClientBits) {
+                hasClientBits = true;
+                if (hasValue) valid = parseWindowBits(value, 8, clientBits);
+            } else {
+                valid = false;
+            }
+        }
+        if (!valid) continue;
+
+        Params params;
+        params.memLevel = std::min(std::max(options.memLevel, 1), 9);
+        params.level = options.level;
+        params.minSize = options.minSize;
+
+        // zlib cannot produce 8-bit raw deflate windows, so an offer
+        // demanding one is declined
+        params.serverWindowBits = std::min(serverBits, std::min(std::max(options.serverMaxWindowBits, 9), 15));
+        if (params.serverWindowBits < 9) continue;
+
+        // The client's window can only be limited when it offered the parameter
+        if (hasClientBits) {
+            params.clientWindowBits = std::min(clientBits, std::min(std::max(options.clientMaxWindowBits, 8), 15));
+        }
+
+        size_t reserved = 0;
+        params.serverContextTakeover = options.serverContextTakeover && !serverNoTakeover;
+        if (params.serverContextTakeover) {
+            size_t bytes = (size_t(1) << (params.serverWindowBits + 2)) + (size_t(1) << (params.memLevel + 9));
+            if (reserveDeflateMemory(bytes)) {
+                reserved += bytes;
+            } else {
+                params.serverContextTakeover = false;
+            }
+        }
+
+        params.clientContextTakeover = options.clientContextTakeover && !clientNoTakeover;
+        if (params.clientContextTakeover) {
+            size_t bytes = (size_t(1) << params.clientWindowBits) + 7 * 1024;
+            if (reserveDeflateMemory(bytes)) {
+                reserved += bytes;
+            } else {
+                params.clientContextTakeover = false;
+            }
+        }
+
+        response = "permessage-deflate";
+        if (!params.serverContextTakeover) response += "; server_no_context_takeover";
+        if (!params.clientContextTakeover) response += "; client_no_context_takeover";
+        if (params.serverWindowBits < 15 || hasServerBits) {
+            response += "; server_max_window_bits=" + std::to_string(params.serverWindowBits);
+        }
+        if (hasClientBits) {
+            response += "; client_max_window_bits=" + std::to_string(params.clientWindowBits);
+        }
+
+        return std::make_unique<PerMessageDeflate>(params, reserved);
+    }
+
+    return nullptr;
+}
+
+// Well-formed UTF-8: no overlong forms, surrogates or code points past U+10FFFF
+static bool isValidUtf8(const char* data, size_t length) {
+    const unsigned char* s = reinterpret_cast<const unsigned char*>(data);
+    size_t i = 0;
+    while (i < length) {
+        unsigned char c = s[i];
+        if (c < 0x80) {
+            i++;
+            continue;
+        }
+
+        size_t extra;
+        unsigned char min = 0x80, max = 0xBF; // bounds of the second byte
+        if (c >= 0xC2 && c <= 0xDF) {
+            extra = 1;
+        } else if (c >= 0xE0 && c <= 0xEF) {
+            extra = 2;
+            if (c == 0xE0) min = 0xA0;
+            if (c == 0xED) max = 0x9F;
+        } else if (c >= 0xF0 && c <= 0xF4) {
+            extra = 3;
+            if (c == 0xF0) min = 0x90;
+            if (c == 0xF4) max = 0x8F;
+        } else {
+            return false;
+        }
+
+        if (length - i <= extra || s[i + 1] < min || s[i + 1] > max) return false;
+        for (size_t j = 2; j <= extra; j++) {
+            if ((s[i + j] & 0xC0) != 0x80) return false;
+        }
+        i += extra + 1;
+    }
+    return true;
+}
+
+// Codes a peer may send (RFC 6455 7.4); 1005 and 1006 are never on the wire
+static bool isValidCloseCode(uint16_t code) {
+    if (code >= 3000 && code <= 4999) return true;
+    return code >= 1000 && code <= 1014 && code != 1004 && code != 1005 && code != 1006;
+}
+
+WebSocket::WebSocket(socket_t fd, std::shared_ptr<const WebSocketHandlers> handlers,
+                     WebSocketChannel* channel, const std::string& path,
+                     const SafeMap<std::string>& params,
+                     std::unique_ptr<PerMessageDeflate> deflate)
+    : EventLoop::Connection(fd), handlers(std::move(handlers)), channel(channel),
+      path(path), params(params), deflate(std::move(deflate)) {}
+
+WebSocket::~WebSocket() = default;
+
+std::string WebSocket::encodeFrame(uint8_t opcode, const char* data, size_t length,
+                                   bool fin, bool compressed) {
+    std::string frame;
+    frame.reserve(length + 10);
+    frame += static_cast<char>((fin ? 0x80 : 0x00) | (compressed ? 0x40 : 0x00) | (opcode & 0x0F));
+
+    if (length < 126) {
+        frame += static_cast<char>(length);
+    } else if (length <= 0xFFFF) {
+        frame += static_cast<char>(126);
+        frame += static_cast<char>((length >> 8) & 0xFF);
+        frame += static_cast<char>(length & 0xFF);
+    } else {
+        frame += static_cast<char>(127);
+        for (int i = 7; i >= 0; i--) {
+            frame += static_cast<char>((static_cast<uint64_t>(length) >> (i * 8)) & 0xFF);
+        }
+    }
+
+    frame.append(data, length);
+    return frame;
+}
+
+void WebSocket::unmask(char* data, size_t length, const unsigned char key[4]) {
+    size_t i = 0;
+
+#if defined(WEBSOCKET_UNMASK_SSE2)
+    uint32_t key32;
+    std::memcpy(&key32, key, 4);
+    const __m128i mask = _mm_set1_epi32(static_cast<int>(key32));
+    for (; i + 16 <= length; i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), _mm_xor_si128(block, mask));
+    }
+#elif defined(WEBSOCKET_UNMASK_NEON)
+    uint8_t pattern[16];
+    for (int j = 0; j < 16; j++) pattern[j] = key[j & 3];
+    const uint8x16_t mask = vld1q_u8(pattern);
+    for (; i + 16 <= length; i += 16) {
+        uint8_t* p = reinterpret_cast<uint8_t*>(data + i);
+        vst1q_u8(p, veorq_u8(vld1q_u8(p), mask));
+    }
+#endif
+
+    // Word-at-a-time for what the vector loop left (or everything without SIMD)
+    uint64_t key64;
+    unsigned char pattern[8];
+    for (int j = 0; j < 8; j++) pattern[j] = key[j & 3];
+    std::memcpy(&key64, pattern, 8);
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, 8);
+        word ^= key64;
+        std::memcpy(data + i, &word, 8);
+    }
+
+    // i is a multiple of 4 here, so the key phase restarts at 0
+    for (; i < length; i++) {
+        data[i] = static_cast<char>(data[i] ^ key[i & 3]);
+    }
+}
+
+bool WebSocket::sendMessage(uint8_t opcode, const std::string& message) {
+    if (closeSent) return false;
+    if (!deflate || message.size() < deflate->getParams().minSize) {
+        return send(std::make_shared<const std::string>(encodeFrame(opcode, message.data(), message.size())));
+    }
+
+    std::string compressed;
+    if (deflate->sharesEncoder()) {
+        deflate->compress(message.data(), message.size(), compressed);
+        return send(std::make_shared<const std::string>(
+            encodeFrame(opcode, compressed.data(), compressed.size(), true, true)));
+    }
+
+    // The client's inflater needs every frame compressed with the kept
+    // context, so a frame that does not fit ends the connection instead of
+    // being dropped
+    std::lock_guard<std::mutex> lock(deflate->mutex);
+    deflate->compress(message.data(), message.size(), compressed);
+    auto frame = std::make_shared<const std::string>(
+        encodeFrame(opcode, compressed.data(), compressed.size(), true, true));
+    if (getQueuedBytes() + frame->size() > getMaxQueuedBytes()) {
+        close(1008, "Client too slow");
+        return false;
+    }
+    return send(std::move(frame), false);
+}
+
+bool WebSocket::sendText(const std::string& message) {
+    return sendMessage(TEXT, message);
+}
+
+bool WebSocket::sendBinary(const std::string& message) {
+    return sendMessage(BINARY, message);
+}
+
+bool WebSocket::ping(const std::string& payload) {
+    size_t length = std::min<size_t>(payload.size(), 125);
+    return send(std::make_shared<const std::string>(encodeFrame(PING, payload.data(), length)), false);
+}
+
+void WebSocket::close(uint16_t code, const std::string& reason) {
+    if (closeSent.exchange(true)) return;
+
+    std::string payload;
+    payload += static_cast<char>(code >> 8);
+    payload += static_cast<char>(code & 0xFF);
+    payload += reason.substr(0, 123);
+
+    send(std::make_shared<const std::string>(encodeFrame(CLOSE, payload.data(), payload.size())), false);
+    EventLoop::Connection::close();
+}
+
+void WebSocket::fail(uint16_t code, const std::string& reason) {
+    close(code, reason);
+    notifyClose(code, reason);
+}
+
+void WebSocket::notifyClose(uint16_t code, const std::string& reason) {
+    if (closeNotified) return;
+    closeNotified = true;
+
+    if (handlers->onClose) {
+        try {
+            handlers->onClose(*this, code, reason);
+        } catch (const std::exception& e) {
+            std::cerr << "WebSocket close handler failed: " << e.what() << std::endl;
+        }
+    }
+    if (channel) channel->remove(this);
+}
+
+void WebSocket::onClosed() {
+    notifyClose(1006, "");
+}
+
+void WebSocket::onData(const char* data, size_t length) {
+    input.append(data, length);
+
+    while (!isClosed() && !closeNotified) {
+        size_t available = input.size() - inputOffset;
+        if (available < 2) break;
+
+        const unsigned char* header = reinterpret_cast<const unsigned char*>(input.data() + inputOffset);
+        bool fin = (header[0] & 0x80) != 0;
+        uint8_t rsv = header[0] & 0x70;
+        uint8_t opcode = header[0] & 0x0F;
+        bool masked = (header[1] & 0x80) != 0;
+        uint64_t payloadLength = header[1] & 0x7F;
+        size_t headerLength = 2;
+
+        if (payloadLength == 126) {
+            if (available < 4) break;
+            payloadLength = (uint64_t(header[2]) << 8) | header[3];
+            headerLength = 4;
+        } else if (payloadLength == 127) {
+            if (available < 10) break;
+            payloadLength = 0;
+            for (int i = 0; i < 8; i++) {
+                payloadLength = (payloadLength << 8) | header[2 + i];
+            }
+            headerLength = 10;
+        }
+
+        // RSV1 marks the first frame of a compressed message
+        bool compressed = rsv == 0x40 && deflate && (opcode == TEXT || opcode == BINARY);
+        if (rsv != 0 && !compressed) {
+            fail(1002, "Unexpected reserved bits");
+            return;
+        }
+        if (!masked) {
+            fail(1002, "Client frames must be masked");
+            return;
+        }
+        if (payloadLength > Config::WEBSOCKET_MAX_MESSAGE_SIZE ||
+            message.size() + payloadLength > Config::WEBSOCKET_MAX_MESSAGE_SIZE) {
+            fail(1009, "Message too big");
+            return;
+        }
+
+        if (available < headerLength + 4 + payloadLength) break;
+
+        unsigned char key[4];
+        std::memcpy(key, header + headerLength, 4);
+        char* payload = &input[inputOffset + headerLength + 4];
+        size_t size = static_cast<size_t>(payloadLength);
+        unmask(payload, size, key);
+
+        inputOffset += headerLength + 4 + size;
+        if (!processFrame(fin, compressed, opcode, payload, size)) return;
+    }
+
+    if (inputOffset == input.size()) {
+        input.clear();
+        inputOffset = 0;
+    } else if (inputOffset > 65536) {
+        input.erase(0, inputOffset);
+        inputOffset = 0;
+    }
+}
+
+bool WebSocket::processFrame(bool fin, bool compressed, uint8_t opcode, char* payload, size_t length) {
+    if (opcode >= CLOSE) {
+        if (!fin || length > 125) {
+            fail(1002, "Invalid control frame");
+            return false;
+        }
+
+        if (opcode == PING) {
+            send(std::make_shared<const std::string>(encodeFrame(PONG, payload, length)), false);
+        } else if (opcode == CLOSE) {
+            uint16_t code = 1005;
+            std::string reason;
+            if (length == 1) {
+                fail(1002, "Invalid close frame");
+                return false;
+            }
+            if (length >= 2) {
+                code = static_cast<uint16_t>((static_cast<unsigned char>(payload[0]) << 8) |
+                                             static_cast<unsigned char>(payload[1]));
+                if (!isValidCloseCode(code)) {
+                    fail(1002, "Invalid close code");
+                    return false;
+                }
+                if (!isValidUtf8(payload + 2, length - 2)) {
+                    fail(1007, "Invalid UTF-8 in close reason");
+                    return false;
+                }
+                reason.assign(payload + 2, length - 2);
+            }
+            close(code == 1005 ? 1000 : code);
+            notifyClose(code, reason);
+            return false;
+        } else if (opcode != PONG) {
+            fail(1002, "Unknown opcode");
+            return false;
+        }
+        return true;
+    }
+
+    if (opcode == CONTINUATION) {
+        if (messageOpcode == 0) {
+            fail(1002, "Unexpected continuation frame");
+            return false;
+        }
+    } else if (opcode == TEXT || opcode == BINARY) {
+        if (messageOpcode != 0) {
+            fail(1002, "Expected continuation frame");
+            return false;
+        }
+        messageOpcode = opcode;
+        messageCompressed = compressed;
+    } else {
+        fail(1002, "Unknown opcode");
+        return false;
+    }
+
+    message.append(payload, length);
+    if (!fin) return true;
+
+    bool binary = messageOpcode == BINARY;
+    messageOpcode = 0;
+
+    if (messageCompressed) {
+        messageCompressed = false;
+        std::string inflated;
+        try {
+            if (!deflate->decompress(message, inflated, Config::WEBSOCKET_MAX_MESSAGE_SIZE)) {
+                message.clear();
+                fail(1009, "Message too big");
+                return false;
+            }
+        } catch (const std::exception&) {
+            message.clear();
+            fail(1007, "Invalid compressed data");
+            return false;
+        }
+        message.swap(inflated);
+    }
+
+    if (!binary && !isValidUtf8(message.data(), message.size())) {
+        message.clear();
+        fail(1007, "Invalid UTF-8");
+        return false;
+    }
+
+    if (handlers->onMessage) {
+        try {
+            handlers->onMessage(*this, message, binary);
+        } catch (const std::exception& e) {
+            std::cerr << "WebSocket message handler failed: " << e.what() << std::endl;
+            message.clear();
+            fail(1011, "Internal error");
+            return false;
+        }
+    }
+    message.clear();
+    return true;
+}
+
+WebSocketChannel::WebSocketChannel(EventLoop& loop, WebSocketHandlers handlers, WebSocketCompression compression)
+    : loop(loop), handlers(std::make_shared<const WebSocketHandlers>(std::move(handlers))),
+      compression(compression) {}
+
+size_t WebSocketChannel::broadcast(const std::string& message, bool binary) {
+    uint8_t opcode = binary ? WebSocket::BINARY : WebSocket::TEXT;
+    EventLoop::Buffer plain;
+    // Shared compressed frames differ only by the negotiated server window
+    EventLoop::Buffer compressed[16];
+
+    std::vector<std::shared_ptr<WebSocket>> targets;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        targets.reserve(connections.size());
+        for (const auto& weak : connections) {
+            if (auto socket = weak.lock()) targets.push_back(std::move(socket));
+        }
+    }
+
+    size_t queued = 0;
+    for (const auto& socket : targets) {
+        if (socket->isClosed()) continue;
+
+        const PerMessageDeflate* deflate = socket->deflate.get();
+        if (deflate && message.size() >= deflate->getParams().minSize) {
+            if (!deflate->sharesEncoder()) {
+                if (socket->sendMessage(opcode, message)) queued++;
+                continue;
+            }
+
+            auto& frame = compressed[deflate->getParams().serverWindowBits];
+            if (!frame) {
+                std::string payload;
+                PerMessageDeflate::compressShared(deflate->getParams(), message.data(), message.size(), payload);
+                frame = std::make_shared<const std::string>(
+                    WebSocket::encodeFrame(opcode, payload.data(), payload.size(), true, true));
+            }
+            if (socket->send(frame)) queued++;
+            continue;
+        }
+
+        if (!plain) {
+            plain = std::make_shared<const std::string>(WebSocket::encodeFrame(opcode, message.data(), message.size()));
+        }
+        if (socket->send(plain)) queued++;
+    }
+    return queued;
+}
+
+void WebSocketChannel::closeAll(uint16_t code, const std::string& reason) {
+    std::vector<std::shared_ptr<WebSocket>> targets;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& weak : connections) {
+            if (auto socket = weak.lock()) targets.push_back(std::move(socket));
+        }
+    }
+    for (const auto& socket : targets) {
+        socket->close(code, reason);
+    }
+}
+
+size_t WebSocketChannel::connectionCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return connections.size();
+}
+
+void WebSocketChannel::remove(WebSocket* socket) {
+    std::lock_guard<std::mutex> lock(mutex);
+    connections.erase(
+        std::remove_if(connections.begin(), connections.end(),
+            [socket](const std::weak_ptr<WebSocket>& weak) {
+                auto current = weak.lock();
+                return !current || current.get() == socket;
+            }),
+        connections.end());
+}
+
+bool WebSocketChannel::accept(HttpContext& ctx) {
+    const auto& headers = ctx.req.headers;
+
+    if (!loop.isRunning()) {
+        ctx.res.setStatus(HttpStatus::SERVICE_UNAVAILABLE).setBody("Service Unavailable\n");
+        return false;
+    }
+
+    // The socket is shared with other HTTP/2 streams and cannot be parked
+    if (ctx.res.isMultiplexed()) {
+        ctx.res.setStatus(HttpStatus::HTTP_VERSION_NOT_SUPPORTED).setBody("HTTP/1.1 Required\n");
+        return false;
+    }
+
+    if (!Utils::hasToken(headers.get("Upgrade", ""), "websocket") ||
+        !Utils::hasToken(headers.get("Connection", ""), "upgrade") ||
+        !headers.has("Sec-WebSocket-Key")) {
+        ctx.res.setStatus(HttpStatus::BAD_REQUEST).setBody("Bad Request\n");
+        return false;
+    }
+
+    if (headers.get("Sec-WebSocket-Version", "") != "13") {
+        ctx.res.setStatus(HttpStatus::UPGRADE_REQUIRED)
+            .setHeader("Sec-WebSocket-Version", "13")
+            .setBody("Upgrade Required\n");
+        return false;
+    }
+
+    if (handlers->onConnect && !handlers->onConnect(ctx)) {
+        return false;
+    }
+
+    std::string accept = Utils::base64Encode(Utils::sha1(Utils::trim(headers["Sec-WebSocket-Key"]) + WEBSOCKET_GUID));
+
+    ctx.res.setStatus(HttpStatus::SWITCHING_PROTOCOLS);
+    ctx.res.setHeader("Upgrade", "websocket");
+    ctx.res.setHeader("Connection", "Upgrade");
+    ctx.res.setHeader("Sec-WebSocket-Accept", accept);
+
+    std::unique_ptr<PerMessageDeflate> deflate;
+    if (compression.enabled && headers.has("Sec-WebSocket-Extensions")) {
+        std::string extension;
+        deflate = PerMessageDeflate::negotiate(headers["Sec-WebSocket-Extensions"], compression, extension);
+        if (deflate) ctx.res.setHeader("Sec-WebSocket-Extensions", extension);
+    }
+    ctx.res.detach();
+
+    // The socket owns the descriptor from here on, also if the handshake fails
+    auto socket = std::make_shared<WebSocket>(ctx.res.getConnfd(), handlers, this, ctx.req.path,
+                                              ctx.req.params, std::move(deflate));
+
+    // Registered before the 101 goes out so a broadcast triggered by the
+    // client's first message cannot miss it; nothing queued is written
+    // until the loop owns the socket
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        connections.push_back(socket);
+    }
+
+    std::string head = ctx.res.toString();
+    if (!Socket::sendAll(ctx.res.getConnfd(), head.data(), head.length())) {
+        remove(socket.get());
+        return false;
+    }
+
+    if (handlers->onOpen) {
+        try {
+            handlers->onOpen(*socket);
+        } catch (const std::exception& e) {
+            std::cerr << "WebSocket open handler failed: " << e.what() << std::endl;
+        }
+    }
+
+    loop.add(socket);
+    return true;
+}
@@ -0,0 +1,76 @@
+#include <chrono>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+#include <zlib.h>
+
+#include "Utils.h"
+#include "Compression.h"
+
+namespace fs = std::filesystem;
+
+// Runs Compression::precompressDirectory on a scratch directory and checks
+// which siblings it writes: compressible files only, decoding back to the
+// source, and again once a sibling is older than its source.
+static size_t failed = 0;
+
+static void check(bool ok, const std::string& what) {
+    std::cout << (ok ? "✓ " : "✗ ") << what << std::endl;
+    if (!ok) failed++;
+}
+
+static void writeFile(const fs::path& path, const std::string& content) {
+    fs::create_directories(path.parent_path());
+    std::ofstream(path, std::ios::binary) << content;
+}
+
+static std::string gunzip(const std::string& data) {
+    z_stream zs{};
+    if (inflateInit2(&zs, 16 + MAX_WBITS) != Z_OK) return "";
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    zs.avail_in = static_cast<uInt>(data.size());
+
+    std::string out;
+    char buffer[16384];
+    int status;
+    do {
+        zs.next_out = reinterpret_cast<Bytef*>(buffer);
+        zs.avail_out = sizeof(buffer);
+        status = inflate(&zs, Z_NO_FLUSH);
+        out.append(buffer, sizeof(buffer) - zs.avail_out);
+    } while (status == Z_OK);
+    inflateEnd(&zs);
+    return status == Z_STREAM_END ? out : "";
+}
+
+int main() {
+    fs::path dir = fs::temp_directory_path() /
+        ("precompress_check_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()));
+    fs::remove_all(dir);
+
+    std::string script;
+    for (int i = 0; i < 200; i++) script += "console.log('line " + std::to_string(i % 10) + "');\n";
+    std::string style(4096, ' ');
+    writeFile(dir / "app.js", script);
+    writeFile(dir / "css" / "site.css", style);
+    writeFile(dir / "image.png", script);
+
+    size_t perFile = Compression::isAvailable(Compression::Encoding::Brotli) ? 2 : 1;
+    check(Compression::precompressDirectory(dir.string(), 2) == 2 * perFile, "writes siblings of compressible files");
+    check(gunzip(Utils::readFile((dir / "app.js.gz").string())) == script, "app.js.gz decodes to app.js");
+    check(fs::exists(dir / "css" / "site.css.gz"), "descends into subdirectories");
+    check(!fs::exists(dir / "image.png.gz"), "skips types that are not compressible");
+    check(Compression::precompressDirectory(dir.string(), 2) == 0, "leaves current siblings alone");
+
+    // A sibling older than its source is written again
+    script += "console.log('changed');\n";
+    writeFile(dir / "app.js", script);
+    fs::last_write_time(dir / "app.js.gz", fs::last_write_time(dir / "app.js") - std::chrono::seconds(10));
+    check(Compression::precompressDirectory(dir.string(), 2) >= 1, "rewrites a stale sibling");
+    check(gunzip(Utils::readFile((dir / "app.js.gz").string())) == script, "the new sibling has the new content");
+
+    fs::remove_all(dir);
+    std::cout << (failed == 0 ? "All checks passed" : std::to_string(failed) + " checks failed") << std::endl;
+    return failed == 0 ? 0 : 1;
+}
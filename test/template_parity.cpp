@@ -0,0 +1,59 @@
+#include <string>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+
+#include "Config.h"
+#include "Template.h"
+
+// Renders every template under Config::TEMPLATE_DIR with both the runtime
+// renderer and the function template_codegen generated for it, and fails
+// when any output differs. Linked with the generated templates.cpp and run
+// from the directory holding TEMPLATE_DIR (ctest does this).
+int main() {
+    const std::vector<json> contexts = {
+        json::object(),
+        {{"title", "Contacts <&> \"quoted\""},
+         {"contacts", json::array({
+             {{"name", "John Doe"}, {"email", "john.doe@mail.com"}, {"admin", true}},
+             {{"name", "Jane <Smith>"}, {"email", "jane@mail.com"}, {"admin", false}},
+             {{"name", nullptr}, {"admin", 1}}
+         })}},
+        {{"title", 42}, {"contacts", json::array()}},
+        {{"title", nullptr}, {"contacts", {{"not", "an array"}}}},
+        {{"title", json::array({1, 2})}, {"contacts", "text"}}
+    };
+
+    std::vector<std::string> names;
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(Config::TEMPLATE_DIR)) {
+        if (!entry.is_regular_file()) continue;
+        names.push_back(std::filesystem::relative(entry.path(), Config::TEMPLATE_DIR).generic_string());
+    }
+    std::sort(names.begin(), names.end());
+
+    size_t compared = 0, failed = 0;
+    for (const auto& name : names) {
+        const Template::Precompiled* precompiled = Template::findPrecompiled(name);
+        if (!precompiled) {
+            std::cout << "- " << name << ": runtime-loaded only" << std::endl;
+            continue;
+        }
+
+        auto runtime = Template::load(name);
+        for (size_t i = 0; i < contexts.size(); i++) {
+            std::string expected, actual;
+            runtime->render(contexts[i], expected);
+            precompiled->render(contexts[i], actual);
+            compared++;
+            if (expected != actual) {
+                failed++;
+                std::cout << "✗ " << name << " with context " << i << " differs:\n"
+                          << "--- runtime\n" << expected << "\n--- precompiled\n" << actual << std::endl;
+            }
+        }
+    }
+
+    std::cout << "Results: " << compared - failed << "/" << compared << " renders match" << std::endl;
+    return failed == 0 && compared > 0 ? 0 : 1;
+}
@@ -1,5 +1,7 @@
 import requests
 import logging
+import os
+import time
 from dataclasses import dataclass
 from http import HTTPStatus
 
@@ -9,12 +11,22 @@ logging.basicConfig(format='%(message)s', level=logging.INFO)
 @dataclass
 class ServerConfig:
     url: str = "http://localhost:8000"
+    # tests are run from the server's working directory
+    static_dir: str = "static"
 
 class TestServer:
     def __init__(self):
         self.config = ServerConfig()
         self.session = requests.Session()
 
+    def static_file(self, name, content):
+        """Writes a file for the server to serve, returning its URL"""
+        path = os.path.join(self.config.static_dir, name)
+        os.makedirs(os.path.dirname(path), exist_ok=True)
+        with open(path, "wb") as f:
+            f.write(content)
+        return f"{self.config.url}/{self.config.static_dir}/{name}"
+
     def test_root(self):
         """Test GET / endpoint"""
         # With name
@@ -41,6 +53,94 @@ class TestServer:
         assert data["name"] == "John Doe"
         assert data["email"] == "john.doe@mail.com"
 
+    def test_static_routes(self):
+        """Test GET /get-contact from the compile-time route table"""
+        r = self.session.get(f"{self.config.url}/get-contact?ignored=1")
+        assert r.status_code == 200 and r.json()["name"] == "John Doe"
+        # global middleware runs in front of table routes too
+        assert r.headers.get("X-Content-Type-Options") == "nosniff"
+        assert r.headers["Content-Type"] == "application/json"
+
+        # exact matches only
+        for path in ("/get-contact/", "/Get-Contact", "/get-contacts", "/get-contac"):
+            assert self.session.get(f"{self.config.url}{path}").status_code == 404, path
+        r = self.session.put(f"{self.config.url}/get-contact")
+        assert r.status_code == 405 and r.headers.get("Allow") == "GET"
+
+    def test_handler_forms(self):
+        """Test each supported route handler signature"""
+        # Response<std::string>, Response<json>, Response<HttpResponse>
+        assert self.session.get(f"{self.config.url}/?name=form").text == "Hello, form!"
+        assert self.session.get(f"{self.config.url}/contacts/1").json()["id"] == 1
+        assert "<title>Contacts</title>" in self.session.get(f"{self.config.url}/contacts").text
+
+        # void(HttpContext&) writing ctx.res
+        r = self.session.get(f"{self.config.url}/whoami")
+        assert r.status_code == 200 and r.headers["Content-Type"] == "application/json"
+        assert r.json()["ip"] == "127.0.0.1" and r.json()["port"] > 0
+
+        # (HttpContext&, ResponseWriter&)
+        r = self.session.get(f"{self.config.url}/export?rows=1")
+        assert r.headers.get("Transfer-Encoding") == "chunked" and r.text == "id,name\n1,user-1\n"
+
+    def test_route_priority(self):
+        """Test route priority, backtracking, wildcards and suffixes"""
+        def route(path):
+            r = self.session.get(f"{self.config.url}{path}")
+            return r.json() if r.status_code == 200 else r.status_code
+
+        # static over {x:int} over {x} over {path*}, whatever the registration order
+        assert route("/pick/latest") == {"pattern": "/pick/latest"}
+        assert route("/pick/42") == {"pattern": "/pick/{id:int}", "id": "42"}
+        assert route("/pick/forty-two") == {"pattern": "/pick/{name}", "name": "forty-two"}
+        assert route("/pick/a/b") == {"pattern": "/pick/{rest*}", "rest": "a/b"}
+        assert route("/pick/") == {"pattern": "/pick/{rest*}", "rest": ""}
+
+        # out of the static branch and into a variable
+        assert route("/edit/latest/feed") == {"pattern": "/edit/latest/feed"}
+        assert route("/edit/latest/edit") == {"pattern": "/edit/{name}/edit", "name": "latest"}
+
+        assert route("/raw/x/y.txt") == {"pattern": "/raw/*", "*": "x/y.txt"}
+        assert route("/raw/") == {"pattern": "/raw/*", "*": ""}
+
+        assert route("/export/report.json") == {"pattern": "/export/{name}.json", "name": "report"}
+        assert route("/export/v1.2.json") == {"pattern": "/export/{name}.json", "name": "v1.2"}
+        assert route("/export/report.xml") == 404
+
+        # {name} does not match an empty segment
+        assert route("/edit//edit") == 404
+
+    def test_typed_routes(self):
+        """Test int, int64, uint, uuid and custom path variable types"""
+        def value(path):
+            r = self.session.get(f"{self.config.url}/typed/{path}")
+            if r.status_code != 200:
+                return r.status_code
+            body = r.json()
+            return body["value"] if "value" in body else body["v"]
+
+        assert value("int/-2147483648") == -2147483648
+        assert value("int/2147483647") == 2147483647
+        assert value("int/2147483648") == 404
+        assert value("int/12a") == 404
+
+        assert value("int64/-9223372036854775808") == -9223372036854775808
+        assert value("int64/9223372036854775807") == 9223372036854775807
+        assert value("int64/9223372036854775808") == 404
+
+        assert value("uint/18446744073709551615") == 18446744073709551615
+        assert value("uint/18446744073709551616") == 404
+        assert value("uint/-1") == 404
+
+        uuid = "123e4567-e89b-12d3-a456-426614174000"
+        assert value(f"uuid/{uuid}") == uuid
+        assert value(f"uuid/{uuid[:-1]}") == 404
+        assert value(f"uuid/{uuid.replace('-', '_')}") == 404
+
+        # defined with Router::defineType
+        assert value("hex/c0ffee") == "c0ffee"
+        assert value("hex/coffee") == 404
+
     def test_cookie(self):
         """Test GET /set-cookie endpoint"""
         r = self.session.get(f"{self.config.url}/set-cookie")
@@ -82,15 +182,522 @@ class TestServer:
         r = self.session.post(f"{self.config.url}/upload-file")
         assert r.status_code == 400 and r.text == "No files uploaded"
 
+    def test_conditional(self):
+        """Test conditional GET with ETag and Last-Modified"""
+        r = self.session.get(f"{self.config.url}/set-cookie")
+        assert r.status_code == 200
+        assert "ETag" in r.headers and "Last-Modified" in r.headers
+
+        # Matching ETag
+        r2 = self.session.get(f"{self.config.url}/set-cookie",
+                              headers={"If-None-Match": r.headers["ETag"]})
+        assert r2.status_code == 304 and r2.content == b""
+
+        # Matching date
+        r3 = self.session.get(f"{self.config.url}/set-cookie",
+                              headers={"If-Modified-Since": r.headers["Last-Modified"]})
+        assert r3.status_code == 304
+
+        # Stale ETag
+        r4 = self.session.get(f"{self.config.url}/set-cookie",
+                              headers={"If-None-Match": '"stale"'})
+        assert r4.status_code == 200 and len(r4.content) > 0
+
+    def test_mime_types(self):
+        """Test static file MIME types by extension and content"""
+        png = bytes([0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A]) + b"\x00" * 32
+        cases = [
+            ("mime/style.css", b"body {}", "text/css"),
+            ("mime/APP.JS", b"let a = 1;", "application/javascript"),
+            ("mime/data.json", b"{}", "application/json"),
+            ("mime/icon.svg", b"<svg/>", "image/svg+xml"),
+            # unknown or missing extensions fall back to the file's signature
+            ("mime/picture", png, "image/png"),
+            ("mime/picture.unknown", png, "image/png"),
+            ("mime/v1.0/picture", png, "image/png"),
+            ("mime/notes.unknown", b"plain words", "application/octet-stream"),
+        ]
+        for name, content, expected in cases:
+            r = self.session.get(self.static_file(name, content))
+            assert r.status_code == 200 and r.content == content, name
+            assert r.headers["Content-Type"] == expected, (name, r.headers["Content-Type"])
+
+    def test_compression(self):
+        """Test gzip size threshold and content types"""
+        gzip_only = {"Accept-Encoding": "gzip"}
+        text = (b"compressible line of text\n" * 400)[:4000]
+
+        r = self.session.get(self.static_file("gzip/small.txt", text[:1023]), headers=gzip_only)
+        assert "Content-Encoding" not in r.headers and r.content == text[:1023]
+
+        r = self.session.get(self.static_file("gzip/medium.txt", text[:1024]), headers=gzip_only)
+        assert r.headers.get("Content-Encoding") == "gzip" and r.content == text[:1024]
+        assert r.headers.get("Vary") == "Accept-Encoding"
+        # compressed before the use() middleware, which still adds its header
+        assert r.headers.get("X-Content-Type-Options") == "nosniff"
+
+        # Large bodies switch to a faster level, still a valid gzip stream
+        large = text * 400
+        r = self.session.get(self.static_file("gzip/large.txt", large), headers=gzip_only)
+        assert r.headers.get("Content-Encoding") == "gzip" and r.content == large
+        assert int(r.raw.headers["Content-Length"]) < len(large) // 10
+
+        # Not compressed: already compressed types, refused or missing codings
+        png = bytes([0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A]) + text
+        r = self.session.get(self.static_file("gzip/image.png", png), headers=gzip_only)
+        assert "Content-Encoding" not in r.headers and r.content == png
+        url = self.static_file("gzip/refused.txt", text)
+        for accept in ("identity", "gzip;q=0", ""):
+            r = self.session.get(url, headers={"Accept-Encoding": accept})
+            assert "Content-Encoding" not in r.headers and r.content == text, accept
+
+    def test_precompressed(self):
+        """Test .gz and .br siblings of static files"""
+        import gzip
+        run = time.time_ns()
+        source = b"function hello() { return 'hello'; }\n" * 100
+        # the siblings hold a marked copy, so they can be told from
+        # compression on the fly
+        marked = source + b"// precompressed\n"
+        url = self.static_file(f"pre/{run}/app.js", source)
+        gz = gzip.compress(marked)
+        self.static_file(f"pre/{run}/app.js.gz", gz)
+
+        r = self.session.get(url, headers={"Accept-Encoding": "gzip"}, stream=True)
+        assert r.status_code == 200 and r.headers.get("Content-Encoding") == "gzip"
+        assert r.headers.get("Vary") == "Accept-Encoding"
+        assert r.headers["ETag"].endswith('-gzip"')
+        assert r.raw.read(decode_content=False) == gz
+
+        # Without gzip accepted, the source itself
+        r = self.session.get(url, headers={"Accept-Encoding": "identity"})
+        assert "Content-Encoding" not in r.headers and r.content == source
+        assert not r.headers["ETag"].endswith('-gzip"')
+
+        # br wins when both exist and are accepted
+        br = b"not really brotli, only served as is"
+        self.static_file(f"pre/{run}/app.js.br", br)
+        r = self.session.get(url, headers={"Accept-Encoding": "gzip, br"}, stream=True)
+        assert r.headers.get("Content-Encoding") == "br" and r.headers["ETag"].endswith('-br"')
+        assert r.raw.read(decode_content=False) == br
+        r = self.session.get(url, headers={"Accept-Encoding": "gzip"})
+        assert r.content == marked
+
+        # A sibling older than its source is ignored
+        path = os.path.join(self.config.static_dir, f"pre/{run}/app.js")
+        mtime = os.stat(path).st_mtime
+        for suffix in (".gz", ".br"):
+            os.utime(path + suffix, (mtime - 10, mtime - 10))
+        r = self.session.get(url, headers={"Accept-Encoding": "gzip"})
+        assert r.status_code == 200 and r.content == source
+        r = self.session.get(url, headers={"Accept-Encoding": "gzip, br"}, stream=True)
+        assert r.raw.read(decode_content=False) != br
+
+    def test_compression_cache(self):
+        """Test the compressed body cache: hits, evictions and hash collisions"""
+        import struct
+        gzip_only = {"Accept-Encoding": "gzip"}
+        stats = lambda: self.session.get(f"{self.config.url}/compression-stats").json()
+        run = time.time_ns()
+        text = b"cached line of text\n" * 100
+
+        # Compressed once, then served from the cache
+        url = self.static_file(f"cache/{run}/hit.txt", text)
+        before = stats()
+        for _ in range(3):
+            r = self.session.get(url, headers=gzip_only)
+            assert r.headers.get("Content-Encoding") == "gzip" and r.content == text
+        after = stats()
+        assert after["misses"] - before["misses"] == 1 and after["hits"] - before["hits"] == 2
+
+        # More bodies than the stripes can hold push older ones out
+        before = stats()
+        for i in range(24):
+            body = os.urandom(15000).hex().encode()
+            assert self.session.get(self.static_file(f"cache/{run}/{i}.txt", body), headers=gzip_only).content == body
+        after = stats()
+        assert after["evictions"] > before["evictions"] and after["bytes"] <= 1024 * 1024
+
+        # Two bodies with the same size and MurmurHash64A: the first blocks
+        # differ, the second ones are chosen to bring the state back together
+        M, MASK = 0xc6a4a7935bd1e995, (1 << 64) - 1
+        inverse = pow(M, -1, 1 << 64)
+        def mix(k):
+            k = k * M & MASK
+            return (k ^ k >> 47) * M & MASK
+        def unmix(k):
+            k = k * inverse & MASK
+            return (k ^ k >> 47) * inverse & MASK
+        # a tail of this run's own, or the bodies may be cached already
+        text = f"{run}\n".encode() + text
+        h0 = (16 + len(text)) * M & MASK
+        a, b, c = 1, 2, 3
+        d = unmix(((h0 ^ mix(a)) * M & MASK) ^ mix(b) ^ ((h0 ^ mix(c)) * M & MASK))
+        first = struct.pack("<QQ", a, b) + text
+        second = struct.pack("<QQ", c, d) + text
+        first_url = self.static_file(f"cache/{run}/first.txt", first)
+        second_url = self.static_file(f"cache/{run}/second.txt", second)
+
+        before = stats()
+        for url, body in ((first_url, first), (second_url, second), (first_url, first)):
+            r = self.session.get(url, headers=gzip_only)
+            assert r.headers.get("Content-Encoding") == "gzip" and r.content == body
+        after = stats()
+        # each replaced the other, so none was a hit
+        assert after["misses"] - before["misses"] == 3 and after["hits"] == before["hits"]
+
+    def test_gzip_reuse(self):
+        """Test gzip streams reused across requests and levels"""
+        from concurrent.futures import ThreadPoolExecutor
+        bodies = {
+            f"reuse/{i}.txt": (f"body {i} ".encode() * (300 + 97 * i)) + (b"z" * (1024 * 1024) if i % 3 == 0 else b"")
+            for i in range(6)
+        }
+        urls = {self.static_file(name, content): content for name, content in bodies.items()}
+
+        def fetch_all(_):
+            # One keep-alive connection, so one worker thread and its streams
+            session = requests.Session()
+            for _ in range(3):
+                for url, content in urls.items():
+                    r = session.get(url, headers={"Accept-Encoding": "gzip"})
+                    if r.headers.get("Content-Encoding") != "gzip" or r.content != content:
+                        return False
+            return True
+
+        with ThreadPoolExecutor(max_workers=4) as pool:
+            assert all(pool.map(fetch_all, range(4)))
+
+    def test_content_negotiation(self):
+        """Test Accept-Encoding negotiation by q-value"""
+        text = b"negotiated content\n" * 200
+        url = self.static_file("negotiate/page.txt", text)
+
+        def encoding(accept):
+            r = self.session.get(url, headers={"Accept-Encoding": accept}, stream=True)
+            coding = r.headers.get("Content-Encoding", "identity")
+            if coding != "identity":
+                # strong validators differ per coding
+                assert r.headers["ETag"].endswith(f'-{coding}"'), r.headers["ETag"]
+            if coding in ("identity", "gzip"):
+                assert r.content == text
+            r.close()
+            return coding
+
+        # the client's q-values win over the server's preference order
+        assert encoding("gzip;q=1.0, br;q=0.5, zstd;q=0.4") == "gzip"
+        # br and zstd are optional at build time; gzip is always there
+        assert encoding("br;q=1.0, gzip;q=0.5") in ("br", "gzip")
+        assert encoding("zstd, gzip;q=0.5") in ("zstd", "gzip")
+        assert encoding("gzip, br, zstd") in ("zstd", "br", "gzip")
+        assert encoding("*") in ("zstd", "br", "gzip")
+        # refused or outranked by identity
+        assert encoding("br;q=0, zstd;q=0, gzip;q=0") == "identity"
+        assert encoding("*;q=0") == "identity"
+        assert encoding("identity;q=1, gzip;q=0.5") == "identity"
+        assert encoding("compress, x-unknown") == "identity"
+
+    def test_range(self):
+        """Test Range requests on static files"""
+        content = b"0123456789" * 100
+        url = self.static_file("range-test.bin", content)
+
+        r = self.session.get(url, headers={"Range": "bytes=10-19"})
+        assert r.status_code == 206 and r.content == content[10:20]
+        assert r.headers["Content-Range"] == "bytes 10-19/1000"
+
+        r = self.session.get(url, headers={"Range": "bytes=-5"})
+        assert r.status_code == 206 and r.content == content[-5:]
+
+        r = self.session.get(url, headers={"Range": "bytes=0-4,100-104"})
+        assert r.status_code == 206
+        assert r.headers["Content-Type"].startswith("multipart/byteranges; boundary=")
+        assert b"Content-Range: bytes 0-4/1000" in r.content
+        assert b"Content-Range: bytes 100-104/1000" in r.content
+
+        # Overlapping and adjacent ranges are merged
+        r = self.session.get(url, headers={"Range": "bytes=0-9,5-19,20-29"})
+        assert r.status_code == 206 and r.content == content[0:30]
+        assert r.headers["Content-Range"] == "bytes 0-29/1000"
+
+        # More than the whole file is answered with the whole file
+        r = self.session.get(url, headers={"Range": "bytes=0-999,0-999"})
+        assert r.status_code == 200 and r.content == content
+
+        r = self.session.get(url, headers={"Range": "bytes=5000-"})
+        assert r.status_code == 416
+        assert r.headers["Content-Range"] == "bytes */1000"
+
+        etag = self.session.get(url).headers["ETag"]
+        r = self.session.get(url, headers={"Range": "bytes=0-9", "If-Range": etag})
+        assert r.status_code == 206 and r.content == content[:10]
+        r = self.session.get(url, headers={"Range": "bytes=0-9", "If-Range": '"stale"'})
+        assert r.status_code == 200 and r.content == content
+
+    def test_template(self):
+        """Test GET /contacts template rendering"""
+        r = self.session.get(f"{self.config.url}/contacts")
+        assert r.status_code == 200
+        assert r.headers["Content-Type"].startswith("text/html")
+        assert "<title>Contacts</title>" in r.text
+        assert '<li id="contact-1">John Doe &lt;john.doe@mail.com&gt; (admin)</li>' in r.text
+        assert "Jane &lt;Smith&gt;" in r.text and "{{" not in r.text
+
+    def test_path_vars(self):
+        """Test GET /contacts/{id:int} path variables"""
+        r = self.session.get(f"{self.config.url}/contacts/1")
+        assert r.status_code == 200
+        assert r.json() == {"id": 1, "name": "John Doe", "email": "john.doe@mail.com"}
+        assert self.session.get(f"{self.config.url}/contacts/2").status_code == 404
+        assert self.session.get(f"{self.config.url}/contacts/abc").status_code == 404
+        assert self.session.get(f"{self.config.url}/contacts/99999999999").status_code == 404
+
+    def test_method_not_allowed(self):
+        """Test 405 with Allow for known paths"""
+        r = self.session.delete(f"{self.config.url}/contacts/1")
+        assert r.status_code == 405
+        assert r.headers.get("Allow") == "GET"
+        r = self.session.post(f"{self.config.url}/get-contact")
+        assert r.status_code == 405 and r.headers.get("Allow") == "GET"
+        assert self.session.delete(f"{self.config.url}/no-such-path").status_code == 404
+
+    def test_middleware(self):
+        """Test global and per-route middleware"""
+        r = self.session.get(f"{self.config.url}/")
+        assert r.headers.get("X-Content-Type-Options") == "nosniff"
+        r = self.session.get(f"{self.config.url}/health")
+        assert r.status_code == 200 and r.headers.get("X-Content-Type-Options") == "nosniff"
+        r = self.session.post(f"{self.config.url}/publish", data="hi")
+        assert r.status_code == 401
+        r = self.session.post(f"{self.config.url}/publish", data="hi",
+                              headers={"Authorization": "Bearer secret"})
+        assert r.status_code == 200 and r.text.startswith("Delivered to")
+
+    def test_rate_limit(self):
+        """Test 429 with Retry-After from the upload rate limiter"""
+        statuses = []
+        for _ in range(10):
+            r = self.session.post(f"{self.config.url}/upload-file")
+            statuses.append(r.status_code)
+            if r.status_code == 429:
+                assert int(r.headers.get("Retry-After", "0")) >= 1
+        assert 400 in statuses and 429 in statuses
+
+    def test_rate_limit_burst(self):
+        """Test the upload rate limiter allows exactly its burst"""
+        import random
+        import socket
+        # A loopback address of its own gives this run a full bucket
+        address = f"127.{random.randint(1, 254)}.{random.randint(1, 254)}.{random.randint(2, 254)}"
+        request = (b"POST /upload-file HTTP/1.1\r\nHost: localhost\r\n"
+                   b"Content-Length: 0\r\nConnection: close\r\n\r\n")
+
+        responses = []
+        for _ in range(6):
+            with socket.create_connection(("127.0.0.1", 8000), timeout=5, source_address=(address, 0)) as sock:
+                sock.sendall(request)
+                response = b""
+                while chunk := sock.recv(4096):
+                    response += chunk
+                responses.append(response.decode(errors="replace"))
+
+        statuses = [int(r.split(" ")[1]) for r in responses]
+        assert statuses[:5] == [400] * 5, statuses
+        assert statuses[5] == 429, statuses
+        retry_after = [line for line in responses[5].split("\r\n") if line.lower().startswith("retry-after:")]
+        assert retry_after and int(retry_after[0].split(":")[1]) >= 1
+
+    def test_response_cache(self):
+        """Test GET /stats response cache with stale-while-revalidate"""
+        # A key of its own, so entries left by an earlier run do not answer
+        key = f"cache-{time.time_ns()}"
+        first = self.session.get(f"{self.config.url}/stats?v={key}").json()
+        again = self.session.get(f"{self.config.url}/stats?v={key}&other=1").json()
+        assert first == again
+        other = self.session.get(f"{self.config.url}/stats?v={key}-other").json()
+        assert other["generation"] > first["generation"]
+
+        time.sleep(1.2)
+        stale = self.session.get(f"{self.config.url}/stats?v={key}").json()
+        assert stale == first
+        # refreshed once the stale response is out
+        for _ in range(20):
+            fresh = self.session.get(f"{self.config.url}/stats?v={key}").json()
+            if fresh != first:
+                break
+            time.sleep(0.05)
+        assert fresh["generation"] > other["generation"]
+
+    def test_stale_refresh(self):
+        """Test stale responses do not wait for their refresh"""
+        url = f"{self.config.url}/stats?v=slow-{time.time_ns()}&delay=500"
+        start = time.monotonic()
+        first = self.session.get(url).json()
+        assert time.monotonic() - start >= 0.5
+
+        time.sleep(1.2)
+        # The stale hit and the next request on the same connection are
+        # both answered while the refresh is still running
+        start = time.monotonic()
+        assert self.session.get(url).json() == first
+        assert self.session.get(url).json() == first
+        assert time.monotonic() - start < 0.4
+
+        time.sleep(0.7)
+        assert self.session.get(url).json()["generation"] > first["generation"]
+
+        # Path variables of the refreshed copy are its own
+        name = f"name-{time.time_ns()}"
+        url = f"{self.config.url}/stats/{name}?delay=100"
+        first = self.session.get(url).json()
+        time.sleep(1.2)
+        assert self.session.get(url).json() == first
+        time.sleep(0.4)
+        fresh = self.session.get(url).json()
+        assert fresh["name"] == name and fresh["generation"] > first["generation"]
+
+    def test_coalescing(self):
+        """Test GET /report request coalescing"""
+        from concurrent.futures import ThreadPoolExecutor
+        def fetch(_):
+            return requests.get(f"{self.config.url}/report").json()["report"]
+        with ThreadPoolExecutor(max_workers=5) as pool:
+            reports = list(pool.map(fetch, range(5)))
+        assert len(set(reports)) < len(reports)
+        assert fetch(0) > max(reports)
+
+    def test_coalescing_partial(self):
+        """Test only full 200 responses are shared between coalesced requests"""
+        from concurrent.futures import ThreadPoolExecutor
+        content = bytes(range(256)) * 64
+        url = self.static_file(f"shared/{time.time_ns()}.bin", content).replace("/static/", "/shared/", 1)
+
+        def fetch(headers):
+            r = requests.get(url, headers=headers)
+            return r.status_code, r.content
+        with ThreadPoolExecutor(max_workers=5) as pool:
+            ranged = pool.submit(fetch, {"Range": "bytes=0-9"})
+            time.sleep(0.05)
+            full = [pool.submit(fetch, {}) for _ in range(4)]
+            assert ranged.result() == (206, content[:10])
+            for f in full:
+                assert f.result() == (200, content)
+
+        # nor are errors
+        missing = url + ".missing"
+        with ThreadPoolExecutor(max_workers=3) as pool:
+            statuses = list(pool.map(lambda _: requests.get(missing).status_code, range(3)))
+        assert statuses == [404] * 3
+
+    def test_stream(self):
+        """Test GET /export streaming endpoint"""
+        r = self.session.get(f"{self.config.url}/export", stream=True)
+        assert r.status_code == 200
+        assert r.headers.get("Transfer-Encoding") == "chunked"
+        lines = r.text.splitlines()
+        assert lines[0] == "id,name" and lines[-1] == "1000,user-1000"
+        assert len(lines) == 1001
+
+        r = self.session.get(f"{self.config.url}/export?rows=3")
+        assert r.text == "id,name\n1,user-1\n2,user-2\n3,user-3\n"
+
+        # Failing before the first write still gets an error response
+        r = self.session.get(f"{self.config.url}/export?rows=many")
+        assert r.status_code == 500 and "Transfer-Encoding" not in r.headers
+        assert self.session.get(f"{self.config.url}/export?rows=1").status_code == 200
+
+    def test_stream_compression(self):
+        """Test gzip on streamed responses"""
+        import gzip
+        import socket
+        expected = "id,name\n" + "".join(f"{i},user-{i}\n" for i in range(1, 1001))
+
+        r = self.session.get(f"{self.config.url}/export", headers={"Accept-Encoding": "gzip"}, stream=True)
+        assert r.headers.get("Content-Encoding") == "gzip"
+        assert r.headers.get("Transfer-Encoding") == "chunked"
+        raw = r.raw.read(decode_content=False)
+        assert len(raw) < len(expected) // 2 and gzip.decompress(raw).decode() == expected
+
+        # A body that ends below the size threshold goes out uncompressed
+        r = self.session.get(f"{self.config.url}/export?rows=2", headers={"Accept-Encoding": "gzip"})
+        assert "Content-Encoding" not in r.headers and r.text == "id,name\n1,user-1\n2,user-2\n"
+
+        # HTTP/1.0 has no chunked coding: the body ends with the connection
+        with socket.create_connection(("localhost", 8000), timeout=5) as sock:
+            sock.sendall(b"GET /export HTTP/1.0\r\nAccept-Encoding: gzip\r\n\r\n")
+            response = b""
+            while True:
+                data = sock.recv(65536)
+                if not data:
+                    break
+                response += data
+        head, body = response.split(b"\r\n\r\n", 1)
+        assert b"Content-Encoding: gzip" in head and b"Transfer-Encoding" not in head
+        assert gzip.decompress(body).decode() == expected
+
+    def test_events(self):
+        """Test GET /events receiving published messages"""
+        import socket
+
+        def subscribe():
+            sock = socket.create_connection(("localhost", 8000), timeout=5)
+            sock.sendall(b"GET /events HTTP/1.1\r\nHost: localhost\r\nAccept: text/event-stream\r\n\r\n")
+            head = b""
+            while b"\r\n\r\n" not in head:
+                head += sock.recv(4096)
+            head, rest = head.split(b"\r\n\r\n", 1)
+            assert b" 200 " in head.split(b"\r\n")[0]
+            assert b"Content-Type: text/event-stream" in head
+            return sock, rest
+
+        subscribers = [subscribe(), subscribe()]
+        r = self.session.post(f"{self.config.url}/publish", data="first line\nsecond line",
+                              headers={"Authorization": "Bearer secret"})
+        assert r.status_code == 200
+        assert int(r.text.split()[2]) >= len(subscribers)
+
+        expected = b"event: message\ndata: first line\ndata: second line\n\n"
+        for sock, received in subscribers:
+            while expected not in received:
+                data = sock.recv(4096)
+                assert data, "subscriber closed"
+                received += data
+            sock.close()
+
 def run_tests():
     """Run all tests"""
     server = TestServer()
     tests = [
         server.test_root,
         server.test_contact,
+        server.test_static_routes,
+        server.test_handler_forms,
+        server.test_route_priority,
+        server.test_typed_routes,
         server.test_cookie,
         server.test_submit,
-        server.test_upload
+        server.test_upload,
+        server.test_conditional,
+        server.test_mime_types,
+        server.test_compression,
+        server.test_precompressed,
+        server.test_compression_cache,
+        server.test_gzip_reuse,
+        server.test_content_negotiation,
+        server.test_range,
+        server.test_template,
+        server.test_path_vars,
+        server.test_method_not_allowed,
+        server.test_middleware,
+        server.test_rate_limit,
+        server.test_rate_limit_burst,
+        server.test_response_cache,
+        server.test_stale_refresh,
+        server.test_coalescing,
+        server.test_coalescing_partial,
+        server.test_stream,
+        server.test_stream_compression,
+        server.test_events
     ]
 
     passed = failed = 0
@@ -0,0 +1,188 @@
+import base64
+import logging
+import os
+import socket
+
+import h2.config
+import h2.connection
+import h2.events
+import h2.settings
+
+# Basic logging
+logging.basicConfig(format='%(message)s', level=logging.INFO)
+
+class Http2Client:
+    """h2c client over one connection, with prior knowledge or an Upgrade"""
+    def __init__(self, host='localhost', port=8000, settings=None, upgrade=False):
+        self.sock = socket.create_connection((host, port), timeout=5)
+        self.conn = h2.connection.H2Connection(h2.config.H2Configuration(client_side=True))
+        self.events = []
+        self.upgrade_status = None
+
+        if upgrade:
+            http2_settings = self.conn.initiate_upgrade_connection()
+            self.sock.sendall(
+                b"GET /?name=upgrade HTTP/1.1\r\n"
+                b"Host: localhost\r\n"
+                b"Connection: Upgrade, HTTP2-Settings\r\n"
+                b"Upgrade: h2c\r\n"
+                b"HTTP2-Settings: " + http2_settings + b"\r\n\r\n")
+            response = b""
+            while b"\r\n\r\n" not in response:
+                response += self.sock.recv(65536)
+            head, rest = response.split(b"\r\n\r\n", 1)
+            self.upgrade_status = int(head.split(b" ")[1])
+            self.flush()
+            self.receive(rest)
+        else:
+            self.conn.initiate_connection()
+            if settings:
+                self.conn.update_settings(settings)
+            self.flush()
+
+    def flush(self):
+        data = self.conn.data_to_send()
+        if data:
+            self.sock.sendall(data)
+
+    def receive(self, data):
+        for event in self.conn.receive_data(data):
+            if isinstance(event, h2.events.DataReceived):
+                self.conn.acknowledge_received_data(event.flow_controlled_length, event.stream_id)
+            self.events.append(event)
+        self.flush()
+
+    def wait_for(self, done):
+        """Reads until done(events) holds"""
+        while not done(self.events):
+            data = self.sock.recv(65536)
+            if not data:
+                raise ConnectionError("Connection closed")
+            self.receive(data)
+
+    def request(self, path, headers=None, method="GET"):
+        stream_id = self.conn.get_next_available_stream_id()
+        self.conn.send_headers(stream_id, [
+            (":method", method), (":path", path), (":scheme", "http"), (":authority", "localhost")
+        ] + (headers or []), end_stream=True)
+        self.flush()
+        return self.response(stream_id)
+
+    def response(self, stream_id):
+        """Returns (status, headers, body) once the stream has ended"""
+        self.wait_for(lambda events: any(
+            isinstance(e, (h2.events.StreamEnded, h2.events.StreamReset)) and e.stream_id == stream_id
+            for e in events))
+        headers, body = {}, b""
+        for e in self.events:
+            if getattr(e, "stream_id", None) != stream_id:
+                continue
+            if isinstance(e, h2.events.ResponseReceived):
+                headers = {k.decode(): v.decode() for k, v in e.headers}
+            elif isinstance(e, h2.events.DataReceived):
+                body += e.data
+        return int(headers.get(":status", 0)), headers, body
+
+    def close(self):
+        self.conn.close_connection()
+        self.flush()
+        self.sock.close()
+
+class TestHttp2:
+    def test_preface(self):
+        """Test h2c connection preface and SETTINGS exchange"""
+        client = Http2Client()
+        client.wait_for(lambda events: any(isinstance(e, h2.events.RemoteSettingsChanged) for e in events) and
+                        any(isinstance(e, h2.events.SettingsAcknowledged) for e in events))
+        settings = next(e for e in client.events if isinstance(e, h2.events.RemoteSettingsChanged))
+        assert h2.settings.SettingCodes.MAX_HEADER_LIST_SIZE in settings.changed_settings
+        client.close()
+
+        # Garbage instead of the preface is not answered as HTTP/2
+        with socket.create_connection(("localhost", 8000), timeout=5) as sock:
+            sock.sendall(b"PRI * HTTP/2.0\r\n\r\nXX\r\n\r\n")
+            assert not sock.recv(4096).startswith(b"\x00")
+
+    def test_get(self):
+        """Test GET over h2c"""
+        client = Http2Client()
+        status, headers, body = client.request("/?name=h2")
+        assert status == 200 and body == b"Hello, h2!"
+        status, headers, body = client.request("/contacts/1")
+        assert status == 200 and headers["content-type"] == "application/json"
+        assert client.request("/no-such-path")[0] == 404
+        client.close()
+
+        client = Http2Client(upgrade=True)
+        assert client.upgrade_status == 101
+        status, headers, body = client.response(1)
+        assert status == 200 and body == b"Hello, upgrade!"
+        assert client.request("/?name=after")[2] == b"Hello, after!"
+        client.close()
+
+    def test_flow_control(self):
+        """Test h2c flow control with a small window"""
+        client = Http2Client(settings={h2.settings.SettingCodes.INITIAL_WINDOW_SIZE: 100})
+        streams = []
+        for _ in range(4):
+            stream_id = client.conn.get_next_available_stream_id()
+            client.conn.send_headers(stream_id, [
+                (":method", "GET"), (":path", "/export"), (":scheme", "http"), (":authority", "localhost")
+            ], end_stream=True)
+            streams.append(stream_id)
+        client.flush()
+
+        for stream_id in streams:
+            status, headers, body = client.response(stream_id)
+            lines = body.decode().splitlines()
+            assert status == 200 and len(lines) == 1001 and lines[-1] == "1000,user-1000"
+        # no DATA frame went past the window we gave
+        assert all(len(e.data) <= 100 for e in client.events if isinstance(e, h2.events.DataReceived))
+        client.close()
+
+    def test_header_list_size(self):
+        """Test an oversized h2c header block gets 431"""
+        client = Http2Client()
+        client.wait_for(lambda events: any(isinstance(e, h2.events.RemoteSettingsChanged) for e in events))
+
+        # Indexed fields, so the server must keep its table in step while
+        # skipping them
+        big = [(f"x-filler-{i}", base64.b64encode(os.urandom(750)).decode()) for i in range(70)]
+        status, headers, body = client.request("/?name=big", big)
+        assert status == 431
+
+        # The connection and its HPACK state survive
+        status, headers, body = client.request("/?name=small", [("x-filler-69", big[-1][1])])
+        assert status == 200 and body == b"Hello, small!"
+        client.close()
+
+def run_tests():
+    """Run all tests"""
+    suite = TestHttp2()
+    tests = [
+        suite.test_preface,
+        suite.test_get,
+        suite.test_flow_control,
+        suite.test_header_list_size
+    ]
+
+    passed = failed = 0
+    for test in tests:
+        try:
+            test()
+            logging.info(f"✓ {test.__doc__}")
+            passed += 1
+        except AssertionError as e:
+            logging.error(f"✗ {test.__doc__}: {str(e)}")
+            failed += 1
+        except Exception as e:
+            logging.error(f"✗ {test.__doc__}: Unexpected error: {str(e)}")
+            failed += 1
+
+    total = passed + failed
+    logging.info(f"\nResults: {passed}/{total} tests passed")
+    return failed == 0
+
+if __name__ == "__main__":
+    import sys
+    sys.exit(0 if run_tests() else 1)
@@ -0,0 +1,274 @@
+import base64
+import hashlib
+import logging
+import os
+import socket
+import struct
+import zlib
+
+# Basic logging
+logging.basicConfig(format='%(message)s', level=logging.INFO)
+
+GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+TEXT, BINARY, CLOSE, PING, PONG = 0x1, 0x2, 0x8, 0x9, 0xA
+
+class WebSocketClient:
+    def __init__(self, host='localhost', port=8000, path='/ws', extensions=None):
+        self.sock = socket.create_connection((host, port), timeout=5)
+        self.buffer = b""
+        key = base64.b64encode(os.urandom(16)).decode()
+        request = (
+            f"GET {path} HTTP/1.1\r\n"
+            f"Host: {host}:{port}\r\n"
+            "Upgrade: websocket\r\n"
+            "Connection: Upgrade\r\n"
+            f"Sec-WebSocket-Key: {key}\r\n"
+            "Sec-WebSocket-Version: 13\r\n"
+        )
+        if extensions:
+            request += f"Sec-WebSocket-Extensions: {extensions}\r\n"
+        self.sock.sendall((request + "\r\n").encode())
+
+        head = self._read_until(b"\r\n\r\n").decode()
+        self.status = int(head.split(" ")[1])
+        self.headers = {}
+        for line in head.split("\r\n")[1:]:
+            if ":" in line:
+                name, value = line.split(":", 1)
+                self.headers[name.strip().lower()] = value.strip()
+        expected = base64.b64encode(hashlib.sha1((key + GUID).encode()).digest()).decode()
+        self.accepted = self.headers.get("sec-websocket-accept") == expected
+
+    def _read_until(self, marker):
+        while marker not in self.buffer:
+            data = self.sock.recv(65536)
+            if not data:
+                raise ConnectionError("Connection closed")
+            self.buffer += data
+        head, self.buffer = self.buffer.split(marker, 1)
+        return head
+
+    def _read(self, n):
+        while len(self.buffer) < n:
+            data = self.sock.recv(65536)
+            if not data:
+                raise ConnectionError("Connection closed")
+            self.buffer += data
+        data, self.buffer = self.buffer[:n], self.buffer[n:]
+        return data
+
+    def send_frame(self, opcode, payload, fin=True, masked=True, rsv1=False):
+        header = bytes([(0x80 if fin else 0) | (0x40 if rsv1 else 0) | opcode])
+        mask_bit = 0x80 if masked else 0
+        if len(payload) < 126:
+            header += bytes([mask_bit | len(payload)])
+        elif len(payload) <= 0xFFFF:
+            header += bytes([mask_bit | 126]) + struct.pack("!H", len(payload))
+        else:
+            header += bytes([mask_bit | 127]) + struct.pack("!Q", len(payload))
+        if masked:
+            key = os.urandom(4)
+            mask = (key * (len(payload) // 4 + 1))[:len(payload)]
+            payload = (int.from_bytes(payload, "big") ^ int.from_bytes(mask, "big")).to_bytes(len(payload), "big")
+            header += key
+        self.sock.sendall(header + payload)
+
+    def recv_frame(self):
+        """Returns (fin, rsv1, opcode, payload)"""
+        first, second = self._read(2)
+        length = second & 0x7F
+        if length == 126:
+            length = struct.unpack("!H", self._read(2))[0]
+        elif length == 127:
+            length = struct.unpack("!Q", self._read(8))[0]
+        return bool(first & 0x80), bool(first & 0x40), first & 0x0F, self._read(length)
+
+    def close_code(self):
+        """Reads until the server's close frame and returns its code"""
+        while True:
+            _, _, opcode, payload = self.recv_frame()
+            if opcode == CLOSE:
+                return struct.unpack("!H", payload[:2])[0] if len(payload) >= 2 else None
+
+    def close(self):
+        self.sock.close()
+
+class TestWebSocket:
+    def test_handshake(self):
+        """Test WebSocket handshake"""
+        ws = WebSocketClient()
+        assert ws.status == 101 and ws.accepted
+        ws.close()
+
+        # Missing key
+        with socket.create_connection(("localhost", 8000), timeout=5) as sock:
+            sock.sendall(b"GET /ws HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\n"
+                         b"Connection: Upgrade\r\nSec-WebSocket-Version: 13\r\n\r\n")
+            assert b" 400 " in sock.recv(4096)
+
+    def test_echo(self):
+        """Test WebSocket text and binary messages"""
+        ws = WebSocketClient()
+        ws.send_frame(BINARY, b"\x00\x01\x02")
+        assert ws.recv_frame() == (True, False, BINARY, b"\x00\x01\x02")
+        # text is broadcast to the room, which includes the sender
+        ws.send_frame(TEXT, "héllo".encode())
+        assert ws.recv_frame() == (True, False, TEXT, "héllo".encode())
+        ws.send_frame(PING, b"are you there")
+        assert ws.recv_frame() == (True, False, PONG, b"are you there")
+        ws.close()
+
+    def test_fragmented(self):
+        """Test fragmented WebSocket messages"""
+        ws = WebSocketClient()
+        ws.send_frame(TEXT, b"frag", fin=False)
+        ws.send_frame(PING, b"")  # control frames may be interleaved
+        ws.send_frame(0x0, b"men", fin=False)
+        ws.send_frame(0x0, b"ted")
+        assert ws.recv_frame()[2] == PONG
+        assert ws.recv_frame() == (True, False, TEXT, b"fragmented")
+        ws.close()
+
+        ws = WebSocketClient()
+        ws.send_frame(0x0, b"no start")
+        assert ws.close_code() == 1002
+        ws.close()
+
+    def test_masking_required(self):
+        """Test unmasked client frames are rejected"""
+        ws = WebSocketClient()
+        ws.send_frame(TEXT, b"plain", masked=False)
+        assert ws.close_code() == 1002
+        ws.close()
+
+    def test_close_codes(self):
+        """Test WebSocket close codes"""
+        ws = WebSocketClient()
+        ws.send_frame(CLOSE, struct.pack("!H", 1000) + b"bye")
+        assert ws.close_code() == 1000
+        ws.close()
+
+        ws = WebSocketClient()
+        ws.send_frame(CLOSE, b"")
+        assert ws.close_code() == 1000
+        ws.close()
+
+        for invalid in (999, 1004, 1005, 1006, 1016, 2000, 5000):
+            ws = WebSocketClient()
+            ws.send_frame(CLOSE, struct.pack("!H", invalid))
+            assert ws.close_code() == 1002, invalid
+            ws.close()
+
+        ws = WebSocketClient()
+        ws.send_frame(CLOSE, b"\x03")
+        assert ws.close_code() == 1002
+        ws.close()
+
+    def test_utf8(self):
+        """Test invalid UTF-8 is rejected with 1007"""
+        for invalid in (b"\xff", b"\xc0\xaf", b"\xed\xa0\x80", b"\xf4\x90\x80\x80", b"ok\xe2\x82"):
+            ws = WebSocketClient()
+            ws.send_frame(TEXT, invalid)
+            assert ws.close_code() == 1007, invalid
+            ws.close()
+
+        ws = WebSocketClient()
+        ws.send_frame(CLOSE, struct.pack("!H", 1000) + b"\xff")
+        assert ws.close_code() == 1007
+        ws.close()
+
+        # Binary messages are not text
+        ws = WebSocketClient()
+        ws.send_frame(BINARY, b"\xff")
+        assert ws.recv_frame()[3] == b"\xff"
+        ws.close()
+
+    def test_deflate(self):
+        """Test permessage-deflate negotiation"""
+        ws = WebSocketClient(extensions="permessage-deflate; client_max_window_bits")
+        extension = ws.headers.get("sec-websocket-extensions", "")
+        assert extension.startswith("permessage-deflate")
+        assert "server_no_context_takeover" in extension
+
+        # Server frames are compressed from the minimum size on
+        message = ("compressible " * 20).encode()
+        ws.send_frame(TEXT, message)
+        fin, rsv1, opcode, payload = ws.recv_frame()
+        assert rsv1 and opcode == TEXT
+        assert zlib.decompressobj(-15).decompress(payload + b"\x00\x00\xff\xff") == message
+
+        # and so may be the client's
+        deflater = zlib.compressobj(wbits=-15)
+        compressed = deflater.compress(message) + deflater.flush(zlib.Z_SYNC_FLUSH)
+        ws.send_frame(TEXT, compressed[:-4], rsv1=True)
+        fin, rsv1, opcode, payload = ws.recv_frame()
+        assert zlib.decompressobj(-15).decompress(payload + b"\x00\x00\xff\xff") == message
+        ws.close()
+
+        # Unknown parameters decline the offer
+        ws = WebSocketClient(extensions="permessage-deflate; foo=1")
+        assert ws.status == 101 and "sec-websocket-extensions" not in ws.headers
+        ws.close()
+
+    def test_slow_reader(self):
+        """Test a slow reader with compression context takeover"""
+        ws = WebSocketClient(path="/ws/echo", extensions="permessage-deflate")
+        assert "server_no_context_takeover" not in ws.headers.get("sec-websocket-extensions", "")
+
+        # Poorly compressible messages sent without reading the echoes
+        # overflow the server's queue for this connection
+        sent = [base64.b64encode(os.urandom(48 * 1024)) for _ in range(400)]
+        for message in sent:
+            ws.send_frame(TEXT, message)
+
+        inflater = zlib.decompressobj(-15)
+        received = 0
+        close_code = None
+        while received < len(sent):
+            fin, rsv1, opcode, payload = ws.recv_frame()
+            if opcode == CLOSE:
+                close_code = struct.unpack("!H", payload[:2])[0]
+                break
+            if rsv1:
+                payload = inflater.decompress(payload + b"\x00\x00\xff\xff")
+            # every frame that arrives decodes, in order, with nothing missing
+            assert payload == sent[received], received
+            received += 1
+        assert received == len(sent) or close_code == 1008
+        ws.close()
+
+def run_tests():
+    """Run all tests"""
+    suite = TestWebSocket()
+    tests = [
+        suite.test_handshake,
+        suite.test_echo,
+        suite.test_fragmented,
+        suite.test_masking_required,
+        suite.test_close_codes,
+        suite.test_utf8,
+        suite.test_deflate,
+        suite.test_slow_reader
+    ]
+
+    passed = failed = 0
+    for test in tests:
+        try:
+            test()
+            logging.info(f"✓ {test.__doc__}")
+            passed += 1
+        except AssertionError as e:
+            logging.error(f"✗ {test.__doc__}: {str(e)}")
+            failed += 1
+        except Exception as e:
+            logging.error(f"✗ {test.__doc__}: Unexpected error: {str(e)}")
+            failed += 1
+
+    total = passed + failed
+    logging.info(f"\nResults: {passed}/{total} tests passed")
+    return failed == 0
+
+if __name__ == "__main__":
+    import sys
+    sys.exit(0 if run_tests() else 1)
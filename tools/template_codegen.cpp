@@ -0,0 +1,401 @@
+#include <map>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+
+#include "Utils.h"
+#include "Template.h"
+
+// Turns every template under a directory into a C++ render function with
+// its literals as constexpr string_views and each top-level value it reads
+// as a parameter. The generated file registers the functions with
+// Template::registerPrecompiled when it is linked into the executable.
+//
+//   template_codegen <template dir> <output.cpp>
+//
+// Templates the generator cannot express (loop.* outside a loop of the same
+// file, include cycles) are skipped with a warning and stay runtime-loaded.
+// Syntax errors fail the build.
+class TemplateCodegen {
+public:
+    explicit TemplateCodegen(const std::string& root) : root(root) {}
+
+    void addAll() {
+        std::vector<std::string> names;
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(root)) {
+            if (!entry.is_regular_file()) continue;
+            names.push_back(std::filesystem::relative(entry.path(), root).generic_string());
+        }
+        std::sort(names.begin(), names.end());
+
+        for (const auto& name : names) {
+            std::string path = root + "/" + name;
+            Unit unit(name, Template::compile(Utils::readFile(path), name));
+            Utils::statFile(path, unit.file);
+            units.emplace(name, std::move(unit));
+        }
+    }
+
+    std::string generate() {
+        size_t index = 0;
+        for (auto& [name, unit] : units) {
+            unit.function = "render_" + std::to_string(index++);
+            analyze(unit);
+            if (unit.state == Unit::Failed) {
+                std::cerr << "template_codegen: " << name << " stays runtime-loaded: " << unit.error << std::endl;
+            }
+        }
+
+        std::ostringstream out;
+        out << "// Generated by template_codegen from the files in " << root << ". Do not edit.\n"
+            << "#include <string>\n"
+            << "#include <string_view>\n\n"
+            << "#include \"Template.h\"\n\n"
+            << "using namespace TemplateSupport;\n\n"
+            << "namespace {\n";
+
+        // Forward declarations, includes may call functions defined later
+        for (const auto& [name, unit] : units) {
+            if (unit.state == Unit::Done) out << "void " << signature(unit) << ";\n";
+        }
+
+        for (auto& [name, unit] : units) {
+            if (unit.state != Unit::Done) continue;
+
+            out << "\n// " << name << "\n";
+            std::ostringstream body;
+            std::vector<Loop> loops;
+            emitRange(unit, 0, unit.tmpl.segments.size(), loops, 1, body);
+
+            for (size_t i = 0; i < unit.literals.size(); i++) {
+                out << "constexpr std::string_view " << unit.function << "_s" << i << " = "
+                    << quote(unit.literals[i]) << ";\n";
+            }
+            out << "\nvoid " << signature(unit) << " {\n" << body.str() << "}\n";
+
+            out << "\nvoid " << unit.function << "_json(const json&" << (unit.params.empty() ? "" : " data")
+                << ", std::string& out) {\n"
+                << "    " << unit.function << "(out";
+            for (const auto& param : unit.params) {
+                out << ", field(data, " << quote(param) << ")";
+            }
+            out << ");\n}\n";
+        }
+
+        out << "\nstruct Registrar {\n"
+            << "    Registrar() {\n";
+        for (const auto& [name, unit] : units) {
+            if (unit.state != Unit::Done) continue;
+            Utils::FileInfo info = sourceInfo(unit);
+            out << "        Template::registerPrecompiled(" << quote(name) << ", " << unit.function
+                << "_json, {" << info.size << "u, " << static_cast<long long>(info.mtime) << "});\n";
+        }
+        out << "    }\n"
+            << "} registrar;\n"
+            << "}\n";
+        return out.str();
+    }
+
+private:
+    using Kind = Template::Kind;
+    using Segment = Template::Segment;
+
+    struct Unit {
+        enum State { Pending, Visiting, Done, Failed };
+
+        Unit(const std::string& name, Template tmpl) : name(name), tmpl(std::move(tmpl)) {}
+
+        std::string name;
+        Template tmpl;
+        Utils::FileInfo file;
+        State state = Pending;
+        std::string error;
+        std::string function;
+        std::vector<std::string> params;  // top-level names, in order of first use
+        std::vector<std::string> literals;
+    };
+
+    struct Loop {
+        std::string name;  // template variable
+        std::string value; // C++ pointer to the current element
+        std::string index; // C++ index variable
+        std::string count;
+    };
+
+    std::string root;
+    std::map<std::string, Unit> units;
+
+    static std::string quote(const std::string& text) {
+        std::string out = "\"";
+        for (size_t i = 0; i < text.length(); i++) {
+            unsigned char c = static_cast<unsigned char>(text[i]);
+            switch (c) {
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n':
+                    // One source line per template line
+                    out += i + 1 < text.length() ? "\\n\"\n    \"" : "\\n";
+                    break;
+                case '\r': out += "\\r"; break;
+                case '\t': out += "\\t"; break;
+                default:
+                    if (c < 0x20 || c == 0x7f) {
+                        char escaped[8];
+                        std::snprintf(escaped, sizeof(escaped), "\\%03o", c);
+                        out += escaped;
+                    } else {
+                        out += static_cast<char>(c);
+                    }
+            }
+        }
+        return out + "\"";
+    }
+
+    std::string signature(const Unit& unit) const {
+        std::string sig = unit.function + "(std::string& out";
+        for (size_t i = 0; i < unit.params.size(); i++) {
+            sig += ", const json* p" + std::to_string(i);
+        }
+        return sig + ")";
+    }
+
+    Unit* findUnit(const std::string& name) {
+        auto it = units.find(name);
+        return it == units.end() ? nullptr : &it->second;
+    }
+
+    // Collects the top-level names a template (and what it includes) reads
+    void analyze(Unit& unit) {
+        if (unit.state == Unit::Done || unit.state == Unit::Failed) return;
+        if (unit.state == Unit::Visiting) {
+            unit.state = Unit::Failed;
+            unit.error = "include cycle";
+            return;
+        }
+        unit.state = Unit::Visiting;
+
+        std::vector<std::string> bound;
+        std::vector<size_t> blockEnds;
+        auto use = [&](const std::string& name) {
+            if (std::find(bound.begin(), bound.end(), name) != bound.end()) return;
+            if (std::find(unit.params.begin(), unit.params.end(), name) == unit.params.end()) {
+                unit.params.push_back(name);
+            }
+        };
+
+        const auto& segments = unit.tmpl.segments;
+        for (size_t i = 0; i < segments.size() && unit.state != Unit::Failed; i++) {
+            while (!blockEnds.empty() && blockEnds.back() == i) {
+                blockEnds.pop_back();
+                bound.pop_back();
+            }
+
+            const Segment& segment = segments[i];
+            if (!segment.path.empty()) {
+                if (segment.path[0] == "loop") {
+                    bool inLoop = std::any_of(bound.begin(), bound.end(), [](const std::string& b) { return !b.empty(); });
+                    if (!inLoop || segment.path.size() != 2 || segment.kind == Kind::For) {
+                        unit.state = Unit::Failed;
+                        unit.error = "unsupported use of loop";
+                        break;
+                    }
+                } else {
+                    use(segment.path[0]);
+                }
+            }
+
+            if (segment.kind == Kind::For) {
+                bound.push_back(segment.text);
+                blockEnds.push_back(segment.end);
+            } else if (segment.kind == Kind::If) {
+                bound.push_back("");
+                blockEnds.push_back(segment.end);
+            } else if (segment.kind == Kind::Include) {
+                Unit* included = findUnit(segment.text);
+                if (!included) {
+                    unit.state = Unit::Failed;
+                    unit.error = "includes missing " + segment.text;
+                    break;
+                }
+                analyze(*included);
+                if (included->state != Unit::Done) {
+                    unit.state = Unit::Failed;
+                    unit.error = "includes " + segment.text + ", which stays runtime-loaded";
+                    break;
+                }
+                for (const auto& param : included->params) {
+                    use(param);
+                }
+            }
+        }
+
+        if (unit.state == Unit::Visiting) unit.state = Unit::Done;
+    }
+
+    Utils::FileInfo sourceInfo(const Unit& unit) {
+        Utils::FileInfo info = unit.file;
+        for (const auto& segment : unit.tmpl.segments) {
+            if (segment.kind != Kind::Include) continue;
+            Utils::FileInfo included = sourceInfo(*findUnit(segment.text));
+            info.mtime = std::max(info.mtime, included.mtime);
+            info.size += included.size;
+        }
+        return info;
+    }
+
+    std::string resolve(const Unit& unit, const std::string& name, const std::vector<Loop>& loops) const {
+        for (auto it = loops.rbegin(); it != loops.rend(); ++it) {
+            if (it->name == name) return it->value;
+        }
+        size_t param = std::find(unit.params.begin(), unit.params.end(), name) - unit.params.begin();
+        return "p" + std::to_string(param);
+    }
+
+    std::string valueExpression(const Unit& unit, const std::vector<std::string>& path, const std::vector<Loop>& loops) const {
+        std::string base = resolve(unit, path[0], loops);
+        if (path.size() == 1) return base;
+
+        std::string expr = "find(" + base + ", {";
+        for (size_t i = 1; i < path.size(); i++) {
+            if (i > 1) expr += ", ";
+            expr += quote(path[i]);
+        }
+        return expr + "})";
+    }
+
+    void emitRange(Unit& unit, size_t begin, size_t end, std::vector<Loop>& loops, int depth, std::ostringstream& out) {
+        std::string indent(depth * 4, ' ');
+        const auto& segments = unit.tmpl.segments;
+
+        size_t i = begin;
+        while (i < end) {
+            const Segment& segment = segments[i];
+
+            switch (segment.kind) {
+                case Kind::Text:
+                    out << indent << "out += " << unit.function << "_s" << unit.literals.size() << ";\n";
+                    unit.literals.push_back(segment.text);
+                    i++;
+                    break;
+
+                case Kind::Escaped:
+                case Kind::Raw:
+                    if (segment.path[0] == "loop") {
+                        const Loop& loop = loops.back();
+                        const std::string& field = segment.path[1];
+                        if (field == "index") {
+                            out << indent << "out += std::to_string(" << loop.index << " + 1);\n";
+                        } else if (field == "first") {
+                            out << indent << "out += " << loop.index << " == 0 ? \"true\" : \"false\";\n";
+                        } else if (field == "last") {
+                            out << indent << "out += " << loop.index << " + 1 == " << loop.count << " ? \"true\" : \"false\";\n";
+                        }
+                    } else {
+                        out << indent << "appendValue(" << valueExpression(unit, segment.path, loops) << ", "
+                            << (segment.kind == Kind::Escaped ? "true" : "false") << ", out);\n";
+                    }
+                    i++;
+                    break;
+
+                case Kind::If: {
+                    std::string condition;
+                    if (segment.path[0] == "loop") {
+                        const Loop& loop = loops.back();
+                        const std::string& field = segment.path[1];
+                        condition = field == "index" ? "true" :
+                                    field == "first" ? loop.index + " == 0" :
+                                    field == "last" ? loop.index + " + 1 == " + loop.count : "false";
+                    } else {
+                        condition = "isTruthy(" + valueExpression(unit, segment.path, loops) + ")";
+                    }
+
+                    out << indent << "if (" << (segment.negate ? "!(" + condition + ")" : condition) << ") {\n";
+                    emitRange(unit, i + 1, segment.elseIndex, loops, depth + 1, out);
+                    if (segment.elseIndex < segment.end) {
+                        out << indent << "} else {\n";
+                        emitRange(unit, segment.elseIndex, segment.end, loops, depth + 1, out);
+                    }
+                    out << indent << "}\n";
+                    i = segment.end;
+                    break;
+                }
+
+                case Kind::For: {
+                    std::string level = std::to_string(loops.size());
+                    Loop loop{segment.text, "item" + level, "i" + level, "count" + level};
+                    std::string values = "values" + level;
+
+                    out << indent << "if (const json* " << values << " = " << valueExpression(unit, segment.path, loops)
+                        << "; " << values << " && " << values << "->is_array()) {\n"
+                        << indent << "    const size_t " << loop.count << " = " << values << "->size();\n"
+                        << indent << "    for (size_t " << loop.index << " = 0; " << loop.index << " < " << loop.count
+                        << "; " << loop.index << "++) {\n"
+                        << indent << "        const json* " << loop.value << " = &(*" << values << ")[" << loop.index << "];\n";
+
+                    loops.push_back(loop);
+                    emitRange(unit, i + 1, segment.end, loops, depth + 2, out);
+                    loops.pop_back();
+
+                    out << indent << "    }\n"
+                        << indent << "}\n";
+                    i = segment.end;
+                    break;
+                }
+
+                case Kind::Include: {
+                    const Unit& included = *findUnit(segment.text);
+                    out << indent << included.function << "(out";
+                    for (const auto& param : included.params) {
+                        out << ", " << resolve(unit, param, loops);
+                    }
+                    out << ");\n";
+                    i++;
+                    break;
+                }
+            }
+        }
+    }
+};
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        std::cerr << "usage: " << argv[0] << " <template dir> <output.cpp>" << std::endl;
+        return 2;
+    }
+
+    std::string generated;
+    try {
+        TemplateCodegen codegen(argv[1]);
+        if (std::filesystem::is_directory(argv[1])) {
+            codegen.addAll();
+        }
+        generated = codegen.generate();
+    } catch (const std::exception& e) {
+        std::cerr << "template_codegen: " << e.what() << std::endl;
+        return 1;
+    }
+
+    // Leave the file alone when nothing changed so it is not recompiled
+    std::string output = argv[2];
+    std::error_code ec;
+    if (std::filesystem::exists(output, ec) && Utils::readFile(output) == generated) {
+        return 0;
+    }
+
+    std::filesystem::path parent = std::filesystem::path(output).parent_path();
+    if (!parent.empty()) {
+        std::filesystem::create_directories(parent, ec);
+    }
+
+    std::ofstream file(output, std::ios::binary | std::ios::trunc);
+    file << generated;
+    if (!file) {
+        std::cerr << "template_codegen: cannot write " << output << std::endl;
+        return 1;
+    }
+    return 0;
+}